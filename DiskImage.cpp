@@ -70,10 +70,51 @@ struct VGFIND_SECTOR
 };
 
 
+struct TTrack
+{
+	unsigned int Length;
+	unsigned char* Ptr[2];      // track image, clock marks
+};
+
+// Track table sized to the actual geometry: a cylinder gets its side entries
+// on first use and all track buffers come from one arena released by Clear().
+class TTrackMap
+{
+	struct TCylinder
+	{
+		TTrack *Sides;
+		unsigned int Count;
+	};
+
+	struct TBlock
+	{
+		TBlock *Next;
+		unsigned int Size;
+		unsigned int Used;
+	};
+
+	TCylinder FCyl[256];
+	TBlock *FBlocks;
+
+	TTrack &Grow(unsigned int cyl, unsigned int side);
+
+public:
+	TTrackMap();
+	~TTrackMap();
+
+	TTrack &operator()(unsigned int cyl, unsigned int side)
+	{
+		TCylinder &c = FCyl[cyl & 0xFF];
+		return ((side & 0xFF) < c.Count) ? c.Sides[side & 0xFF] : Grow(cyl, side);
+	}
+
+	unsigned char *Alloc(unsigned int size);
+	void Clear();
+};
+
 class TDiskImage
 {
-	unsigned int FTrackLength[256][256];
-	unsigned char* FTracksPtr[256][256][2];
+	TTrackMap FTracks;
 
 	TDiskImageType FType;
 
@@ -823,16 +864,73 @@ long filelength(int hfile)
 }
 
 //----------------------------------------------------------------------------
-TDiskImage::TDiskImage()
+#define TRACK_ARENA_BLOCK (256 * 1024)
+
+TTrackMap::TTrackMap()
 {
-	for (int t = 0; t < 256; t++)
-		for (int s = 0; s < 256; s++)
-		{
-			FTrackLength[t][s] = 0;
-			FTracksPtr[t][s][0] = NULL;
-			FTracksPtr[t][s][1] = NULL;
-		}
+	memset(FCyl, 0, sizeof(FCyl));
+	FBlocks = NULL;
+}
+
+TTrackMap::~TTrackMap()
+{
+	Clear();
+}
+
+TTrack &TTrackMap::Grow(unsigned int cyl, unsigned int side)
+{
+	TCylinder &c = FCyl[cyl & 0xFF];
+	side &= 0xFF;
+
+	c.Sides = (TTrack*)realloc(c.Sides, (side + 1) * sizeof(TTrack));
+	memset(c.Sides + c.Count, 0, (side + 1 - c.Count) * sizeof(TTrack));
+	c.Count = side + 1;
+
+	return c.Sides[side];
+}
+
+unsigned char *TTrackMap::Alloc(unsigned int size)
+{
+	size = (size + 7) & ~7;
+
+	TBlock *b = FBlocks;
+	if (!b || b->Used + size > b->Size)
+	{
+		unsigned int bsize = (size > TRACK_ARENA_BLOCK) ? size : TRACK_ARENA_BLOCK;
+		b = (TBlock*)malloc(sizeof(TBlock) + bsize);
+		if (!b) return NULL;
+
+		b->Size = bsize;
+		b->Used = 0;
+		b->Next = FBlocks;
+		FBlocks = b;
+	}
+
+	unsigned char *ptr = (unsigned char*)(b + 1) + b->Used;
+	b->Used += size;
+	return ptr;
+}
+
+void TTrackMap::Clear()
+{
+	for (int i = 0; i < 256; i++)
+	{
+		free(FCyl[i].Sides);
+		FCyl[i].Sides = NULL;
+		FCyl[i].Count = 0;
+	}
 
+	while (FBlocks)
+	{
+		TBlock *next = FBlocks->Next;
+		free(FBlocks);
+		FBlocks = next;
+	}
+}
+
+//----------------------------------------------------------------------------
+TDiskImage::TDiskImage()
+{
 	DiskPresent = false;
 	ReadOnly = true;
 	Changed = false;
@@ -848,29 +946,28 @@ TDiskImage::~TDiskImage()
 	Changed = false;
 	FType = DIT_UNK;
 
-	for (int t = 0; t < 256; t++)
-		for (int s = 0; s < 256; s++)
-		{
-			FTrackLength[t][s] = 0;
-			if (FTracksPtr[t][s][0]) delete FTracksPtr[t][s][0];
-			FTracksPtr[t][s][0] = NULL;
-			if (FTracksPtr[t][s][1]) delete FTracksPtr[t][s][1];
-			FTracksPtr[t][s][1] = NULL;
-		}
+	FTracks.Clear();
 }
 //-----------------------------------------------------------------------------
 unsigned short TDiskImage::MakeVGCRC(unsigned char *data, unsigned long length)
 {
-	unsigned short CRC = 0xFFFF;
-	for (unsigned int i = 0; i < length; i++)
+	static unsigned short crctab[256];
+	if (!crctab[1])
 	{
-		CRC ^= data[i] << 8;
-		for (unsigned int j = 0; j < 8; j++)
+		for (unsigned int i = 0; i < 256; i++)
 		{
-			if (CRC & 0x8000) CRC = (CRC << 1) ^ 0x1021;
-			else CRC <<= 1;
+			unsigned short CRC = i << 8;
+			for (unsigned int j = 0; j < 8; j++)
+			{
+				if (CRC & 0x8000) CRC = (CRC << 1) ^ 0x1021;
+				else CRC <<= 1;
+			}
+			crctab[i] = CRC;
 		}
 	}
+
+	unsigned short CRC = 0xFFFF;
+	for (unsigned int i = 0; i < length; i++) CRC = (CRC << 8) ^ crctab[(CRC >> 8) ^ data[i]];
 	return CRC;          // H<-->L !!!
 }
 //-----------------------------------------------------------------------------
@@ -933,14 +1030,14 @@ bool TDiskImage::FindADMark(unsigned char CYL, unsigned char SIDE,
 
 	if ((!DiskPresent) |
 		((CYL > MaxTrack) || (SIDE > MaxSide)) |
-		((!FTracksPtr[CYL][SIDE][0]) || (!FTracksPtr[CYL][SIDE][1])))
+		((!FTracks(CYL, SIDE).Ptr[0]) || (!FTracks(CYL, SIDE).Ptr[1])))
 	{
 		return false;           // ERROR: disk not ready
 	}
 
-	unsigned char *track = vgfa->TrackPointer = FTracksPtr[CYL][SIDE][0];
-	unsigned char *clks = vgfa->ClkPointer = FTracksPtr[CYL][SIDE][1];
-	unsigned int tlen = vgfa->TrackLength = FTrackLength[CYL][SIDE];
+	unsigned char *track = vgfa->TrackPointer = FTracks(CYL, SIDE).Ptr[0];
+	unsigned char *clks = vgfa->ClkPointer = FTracks(CYL, SIDE).Ptr[1];
+	unsigned int tlen = vgfa->TrackLength = FTracks(CYL, SIDE).Length;
 
 	unsigned int off, rc;
 
@@ -996,7 +1093,7 @@ bool TDiskImage::FindSector(unsigned char CYL, unsigned char SIDE,
 
 	if ((!DiskPresent) |
 		((CYL > MaxTrack) || (SIDE > MaxSide)) |
-		((!FTracksPtr[CYL][SIDE][0]) || (!FTracksPtr[CYL][SIDE][1])))
+		((!FTracks(CYL, SIDE).Ptr[0]) || (!FTracks(CYL, SIDE).Ptr[1])))
 	{
 		vgfs->vgfa.TrackPointer = NULL;
 		vgfs->vgfa.ClkPointer = NULL;
@@ -1104,14 +1201,14 @@ bool TDiskImage::FindTrack(unsigned char CYL, unsigned char SIDE, VGFIND_TRACK *
 
 	if ((!DiskPresent) |
 		((CYL > MaxTrack) || (SIDE > MaxSide)) |
-		((!FTracksPtr[CYL][SIDE][0]) || (!FTracksPtr[CYL][SIDE][1])))
+		((!FTracks(CYL, SIDE).Ptr[0]) || (!FTracks(CYL, SIDE).Ptr[1])))
 	{
 		return false;           // ERROR: disk not ready
 	}
 
-	vgft->TrackPointer = FTracksPtr[CYL][SIDE][0];
-	vgft->ClkPointer = FTracksPtr[CYL][SIDE][1];
-	vgft->TrackLength = FTrackLength[CYL][SIDE];
+	vgft->TrackPointer = FTracks(CYL, SIDE).Ptr[0];
+	vgft->ClkPointer = FTracks(CYL, SIDE).Ptr[1];
+	vgft->TrackLength = FTracks(CYL, SIDE).Length;
 	vgft->FoundTrack = true;
 	return true;
 }
@@ -1138,15 +1235,7 @@ void TDiskImage::Open(const char *filename, bool ROnly)
 		Changed = false;
 		FType = DIT_UNK;
 
-		for (int t = 0; t < 256; t++)
-			for (int s = 0; s < 256; s++)
-			{
-				FTrackLength[t][s] = 0;
-				if (FTracksPtr[t][s][0]) delete FTracksPtr[t][s][0];
-				FTracksPtr[t][s][0] = NULL;
-				if (FTracksPtr[t][s][1]) delete FTracksPtr[t][s][1];
-				FTracksPtr[t][s][1] = NULL;
-			}
+		FTracks.Clear();
 	}
 
 	if (typ == DIT_UNK)
@@ -1190,107 +1279,107 @@ void TDiskImage::formatTRDOS(unsigned int Tcount, unsigned int Scount)
 	for (unsigned int trk = 0; trk <= unsigned(MaxTrack); trk++)
 		for (unsigned int side = 0; side <= unsigned(MaxSide); side++)
 		{
-			FTrackLength[trk][side] = 6250;
+			FTracks(trk, side).Length = 6250;
 
-			FTracksPtr[trk][side][0] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // trk img
-			FTracksPtr[trk][side][1] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // clk img
+			FTracks(trk, side).Ptr[0] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // trk img
+			FTracks(trk, side).Ptr[1] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // clk img
 
 			unsigned int tptr = 0;
 			for (int sec = 0; sec < 16; sec++)
 			{
 				for (r = 0; r < 10; r++)        // Первый пробел
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x4E;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				for (r = 0; r < 12; r++)        // Синхропромежуток
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x00;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x00;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				ptrcrc = tptr;
 				for (r = 0; r < 3; r++)        // Синхроимпульс
 				{
-					FTracksPtr[trk][side][0][tptr] = 0xA1;
-					FTracksPtr[trk][side][1][tptr++] = 0xFF;
+					FTracks(trk, side).Ptr[0][tptr] = 0xA1;
+					FTracks(trk, side).Ptr[1][tptr++] = 0xFF;
 				}
-				FTracksPtr[trk][side][0][tptr] = 0xFE;   // Метка "Адрес"
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)trk; // cyl
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)0x00; // head (TR always 0)
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(sec + 1); // secN
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)0x01; // len=256b
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-
-				vgcrc = MakeVGCRC(FTracksPtr[trk][side][0] + ptrcrc, tptr - ptrcrc);
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc & 0xFF);
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0xFE;   // Метка "Адрес"
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)trk; // cyl
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)0x00; // head (TR always 0)
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(sec + 1); // secN
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)0x01; // len=256b
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+
+				vgcrc = MakeVGCRC(FTracks(trk, side).Ptr[0] + ptrcrc, tptr - ptrcrc);
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc & 0xFF);
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 				for (r = 0; r < 22; r++)        // Второй пробел
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x4E;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				for (r = 0; r < 12; r++)        // Синхропромежуток
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x00;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x00;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				ptrcrc = tptr;
 				for (r = 0; r < 3; r++)        // Синхроимпульс
 				{
-					FTracksPtr[trk][side][0][tptr] = 0xA1;
-					FTracksPtr[trk][side][1][tptr++] = 0xFF;
+					FTracks(trk, side).Ptr[0][tptr] = 0xA1;
+					FTracks(trk, side).Ptr[1][tptr++] = 0xFF;
 				}
-				FTracksPtr[trk][side][0][tptr] = 0xFB;   // Метка "Данные"
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0xFB;   // Метка "Данные"
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 				for (r = 0; r < 256; r++)        // сектор 256байт
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x00;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x00;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				if ((trk == 0) && (side == 0) && (sec == 8))      // make TR-DOS id
 				{
 					int ssec = tptr - 256;
-					FTracksPtr[trk][side][0][ssec + 0xE1] = 0x00; // first free SECT
-					FTracksPtr[trk][side][0][ssec + 0xE2] = 0x01; // first free TRACK
-					FTracksPtr[trk][side][0][ssec + 0xE3] = 0x16; // 80trk DS
-					FTracksPtr[trk][side][0][ssec + 0xE4] = 0x00; // file count
-					*(unsigned short*)(FTracksPtr[trk][side][0] + ssec + 0xE5)
+					FTracks(trk, side).Ptr[0][ssec + 0xE1] = 0x00; // first free SECT
+					FTracks(trk, side).Ptr[0][ssec + 0xE2] = 0x01; // first free TRACK
+					FTracks(trk, side).Ptr[0][ssec + 0xE3] = 0x16; // 80trk DS
+					FTracks(trk, side).Ptr[0][ssec + 0xE4] = 0x00; // file count
+					*(unsigned short*)(FTracks(trk, side).Ptr[0] + ssec + 0xE5)
 						= TotalSecs; // free SECS count
-					FTracksPtr[trk][side][0][ssec + 0xE7] = 0x10; // TR-DOS id
-					FTracksPtr[trk][side][0][ssec + 0xF4] = 0x00; // deleted file count
+					FTracks(trk, side).Ptr[0][ssec + 0xE7] = 0x10; // TR-DOS id
+					FTracks(trk, side).Ptr[0][ssec + 0xF4] = 0x00; // deleted file count
 
-					memcpy(FTracksPtr[trk][side][0] + ssec + 0xF5,
+					memcpy(FTracks(trk, side).Ptr[0] + ssec + 0xF5,
 						STR_CREATEDISKNAME"               ", 8); // disk name
-					FTracksPtr[trk][side][0][ssec + 0xFD] = 0x00; // zero
-					FTracksPtr[trk][side][0][ssec + 0xFE] = 0x00; // zero
-					FTracksPtr[trk][side][0][ssec + 0xFF] = 0x00; // zero
+					FTracks(trk, side).Ptr[0][ssec + 0xFD] = 0x00; // zero
+					FTracks(trk, side).Ptr[0][ssec + 0xFE] = 0x00; // zero
+					FTracks(trk, side).Ptr[0][ssec + 0xFF] = 0x00; // zero
 				}
 
-				vgcrc = MakeVGCRC(FTracksPtr[trk][side][0] + ptrcrc, tptr - ptrcrc);
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc & 0xFF);
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				vgcrc = MakeVGCRC(FTracks(trk, side).Ptr[0] + ptrcrc, tptr - ptrcrc);
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc & 0xFF);
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 				for (r = 0; r < 60; r++)        // Третий пробел
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x4E;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 			}
 			for (int eoftrk = tptr; eoftrk < 6250; eoftrk++)
 			{
-				FTracksPtr[trk][side][0][tptr] = 0x4E;
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 			}
 		}
 }
@@ -1399,14 +1488,14 @@ void TDiskImage::readUDI(int hfile, bool ronly)
 
 			if (ptr[udiOFF++] != 0)        // non MFM track?
 			{
-				FTrackLength[trk][side] = 6250;
+				FTracks(trk, side).Length = 6250;
 				// make unformatted track...
-				FTracksPtr[trk][side][0] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // trk img
-				FTracksPtr[trk][side][1] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // clk img
+				FTracks(trk, side).Ptr[0] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // trk img
+				FTracks(trk, side).Ptr[1] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // clk img
 				for (unsigned ij = 0; ij < 6250; ij++)
 				{
-					FTracksPtr[trk][side][0][ij] = 0x00;
-					FTracksPtr[trk][side][1][ij] = 0x00;
+					FTracks(trk, side).Ptr[0][ij] = 0x00;
+					FTracks(trk, side).Ptr[1][ij] = 0x00;
 				}
 
 				udiOFF += *((unsigned long*)(ptr + udiOFF));
@@ -1415,18 +1504,18 @@ void TDiskImage::readUDI(int hfile, bool ronly)
 			}
 			trklen = *((unsigned short*)(ptr + udiOFF));
 			udiOFF += 2;
-			FTrackLength[trk][side] = trklen;
+			FTracks(trk, side).Length = trklen;
 
 			// make unformatted track...
-			FTracksPtr[trk][side][0] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // trk img
-			FTracksPtr[trk][side][1] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // clk img
-			for (unsigned ij = 0; ij < FTrackLength[trk][side]; ij++)
+			FTracks(trk, side).Ptr[0] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // trk img
+			FTracks(trk, side).Ptr[1] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // clk img
+			for (unsigned ij = 0; ij < FTracks(trk, side).Length; ij++)
 			{
-				FTracksPtr[trk][side][0][ij] = 0x00;
-				FTracksPtr[trk][side][1][ij] = 0x00;
+				FTracks(trk, side).Ptr[0][ij] = 0x00;
+				FTracks(trk, side).Ptr[1][ij] = 0x00;
 			}
 
-			memcpy(FTracksPtr[trk][side][0], ptr + udiOFF, FTrackLength[trk][side]);
+			memcpy(FTracks(trk, side).Ptr[0], ptr + udiOFF, FTracks(trk, side).Length);
 			udiOFF += trklen;
 
 			unsigned int MFMinfoLen = trklen / 8 + ((trklen - (trklen / 8) * 8) ? 1 : 0);
@@ -1437,8 +1526,8 @@ void TDiskImage::readUDI(int hfile, bool ronly)
 				mask = 0x01;
 				for (int j = 0; j < 8; j++)
 				{
-					if (ptr[udiOFF] & mask) FTracksPtr[trk][side][1][i * 8 + j] = 0xFF;
-					else FTracksPtr[trk][side][1][i * 8 + j] = 0x00;
+					if (ptr[udiOFF] & mask) FTracks(trk, side).Ptr[1][i * 8 + j] = 0xFF;
+					else FTracks(trk, side).Ptr[1][i * 8 + j] = 0x00;
 					mask <<= 1;
 				}
 				udiOFF++;
@@ -1468,22 +1557,31 @@ void TDiskImage::writeTRD(fileTYPE *hfile)
 	for (int i = 0; i < 256; i++) nullbuf[i] = '*';
 	memcpy(nullbuf, errsect, sizeof(errsect));
 
+	// sectors are collected per track, so each track is a single write
+	unsigned char trkbuf[16 * 256];
+
 	for (unsigned int trk = 0; trk <= unsigned(MaxTrack); trk++)
 		for (unsigned int side = 0; side <= unsigned(MaxSide); side++)
+		{
+			unsigned int from = 0;
 			for (unsigned int sec = 0; sec < 16; sec++)
 			{
-				if (FindSector(trk, side, sec + 1, &vgfs))
+				// TR-DOS sectors are usually laid out in order, so continue the search after the previous one
+				if (FindSector(trk, side, sec + 1, &vgfs, from))
 				{
-					FileWriteAdv(hfile, vgfs.SectorPointer, 256);
+					memcpy(trkbuf + sec * 256, vgfs.SectorPointer, 256);
+					from = vgfs.OffsetEndSector;
 					if ((!vgfs.CRCOK) || (!vgfs.vgfa.CRCOK)) printf("Warning: sector %d on track %d, side %d with BAD CRC!\n", sec + 1, trk, side);
 					if (vgfs.SectorLength != 256) printf("Warning: sector %d on track %d, side %d is non 256 bytes!\n", sec + 1, trk, side);
 				}
 				else
 				{
-					FileWriteAdv(hfile, nullbuf, 256);
+					memcpy(trkbuf + sec * 256, nullbuf, 256);
 					printf("DANGER! Sector %d on track %d, side %d not found!\n", sec + 1, trk, side);
 				}
 			}
+			FileWriteAdv(hfile, trkbuf, sizeof(trkbuf));
+		}
 }
 
 //-----------------------------------------------------------------------------
@@ -1622,15 +1720,15 @@ void TDiskImage::readFDI(int hfile, bool readonly)
 	for (trk = 0; trk <= unsigned(MaxTrack); trk++)
 		for (side = 0; side <= unsigned(MaxSide); side++)
 		{
-			FTrackLength[trk][side] = 6250;
+			FTracks(trk, side).Length = 6250;
 
 			// make unformatted track...
-			FTracksPtr[trk][side][0] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // trk img
-			FTracksPtr[trk][side][1] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // clk img
+			FTracks(trk, side).Ptr[0] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // trk img
+			FTracks(trk, side).Ptr[1] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // clk img
 			for (unsigned ij = 0; ij < 6250; ij++)
 			{
-				FTracksPtr[trk][side][0][ij] = 0x00;
-				FTracksPtr[trk][side][1][ij] = 0x00;
+				FTracks(trk, side).Ptr[0][ij] = 0x00;
+				FTracks(trk, side).Ptr[1][ij] = 0x00;
 			}
 
 			SecCount = tracksinfo[trk*(MaxSide + 1) + side].SectorCount;
@@ -1656,15 +1754,7 @@ void TDiskImage::readFDI(int hfile, bool readonly)
 			{
 				delete[] tracksinfo;
 				delete[] ptr;
-				for (int t = 0; t < 256; t++)
-					for (int s = 0; s < 256; s++)
-					{
-						FTrackLength[t][s] = 0;
-						if (FTracksPtr[t][s][0]) delete FTracksPtr[t][s][0];
-						FTracksPtr[t][s][0] = NULL;
-						if (FTracksPtr[t][s][1]) delete FTracksPtr[t][s][1];
-						FTracksPtr[t][s][1] = NULL;
-					}
+				FTracks.Clear();
 				ShowError(ERR_IMPOSSIBLE);
 				return;
 			}
@@ -1705,47 +1795,47 @@ void TDiskImage::readFDI(int hfile, bool readonly)
 			{
 				for (r = 0; r < FirstSpaceLen; r++)        // Первый пробел
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x4E;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				for (r = 0; r < SynchroSpaceLen; r++)        // Синхропромежуток
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x00;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x00;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				ptrcrc = tptr;
 				for (r = 0; r < SynchroPulseLen; r++)        // Синхроимпульс
 				{
-					FTracksPtr[trk][side][0][tptr] = 0xA1;
-					FTracksPtr[trk][side][1][tptr++] = 0xFF;
+					FTracks(trk, side).Ptr[0][tptr] = 0xA1;
+					FTracks(trk, side).Ptr[1][tptr++] = 0xFF;
 				}
-				FTracksPtr[trk][side][0][tptr] = 0xFE;   // Метка "Адрес"
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-
-				FTracksPtr[trk][side][0][tptr] = tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[0]; // cyl
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[1]; // head
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[2]; // secN
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[3]; // len code
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-
-				vgcrc = MakeVGCRC(FTracksPtr[trk][side][0] + ptrcrc, tptr - ptrcrc);
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc & 0xFF);
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0xFE;   // Метка "Адрес"
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+
+				FTracks(trk, side).Ptr[0][tptr] = tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[0]; // cyl
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[1]; // head
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[2]; // secN
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[3]; // len code
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+
+				vgcrc = MakeVGCRC(FTracks(trk, side).Ptr[0] + ptrcrc, tptr - ptrcrc);
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc & 0xFF);
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 				for (r = 0; r < SecondSpaceLen; r++)        // Второй пробел
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x4E;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				for (r = 0; r < SynchroSpaceLen; r++)        // Синхропромежуток
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x00;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x00;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 
 				unsigned char fdiSectorFlags = tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[4];
@@ -1763,15 +1853,15 @@ void TDiskImage::readFDI(int hfile, bool readonly)
 					ptrcrc = tptr;
 					for (r = 0; r < SynchroPulseLen; r++)        // Синхроимпульс
 					{
-						FTracksPtr[trk][side][0][tptr] = 0xA1;
-						FTracksPtr[trk][side][1][tptr++] = 0xFF;
+						FTracks(trk, side).Ptr[0][tptr] = 0xA1;
+						FTracks(trk, side).Ptr[1][tptr++] = 0xFF;
 					}
 
 					if (fdiSectorFlags & 0x80)
-						FTracksPtr[trk][side][0][tptr] = 0xF8;   // Метка "Удаленные данные"
+						FTracks(trk, side).Ptr[0][tptr] = 0xF8;   // Метка "Удаленные данные"
 					else
-						FTracksPtr[trk][side][0][tptr] = 0xFB;   // Метка "Данные"
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+						FTracks(trk, side).Ptr[0][tptr] = 0xFB;   // Метка "Данные"
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 
 					SL = unsigned(tracksinfo[trk*(MaxSide + 1) + side].SectorsInfo[sec].ADAM[3]);
@@ -1782,40 +1872,40 @@ void TDiskImage::readFDI(int hfile, bool readonly)
 
 					for (r = 0; r < SL; r++)        // сектор SL байт
 					{
-						FTracksPtr[trk][side][0][tptr] = ptr[secDATAOFF + r];
-						FTracksPtr[trk][side][1][tptr++] = 0x00;
+						FTracks(trk, side).Ptr[0][tptr] = ptr[secDATAOFF + r];
+						FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 					}
 
-					vgcrc = MakeVGCRC(FTracksPtr[trk][side][0] + ptrcrc, tptr - ptrcrc);
+					vgcrc = MakeVGCRC(FTracks(trk, side).Ptr[0] + ptrcrc, tptr - ptrcrc);
 
 
 					if (fdiSectorFlags & 0x3F)        // CRC correct?
 					{
-						FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
-						FTracksPtr[trk][side][1][tptr++] = 0x00;
-						FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc & 0xFF);
-						FTracksPtr[trk][side][1][tptr++] = 0x00;
+						FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
+						FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+						FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc & 0xFF);
+						FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 					}
 					else     // oh-oh, high technology... CRC bad... ;-)
 					{
-						FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc >> 8) ^ 0xFF; // emulation bad CRC... ;)
-						FTracksPtr[trk][side][1][tptr++] = 0x00;
-						FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc & 0xFF) ^ 0xFF;  // --//-- ;)
-						FTracksPtr[trk][side][1][tptr++] = 0x00;
+						FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc >> 8) ^ 0xFF; // emulation bad CRC... ;)
+						FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+						FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc & 0xFF) ^ 0xFF;  // --//-- ;)
+						FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 					}
 				}
 
 
 				for (r = 0; r < ThirdSpaceLen; r++)        // Третий пробел
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x4E;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 			}
 			for (int eoftrk = tptr; eoftrk < 6250; eoftrk++)
 			{
-				FTracksPtr[trk][side][0][tptr] = 0x4E;
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 			}
 		}
 
@@ -1888,29 +1978,21 @@ void TDiskImage::readFDD(int hfile, bool readonly)
 	for (trk = 0; trk <= unsigned(MaxTrack); trk++)
 		for (side = 0; side <= unsigned(MaxSide); side++)
 		{
-			FTrackLength[trk][side] = 6250;
+			FTracks(trk, side).Length = 6250;
 
 			// make unformatted track...
-			FTracksPtr[trk][side][0] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // trk img
-			FTracksPtr[trk][side][1] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // clk img
+			FTracks(trk, side).Ptr[0] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // trk img
+			FTracks(trk, side).Ptr[1] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // clk img
 			for (unsigned ij = 0; ij < 6250; ij++)
 			{
-				FTracksPtr[trk][side][0][ij] = 0x00;
-				FTracksPtr[trk][side][1][ij] = 0x00;
+				FTracks(trk, side).Ptr[0][ij] = 0x00;
+				FTracks(trk, side).Ptr[1][ij] = 0x00;
 			}
 
 			if ((fdd_hdr->DataOffset[trk*(MaxSide + 1) + side] + 2) > int(rsize))
 			{
 				delete[] ptr;
-				for (int t = 0; t < 256; t++)
-					for (int s = 0; s < 256; s++)
-					{
-						FTrackLength[t][s] = 0;
-						if (FTracksPtr[t][s][0]) delete FTracksPtr[t][s][0];
-						FTracksPtr[t][s][0] = NULL;
-						if (FTracksPtr[t][s][1]) delete FTracksPtr[t][s][1];
-						FTracksPtr[t][s][1] = NULL;
-					}
+				FTracks.Clear();
 				ShowError(ERR_CORRUPT);
 				return;
 			}
@@ -1922,30 +2004,14 @@ void TDiskImage::readFDD(int hfile, bool readonly)
 			if ((2 + SecCount * 8 + fdd_hdr->DataOffset[trk*(MaxSide + 1) + side]) > rsize)
 			{
 				delete[] ptr;
-				for (int t = 0; t < 256; t++)
-					for (int s = 0; s < 256; s++)
-					{
-						FTrackLength[t][s] = 0;
-						if (FTracksPtr[t][s][0]) delete FTracksPtr[t][s][0];
-						FTracksPtr[t][s][0] = NULL;
-						if (FTracksPtr[t][s][1]) delete FTracksPtr[t][s][1];
-						FTracksPtr[t][s][1] = NULL;
-					}
+				FTracks.Clear();
 				ShowError(ERR_CORRUPT);
 				return;
 			}
 			else if (trackinfo->sect[SecCount - 1].SectPos > int(rsize))
 			{
 				delete[] ptr;
-				for (int t = 0; t < 256; t++)
-					for (int s = 0; s < 256; s++)
-					{
-						FTrackLength[t][s] = 0;
-						if (FTracksPtr[t][s][0]) delete FTracksPtr[t][s][0];
-						FTracksPtr[t][s][0] = NULL;
-						if (FTracksPtr[t][s][1]) delete FTracksPtr[t][s][1];
-						FTracksPtr[t][s][1] = NULL;
-					}
+				FTracks.Clear();
 				ShowError(ERR_CORRUPT);
 				return;
 			}
@@ -1969,15 +2035,7 @@ void TDiskImage::readFDD(int hfile, bool readonly)
 			if (trkdatalen + SecCount*(3 + 2) > 6250)    // 3x4E & 2x00 per sec checking
 			{
 				delete[] ptr;
-				for (int t = 0; t < 256; t++)
-					for (int s = 0; s < 256; s++)
-					{
-						FTrackLength[t][s] = 0;
-						if (FTracksPtr[t][s][0]) delete FTracksPtr[t][s][0];
-						FTracksPtr[t][s][0] = NULL;
-						if (FTracksPtr[t][s][1]) delete FTracksPtr[t][s][1];
-						FTracksPtr[t][s][1] = NULL;
-					}
+				FTracks.Clear();
 				ShowError(ERR_IMPOSSIBLE);
 				return;
 			}
@@ -2018,47 +2076,47 @@ void TDiskImage::readFDD(int hfile, bool readonly)
 			{
 				for (r = 0; r < FirstSpaceLen; r++)        // Первый пробел
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x4E;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				for (r = 0; r < SynchroSpaceLen; r++)        // Синхропромежуток
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x00;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x00;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				ptrcrc = tptr;
 				for (r = 0; r < SynchroPulseLen; r++)        // Синхроимпульс
 				{
-					FTracksPtr[trk][side][0][tptr] = 0xA1;
-					FTracksPtr[trk][side][1][tptr++] = 0xFF;
+					FTracks(trk, side).Ptr[0][tptr] = 0xA1;
+					FTracks(trk, side).Ptr[1][tptr++] = 0xFF;
 				}
-				FTracksPtr[trk][side][0][tptr] = 0xFE;   // Метка "Адрес"
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-
-				FTracksPtr[trk][side][0][tptr] = trackinfo->sect[sec].trk;  // cyl
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = trackinfo->sect[sec].side; // head
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = trackinfo->sect[sec].sect; // secN
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = trackinfo->sect[sec].size; // len code
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-
-				vgcrc = MakeVGCRC(FTracksPtr[trk][side][0] + ptrcrc, tptr - ptrcrc);
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc & 0xFF);
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0xFE;   // Метка "Адрес"
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+
+				FTracks(trk, side).Ptr[0][tptr] = trackinfo->sect[sec].trk;  // cyl
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = trackinfo->sect[sec].side; // head
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = trackinfo->sect[sec].sect; // secN
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = trackinfo->sect[sec].size; // len code
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+
+				vgcrc = MakeVGCRC(FTracks(trk, side).Ptr[0] + ptrcrc, tptr - ptrcrc);
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc & 0xFF);
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 				for (r = 0; r < SecondSpaceLen; r++)        // Второй пробел
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x4E;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				for (r = 0; r < SynchroSpaceLen; r++)        // Синхропромежуток
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x00;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x00;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 
 
@@ -2066,12 +2124,12 @@ void TDiskImage::readFDD(int hfile, bool readonly)
 				ptrcrc = tptr;
 				for (r = 0; r < SynchroPulseLen; r++)        // Синхроимпульс
 				{
-					FTracksPtr[trk][side][0][tptr] = 0xA1;
-					FTracksPtr[trk][side][1][tptr++] = 0xFF;
+					FTracks(trk, side).Ptr[0][tptr] = 0xA1;
+					FTracks(trk, side).Ptr[1][tptr++] = 0xFF;
 				}
 
-				FTracksPtr[trk][side][0][tptr] = 0xFB;   // Метка "Данные"
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0xFB;   // Метка "Данные"
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 
 				SL = unsigned(trackinfo->sect[sec].size);
@@ -2082,29 +2140,29 @@ void TDiskImage::readFDD(int hfile, bool readonly)
 
 				for (r = 0; r < SL; r++)        // сектор SL байт
 				{
-					FTracksPtr[trk][side][0][tptr] = ptr[secDATAOFF + r];
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = ptr[secDATAOFF + r];
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 
-				vgcrc = MakeVGCRC(FTracksPtr[trk][side][0] + ptrcrc, tptr - ptrcrc);
+				vgcrc = MakeVGCRC(FTracks(trk, side).Ptr[0] + ptrcrc, tptr - ptrcrc);
 
 
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc & 0xFF);
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc & 0xFF);
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 
 				for (r = 0; r < ThirdSpaceLen; r++)        // Третий пробел
 				{
-					FTracksPtr[trk][side][0][tptr] = 0x4E;
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 			}
 			for (int eoftrk = tptr; eoftrk < 6250; eoftrk++)
 			{
-				FTracksPtr[trk][side][0][tptr] = 0x4E;
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 			}
 		}
 
@@ -2513,15 +2571,15 @@ void TDiskImage::readTD0(int hfile, bool readonly)
 
 		unsigned trk = tdtrk->Track;
 		unsigned side = tdtrk->Side;
-		FTrackLength[trk][side] = 6250;
+		FTracks(trk, side).Length = 6250;
 
 		// make unformatted track...
-		FTracksPtr[trk][side][0] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // trk img
-		FTracksPtr[trk][side][1] = (unsigned char*)new char[FTrackLength[trk][side] + 1024];      // clk img
+		FTracks(trk, side).Ptr[0] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // trk img
+		FTracks(trk, side).Ptr[1] = FTracks.Alloc(FTracks(trk, side).Length + 1024);      // clk img
 		for (unsigned ij = 0; ij < 6250; ij++)
 		{
-			FTracksPtr[trk][side][0][ij] = 0x00;
-			FTracksPtr[trk][side][1][ij] = 0x00;
+			FTracks(trk, side).Ptr[0][ij] = 0x00;
+			FTracks(trk, side).Ptr[1][ij] = 0x00;
 		}
 
 
@@ -2550,15 +2608,7 @@ void TDiskImage::readTD0(int hfile, bool readonly)
 		if (trkdatalen + SecCount*(3 + 2) > 6250)    // 3x4E & 2x00 per sec checking
 		{
 			delete[] ptr;
-			for (int t = 0; t < 256; t++)
-				for (int s = 0; s < 256; s++)
-				{
-					FTrackLength[t][s] = 0;
-					if (FTracksPtr[t][s][0]) delete FTracksPtr[t][s][0];
-					FTracksPtr[t][s][0] = NULL;
-					if (FTracksPtr[t][s][1]) delete FTracksPtr[t][s][1];
-					FTracksPtr[t][s][1] = NULL;
-				}
+			FTracks.Clear();
 			ShowError(ERR_IMPOSSIBLE);
 			return;
 		}
@@ -2605,47 +2655,47 @@ void TDiskImage::readTD0(int hfile, bool readonly)
 
 			for (r = 0; r < FirstSpaceLen; r++)        // Первый пробел
 			{
-				FTracksPtr[trk][side][0][tptr] = 0x4E;
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 			}
 			for (r = 0; r < SynchroSpaceLen; r++)        // Синхропромежуток
 			{
-				FTracksPtr[trk][side][0][tptr] = 0x00;
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0x00;
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 			}
 			ptrcrc = tptr;
 			for (r = 0; r < SynchroPulseLen; r++)        // Синхроимпульс
 			{
-				FTracksPtr[trk][side][0][tptr] = 0xA1;
-				FTracksPtr[trk][side][1][tptr++] = 0xFF;
+				FTracks(trk, side).Ptr[0][tptr] = 0xA1;
+				FTracks(trk, side).Ptr[1][tptr++] = 0xFF;
 			}
-			FTracksPtr[trk][side][0][tptr] = 0xFE;   // Метка "Адрес"
-			FTracksPtr[trk][side][1][tptr++] = 0x00;
-
-			FTracksPtr[trk][side][0][tptr] = tdsect->ADRM[0]; // cyl
-			FTracksPtr[trk][side][1][tptr++] = 0x00;
-			FTracksPtr[trk][side][0][tptr] = tdsect->ADRM[1]; // head
-			FTracksPtr[trk][side][1][tptr++] = 0x00;
-			FTracksPtr[trk][side][0][tptr] = tdsect->ADRM[2]; // secN
-			FTracksPtr[trk][side][1][tptr++] = 0x00;
-			FTracksPtr[trk][side][0][tptr] = tdsect->ADRM[3]; // len code
-			FTracksPtr[trk][side][1][tptr++] = 0x00;
-
-			vgcrc = MakeVGCRC(FTracksPtr[trk][side][0] + ptrcrc, tptr - ptrcrc);
-			FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
-			FTracksPtr[trk][side][1][tptr++] = 0x00;
-			FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc & 0xFF);
-			FTracksPtr[trk][side][1][tptr++] = 0x00;
+			FTracks(trk, side).Ptr[0][tptr] = 0xFE;   // Метка "Адрес"
+			FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+
+			FTracks(trk, side).Ptr[0][tptr] = tdsect->ADRM[0]; // cyl
+			FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+			FTracks(trk, side).Ptr[0][tptr] = tdsect->ADRM[1]; // head
+			FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+			FTracks(trk, side).Ptr[0][tptr] = tdsect->ADRM[2]; // secN
+			FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+			FTracks(trk, side).Ptr[0][tptr] = tdsect->ADRM[3]; // len code
+			FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+
+			vgcrc = MakeVGCRC(FTracks(trk, side).Ptr[0] + ptrcrc, tptr - ptrcrc);
+			FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
+			FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+			FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc & 0xFF);
+			FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 			for (r = 0; r < SecondSpaceLen; r++)        // Второй пробел
 			{
-				FTracksPtr[trk][side][0][tptr] = 0x4E;
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 			}
 			for (r = 0; r < SynchroSpaceLen; r++)        // Синхропромежуток
 			{
-				FTracksPtr[trk][side][0][tptr] = 0x00;
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0x00;
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 			}
 
 			if (tdsect->DataLength - 1) // oh-oh, data area not present... ;-)
@@ -2653,12 +2703,12 @@ void TDiskImage::readTD0(int hfile, bool readonly)
 				ptrcrc = tptr;
 				for (r = 0; r < SynchroPulseLen; r++)        // Синхроимпульс
 				{
-					FTracksPtr[trk][side][0][tptr] = 0xA1;
-					FTracksPtr[trk][side][1][tptr++] = 0xFF;
+					FTracks(trk, side).Ptr[0][tptr] = 0xA1;
+					FTracks(trk, side).Ptr[1][tptr++] = 0xFF;
 				}
 
-				FTracksPtr[trk][side][0][tptr] = 0xFB;   // Метка "Данные"
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0xFB;   // Метка "Данные"
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 
 				//            SL = unsigned(tdsect->ADRM[3]);
 				//            if(!SL) SL = 128;
@@ -2667,30 +2717,30 @@ void TDiskImage::readTD0(int hfile, bool readonly)
 
 				for (r = 0; r < SL; r++)        // сектор SL байт
 				{
-					FTracksPtr[trk][side][0][tptr] = ptr[tdOFF + r];
-					FTracksPtr[trk][side][1][tptr++] = 0x00;
+					FTracks(trk, side).Ptr[0][tptr] = ptr[tdOFF + r];
+					FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 				}
 				tdOFF += SL;
 
-				vgcrc = MakeVGCRC(FTracksPtr[trk][side][0] + ptrcrc, tptr - ptrcrc);
+				vgcrc = MakeVGCRC(FTracks(trk, side).Ptr[0] + ptrcrc, tptr - ptrcrc);
 
 
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
-				FTracksPtr[trk][side][0][tptr] = (unsigned char)(vgcrc & 0xFF);
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc >> 8); // VG93 CRC
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = (unsigned char)(vgcrc & 0xFF);
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 			}
 
 			for (r = 0; r < ThirdSpaceLen; r++)        // Третий пробел
 			{
-				FTracksPtr[trk][side][0][tptr] = 0x4E;
-				FTracksPtr[trk][side][1][tptr++] = 0x00;
+				FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+				FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 			}
 		}
 		for (int eoftrk = tptr; eoftrk < 6250; eoftrk++)
 		{
-			FTracksPtr[trk][side][0][tptr] = 0x4E;
-			FTracksPtr[trk][side][1][tptr++] = 0x00;
+			FTracks(trk, side).Ptr[0][tptr] = 0x4E;
+			FTracks(trk, side).Ptr[1][tptr++] = 0x00;
 		}
 
 		if (unsigned(MaxTrack) < trk) MaxTrack = trk;
@@ -2821,7 +2871,7 @@ bool unpack_td0(unsigned char *data, long &size)
 			td0_src = end_packed_data;
 		}
 	}
-	size = unsigned(td0_dst) - unsigned(data);
+	size = unsigned(td0_dst - data);
 	delete[] snbuf;
 	return true;
 }
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <algorithm>
+
+#include "blkprof.h"
+#include "cfg.h"
+#include "hardware.h"
+#include "offload.h"
+#include "profiling.h"
+#include "miniz.h"
+
+#define BLKPROF_DIR       "blkprof"
+#define BLKPROF_NAME_MAX  128 // image name part, the path must fit FileSaveConfig's 256 bytes
+#define BLKPROF_MAGIC     0x46504B42 // BKPF
+#define BLKPROF_VERSION   1
+#define BLKPROF_SLOTS     20
+#define BLKPROF_MIN_SIZE  (16 * 1024 * 1024) // floppy sized images are not profiled
+#define BLKPROF_REGIONS   65536
+#define BLKPROF_MIN_SHIFT 16                 // regions are at least 64KB
+#define BLKPROF_LAT_BINS  16
+#define BLKPROF_SAVE      60000              // ms between saves of updated profiles
+#define BLKPROF_WARM_MAX  (64 * 1024 * 1024)
+
+struct blkprof_hdr_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t image_size;
+	uint32_t name_crc;
+	uint32_t shift;
+	uint32_t count;
+	uint32_t sessions;
+	uint32_t latency[2][BLKPROF_LAT_BINS]; // reads and writes, bin n counts < 2^n us
+};
+
+struct blkprof_region_t
+{
+	uint16_t rd;
+	uint16_t wr;
+};
+
+struct blkprof_t
+{
+	char name[300];
+	uint8_t *buf;
+	uint32_t size;
+	int dirty;
+};
+
+static blkprof_t profs[BLKPROF_SLOTS] = {};
+static unsigned long save_timer = 0;
+
+static blkprof_hdr_t *get_hdr(blkprof_t *p)
+{
+	return (blkprof_hdr_t*)p->buf;
+}
+
+static blkprof_region_t *get_regions(blkprof_t *p)
+{
+	return (blkprof_region_t*)(p->buf + sizeof(blkprof_hdr_t));
+}
+
+static void save(blkprof_t *p)
+{
+	uint8_t *buf = (uint8_t*)malloc(p->size);
+	char *name = strdup(p->name);
+	if (!buf || !name)
+	{
+		free(buf);
+		free(name);
+		return;
+	}
+
+	memcpy(buf, p->buf, p->size);
+	uint32_t size = p->size;
+	p->dirty = 0;
+
+	offload_add_work([buf, size, name]
+	{
+		FileSaveConfig(name, buf, size);
+		free(buf);
+		free(name);
+	});
+}
+
+// Prefetches the most read regions, up to BLKPROF_WARM_MAX, in file order.
+static void warmup(int fd, uint32_t shift, uint16_t *counts, uint32_t count)
+{
+	PROFILE_FUNCTION();
+
+	uint32_t *order = (uint32_t*)malloc(count * sizeof(uint32_t));
+	if (!order) return;
+
+	uint32_t hot = 0;
+	for (uint32_t i = 0; i < count; i++) if (counts[i]) order[hot++] = i;
+
+	uint32_t max = BLKPROF_WARM_MAX >> shift;
+	if (hot > max)
+	{
+		std::nth_element(order, order + max, order + hot, [counts](uint32_t a, uint32_t b) { return counts[a] > counts[b]; });
+		hot = max;
+	}
+	std::sort(order, order + hot);
+
+	for (uint32_t i = 0; i < hot;)
+	{
+		uint32_t run = 1;
+		while (i + run < hot && order[i + run] == order[i] + run) run++;
+		posix_fadvise(fd, (off_t)order[i] << shift, (off_t)run << shift, POSIX_FADV_WILLNEED);
+		i += run;
+	}
+
+	free(order);
+}
+
+static uint32_t get_shift(uint64_t size)
+{
+	uint32_t shift = BLKPROF_MIN_SHIFT;
+	while ((size >> shift) >= BLKPROF_REGIONS) shift++;
+	return shift;
+}
+
+void blkprof_open(int slot, fileTYPE *f, const char *path)
+{
+	blkprof_close(slot);
+	if (!cfg.blk_profile || slot < 0 || slot >= BLKPROF_SLOTS) return;
+	if (!f->filp || f->zip || f->type || f->size < BLKPROF_MIN_SIZE) return;
+
+	blkprof_t *p = &profs[slot];
+	uint32_t shift = get_shift(f->size);
+	uint32_t count = (uint32_t)((f->size + (1ULL << shift) - 1) >> shift);
+
+	p->size = sizeof(blkprof_hdr_t) + count * sizeof(blkprof_region_t);
+	p->buf = (uint8_t*)calloc(1, p->size);
+	if (!p->buf) return;
+
+	// images of the same name in different folders get their own profiles
+	const char *full_path = getFullPath(path);
+	uint32_t name_crc = crc32(0, (const uint8_t*)full_path, strlen(full_path));
+	snprintf(p->name, sizeof(p->name), BLKPROF_DIR"/%.*s_%08X.bpf", BLKPROF_NAME_MAX, f->name, name_crc);
+
+	blkprof_hdr_t *hdr = get_hdr(p);
+
+	int loaded = FileLoadConfig(p->name, 0, 0) == (int)p->size && FileLoadConfig(p->name, p->buf, p->size) &&
+		hdr->magic == BLKPROF_MAGIC && hdr->version == BLKPROF_VERSION && hdr->image_size == (uint64_t)f->size &&
+		hdr->name_crc == name_crc && hdr->shift == shift && hdr->count == count;
+
+	if (!loaded)
+	{
+		memset(p->buf, 0, p->size);
+		hdr->magic = BLKPROF_MAGIC;
+		hdr->version = BLKPROF_VERSION;
+		hdr->image_size = f->size;
+		hdr->name_crc = name_crc;
+		hdr->shift = shift;
+		hdr->count = count;
+		printf("blkprof: new profile for %s (%u regions of %uKB)\n", f->name, count, 1 << (shift - 10));
+		return;
+	}
+
+	hdr->sessions++;
+	printf("blkprof: loaded profile of %s, %u sessions\n", f->name, hdr->sessions);
+
+	blkprof_region_t *regions = get_regions(p);
+	uint16_t *counts = (cfg.blk_profile == 2) ? (uint16_t*)malloc(count * sizeof(uint16_t)) : 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (counts) counts[i] = regions[i].rd;
+
+		// older sessions count less
+		regions[i].rd >>= 1;
+		regions[i].wr >>= 1;
+	}
+
+	if (counts)
+	{
+		int fd = fcntl(fileno(f->filp), F_DUPFD_CLOEXEC, 0);
+		if (fd < 0)
+		{
+			free(counts);
+			return;
+		}
+
+		offload_add_work([fd, shift, counts, count]
+		{
+			warmup(fd, shift, counts, count);
+			close(fd);
+			free(counts);
+		});
+	}
+}
+
+void blkprof_close(int slot)
+{
+	if (slot < 0 || slot >= BLKPROF_SLOTS) return;
+
+	blkprof_t *p = &profs[slot];
+	if (p->buf && p->dirty) save(p);
+	free(p->buf);
+	memset(p, 0, sizeof(blkprof_t));
+}
+
+uint64_t blkprof_time()
+{
+	if (!cfg.blk_profile) return 0;
+
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return ((uint64_t)tp.tv_sec * 1000000) + (tp.tv_nsec / 1000);
+}
+
+void blkprof_access(int slot, uint64_t offset, uint32_t len, int write, uint64_t start)
+{
+	if (!start || slot < 0 || slot >= BLKPROF_SLOTS || !len) return;
+
+	blkprof_t *p = &profs[slot];
+	if (!p->buf) return;
+
+	blkprof_hdr_t *hdr = get_hdr(p);
+	uint64_t us = blkprof_time() - start;
+	int bin = 0;
+	while (bin < BLKPROF_LAT_BINS - 1 && (1ULL << bin) <= us) bin++;
+	hdr->latency[write ? 1 : 0][bin]++;
+
+	blkprof_region_t *regions = get_regions(p);
+	uint32_t first = offset >> hdr->shift;
+	uint32_t last = (offset + len - 1) >> hdr->shift;
+	if (last >= hdr->count) last = hdr->count - 1;
+	for (uint32_t i = first; i <= last; i++)
+	{
+		uint16_t *cnt = write ? &regions[i].wr : &regions[i].rd;
+		if (*cnt != 0xFFFF) (*cnt)++;
+	}
+
+	p->dirty = 1;
+}
+
+void blkprof_poll()
+{
+	if (!cfg.blk_profile) return;
+	if (save_timer && !CheckTimer(save_timer)) return;
+	save_timer = GetTimer(BLKPROF_SAVE);
+
+	blkprof_sync();
+}
+
+void blkprof_sync()
+{
+	for (int i = 0; i < BLKPROF_SLOTS; i++)
+	{
+		if (profs[i].buf && profs[i].dirty) save(&profs[i]);
+	}
+}
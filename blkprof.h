@@ -0,0 +1,27 @@
+#ifndef BLKPROF_H
+#define BLKPROF_H
+
+#include <inttypes.h>
+#include "file_io.h"
+
+// Block access profiler for mounted hard disk images (blk_profile in MiSTer.ini).
+// Read/write counts per region and a latency histogram are kept per image in
+// config/blkprof. With blk_profile=2 the recorded hot set is prefetched into the
+// page cache on the offload thread when the image is mounted.
+
+#define BLKPROF_SD(n)  (n)      // user_io SD slots 0-15
+#define BLKPROF_IDE(n) (16 + n) // IDE units 0-3
+
+// path is the mount path, profiles are keyed on its full form.
+void blkprof_open(int slot, fileTYPE *f, const char *path);
+void blkprof_close(int slot);
+
+// Timestamp to pass to blkprof_access, 0 if profiling is off.
+uint64_t blkprof_time();
+void blkprof_access(int slot, uint64_t offset, uint32_t len, int write, uint64_t start);
+
+// Periodically saves updated profiles.
+void blkprof_poll();
+void blkprof_sync();
+
+#endif
@@ -135,6 +135,9 @@ static const ini_var_t ini_vars[] =
 	{ "MAIN", (void*)(&(cfg.main)), STRING, 0, sizeof(cfg.main) - 1 },
 	{"VFILTER_INTERLACE_DEFAULT", (void*)(&(cfg.vfilter_interlace_default)), STRING, 0, sizeof(cfg.vfilter_interlace_default) - 1 },
 	{ "AUTOFIRE_RATES", (void *)(&(cfg.autofire_rates)), STRING, 0, sizeof(cfg.autofire_rates) - 1 },
+	{ "INPUT_LATENCY", (void *)(&(cfg.input_latency)), UINT8, 0, 1 },
+	{ "SD_MMAP", (void *)(&(cfg.sd_mmap)), UINT8, 0, 1 },
+	{ "BLK_PROFILE", (void *)(&(cfg.blk_profile)), UINT8, 0, 2 },
 
 };
 
@@ -586,6 +589,7 @@ void cfg_parse()
 	cfg.wheel_force = 50;
 	cfg.dvi_mode = 2;
 	cfg.lookahead = 2;
+	cfg.sd_mmap = 1;
 	cfg.hdr = 0;
 	cfg.hdr_max_nits = 1000;
 	cfg.hdr_avg_nits = 250;
@@ -103,6 +103,9 @@ typedef struct {
 	char main[1024];
 	char vfilter_interlace_default[1023];
 	char autofire_rates[256];
+	uint8_t input_latency;
+	uint8_t sd_mmap;
+	uint8_t blk_profile;
 
 } cfg_t;
 
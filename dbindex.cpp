@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <algorithm>
+
+#include "dbindex.h"
+#include "file_io.h"
+#include "profiling.h"
+#include "miniz.h"
+
+#define DBINDEX_DIR     "dbindex"
+#define DBINDEX_MAGIC   0x58444944 // DIDX
+#define DBINDEX_VERSION 1
+#define DBINDEX_KEYLEN  32
+#define DBINDEX_CACHED  4
+
+struct dbindex_hdr_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t kind;
+	uint32_t path_crc;
+	uint64_t txt_size;
+	int64_t  txt_mtime;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+struct dbindex_ent_t
+{
+	uint8_t  type;
+	uint8_t  reserved[3];
+	uint32_t offset;
+	char     key[DBINDEX_KEYLEN];
+};
+
+// Cart ID patterns contain wildcards, so they are kept in file order.
+static int ent_cmp(const dbindex_ent_t *a, int type, const char *key, uint32_t offset)
+{
+	if (a->type != type) return (a->type < type) ? -1 : 1;
+	if (type != DBK_CARTID)
+	{
+		int res = memcmp(a->key, key, DBINDEX_KEYLEN);
+		if (res) return res;
+	}
+	if (a->offset != offset) return (a->offset < offset) ? -1 : 1;
+	return 0;
+}
+
+struct DbIndexComp
+{
+	bool operator()(const dbindex_ent_t &a, const dbindex_ent_t &b) const
+	{
+		return ent_cmp(&a, b.type, b.key, b.offset) < 0;
+	}
+};
+
+struct dbindex_map_t
+{
+	char path[1024];
+	int kind;
+	uint64_t txt_size;
+	int64_t txt_mtime;
+	void *map;
+	size_t map_size;
+};
+
+static dbindex_map_t dbi_maps[DBINDEX_CACHED] = {};
+static int dbi_next = 0;
+
+static void make_key(char *key, const char *src, int len)
+{
+	memset(key, 0, DBINDEX_KEYLEN);
+	if (len > DBINDEX_KEYLEN) len = DBINDEX_KEYLEN;
+	for (int i = 0; i < len; i++) key[i] = tolower(src[i]);
+}
+
+static int parse_line(int kind, const char *line, dbindex_ent_t *ent)
+{
+	if (kind == DBI_N64)
+	{
+		if (!strncmp(line, "ID:", 3))
+		{
+			const char *p = line + 3;
+			int len = 0;
+			while (p[len] && !isspace(p[len])) len++;
+			ent->type = DBK_CARTID;
+			make_key(ent->key, p, len);
+			return 1;
+		}
+
+		for (int i = 0; i < DBINDEX_KEYLEN; i++) if (!isxdigit(line[i])) return 0;
+		ent->type = DBK_MD5;
+		make_key(ent->key, line, DBINDEX_KEYLEN);
+		return 1;
+	}
+
+	const char *gcom = strchr(line, ',');
+	if (!gcom || gcom == line) return 0;
+	ent->type = DBK_GUID;
+	make_key(ent->key, line, gcom - line);
+	return 1;
+}
+
+static const char *index_name(const char *full)
+{
+	static char name[300];
+	const char *p = strrchr(full, '/');
+	snprintf(name, sizeof(name), DBINDEX_DIR"/%s.idx", p ? p + 1 : full);
+	return name;
+}
+
+static int build_index(const char *full, int kind, const struct stat64 *st, uint32_t path_crc)
+{
+	PROFILE_FUNCTION();
+
+	fileTextReader reader = {};
+	if (!FileOpenTextReader(&reader, full)) return 0;
+
+	std::vector<dbindex_ent_t> ents;
+	while (const char *line = FileReadLine(&reader))
+	{
+		dbindex_ent_t ent = {};
+		ent.offset = line - reader.buffer;
+		if (parse_line(kind, line, &ent)) ents.push_back(ent);
+	}
+
+	std::sort(ents.begin(), ents.end(), DbIndexComp());
+
+	uint32_t size = sizeof(dbindex_hdr_t) + ents.size() * sizeof(dbindex_ent_t);
+	uint8_t *buf = (uint8_t*)malloc(size);
+	if (!buf) return 0;
+
+	dbindex_hdr_t *hdr = (dbindex_hdr_t*)buf;
+	memset(hdr, 0, sizeof(dbindex_hdr_t));
+	hdr->magic = DBINDEX_MAGIC;
+	hdr->version = DBINDEX_VERSION;
+	hdr->kind = kind;
+	hdr->path_crc = path_crc;
+	hdr->txt_size = st->st_size;
+	hdr->txt_mtime = st->st_mtime;
+	hdr->count = ents.size();
+	if (!ents.empty()) memcpy(buf + sizeof(dbindex_hdr_t), ents.data(), ents.size() * sizeof(dbindex_ent_t));
+
+	int ret = FileSaveConfig(index_name(full), buf, size);
+	free(buf);
+
+	printf("dbindex: indexed %u entries of %s\n", (uint32_t)ents.size(), full);
+	return ret;
+}
+
+static int map_valid(const dbindex_map_t *m, uint32_t path_crc)
+{
+	if (m->map_size < sizeof(dbindex_hdr_t)) return 0;
+	const dbindex_hdr_t *hdr = (const dbindex_hdr_t*)m->map;
+	return hdr->magic == DBINDEX_MAGIC && hdr->version == DBINDEX_VERSION && (int)hdr->kind == m->kind &&
+		hdr->path_crc == path_crc && hdr->txt_size == m->txt_size && hdr->txt_mtime == m->txt_mtime &&
+		m->map_size == sizeof(dbindex_hdr_t) + hdr->count * sizeof(dbindex_ent_t);
+}
+
+static void map_release(dbindex_map_t *m)
+{
+	if (m->map) munmap(m->map, m->map_size);
+	m->map = 0;
+	m->map_size = 0;
+	m->path[0] = 0;
+}
+
+static int map_open(dbindex_map_t *m, const char *full)
+{
+	char idx_path[1024];
+	snprintf(idx_path, sizeof(idx_path), "%s", getFullPath(CONFIG_DIR"/"));
+	strncat(idx_path, index_name(full), sizeof(idx_path) - strlen(idx_path) - 1);
+
+	int fd = open(idx_path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return 0;
+
+	struct stat64 st;
+	if (fstat64(fd, &st) < 0 || !st.st_size)
+	{
+		close(fd);
+		return 0;
+	}
+
+	void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return 0;
+
+	m->map = map;
+	m->map_size = st.st_size;
+	return 1;
+}
+
+static dbindex_map_t *get_index(const char *full, int kind)
+{
+	struct stat64 st;
+	if (stat64(full, &st) < 0) return 0;
+
+	uint32_t path_crc = crc32(0, (const uint8_t*)full, strlen(full));
+
+	dbindex_map_t *m = 0;
+	for (int i = 0; i < DBINDEX_CACHED; i++)
+	{
+		if (dbi_maps[i].map && dbi_maps[i].kind == kind && !strcmp(dbi_maps[i].path, full))
+		{
+			m = &dbi_maps[i];
+			break;
+		}
+	}
+
+	if (m && m->txt_size == (uint64_t)st.st_size && m->txt_mtime == st.st_mtime) return m;
+
+	if (!m)
+	{
+		m = &dbi_maps[dbi_next];
+		dbi_next = (dbi_next + 1) % DBINDEX_CACHED;
+	}
+
+	map_release(m);
+	snprintf(m->path, sizeof(m->path), "%s", full);
+	m->kind = kind;
+	m->txt_size = st.st_size;
+	m->txt_mtime = st.st_mtime;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (map_open(m, full) && map_valid(m, path_crc)) return m;
+		map_release(m);
+		if (pass || !build_index(full, kind, &st, path_crc)) break;
+		snprintf(m->path, sizeof(m->path), "%s", full);
+	}
+
+	m->path[0] = 0;
+	return 0;
+}
+
+// '_' in a cart ID pattern matches any character, shorter patterns match a prefix.
+static int cartid_match(const char *pattern, const char *key)
+{
+	if (!pattern[0]) return 0;
+	for (int i = 0; i < DBINDEX_KEYLEN && pattern[i] && key[i]; i++)
+	{
+		if (pattern[i] != '_' && pattern[i] != key[i]) return 0;
+	}
+	return 1;
+}
+
+static int read_line(int fd, uint32_t offset, char *line, int size)
+{
+	int len = pread(fd, line, size - 1, offset);
+	if (len <= 0) return 0;
+
+	line[len] = 0;
+	char *p = line;
+	while (*p && *p != '\r' && *p != '\n') p++;
+	*p = 0;
+	return 1;
+}
+
+int dbindex_find(const char *txt_path, int kind, int key_type, const char *key, dbindex_cb_t cb, void *user)
+{
+	PROFILE_FUNCTION();
+
+	char full[1024];
+	snprintf(full, sizeof(full), "%s", getFullPath(txt_path));
+
+	dbindex_map_t *m = get_index(full, kind);
+	if (!m) return -1;
+
+	int fd = open(full, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return -1;
+
+	const dbindex_hdr_t *hdr = (const dbindex_hdr_t*)m->map;
+	const dbindex_ent_t *ents = (const dbindex_ent_t*)(hdr + 1);
+
+	char lkey[DBINDEX_KEYLEN] = {};
+	if (key) make_key(lkey, key, strlen(key));
+
+	// lower bound of (type, key, offset 0)
+	uint32_t lo = 0, hi = hdr->count;
+	while (lo < hi)
+	{
+		uint32_t mid = (lo + hi) / 2;
+		if (ent_cmp(&ents[mid], key_type, lkey, 0) < 0) lo = mid + 1;
+		else hi = mid;
+	}
+
+	int found = 0;
+	static char line[2048];
+	for (uint32_t i = lo; i < hdr->count; i++)
+	{
+		const dbindex_ent_t *ent = &ents[i];
+		if (ent->type != key_type) break;
+		if (key_type != DBK_CARTID && memcmp(ent->key, lkey, DBINDEX_KEYLEN)) break;
+		if (key_type == DBK_CARTID && key && !cartid_match(ent->key, lkey)) continue;
+		if (!read_line(fd, ent->offset, line, sizeof(line))) continue;
+
+		found++;
+		if (cb(line, user)) break;
+	}
+
+	close(fd);
+	return found;
+}
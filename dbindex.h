@@ -0,0 +1,23 @@
+#ifndef DBINDEX_H
+#define DBINDEX_H
+
+#include <inttypes.h>
+
+// text database layouts
+#define DBI_N64    0 // "<md5> tags" and "ID:<cartid> tags" lines
+#define DBI_GCDB   1 // "<guid>,<name>,<mapping>" lines
+
+// key types
+#define DBK_MD5    1
+#define DBK_CARTID 2 // patterns matching key ('_' = any) in file order, all entries if key is 0
+#define DBK_GUID   3
+
+// Return true to stop the search.
+typedef bool (*dbindex_cb_t)(const char *line, void *user);
+
+// Looks up a text database through a binary index in config/dbindex.
+// The index is (re)generated when the text file size or mtime changes.
+// Returns -1 if the text file can't be opened, otherwise the number of lines passed to cb.
+int dbindex_find(const char *txt_path, int kind, int key_type, const char *key, dbindex_cb_t cb, void *user);
+
+#endif
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <string>
+#include <mutex>
+
+#include "dircache.h"
+#include "file_io.h"
+#include "profiling.h"
+
+#define DIRCACHE_MAX 32
+#define DIRCACHE_WATCH (IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+struct dircache_dir_t
+{
+	std::string path;
+	int wd;
+	int valid;
+	uint32_t stamp;
+	std::vector<dircache_item_t> items;
+};
+
+// share servers call in from the offload thread
+static std::mutex dirs_lock;
+static dircache_dir_t dirs[DIRCACHE_MAX];
+static uint32_t dir_stamp = 0;
+static int ino_fd = -1;
+
+void dircache_name83(const char *src, char *dst)
+{
+	int namelen = 0;
+	int extlen = 0;
+
+	const char *p = strrchr(src, '/');
+	if (p) src = p + 1;
+
+	if (!strcmp(src, ".") || !strcmp(src, ".."))
+	{
+		namelen = strlen(src);
+	}
+	else
+	{
+		p = strrchr(src, '.');
+		if (!p) namelen = strlen(src);
+		else
+		{
+			namelen = p - src;
+			extlen = strlen(src) - namelen - 1;
+		}
+	}
+
+
+	char ext[4] = { ' ', ' ', ' ', 0 };
+	if (p) memcpy(ext, p + 1, extlen);
+	for (int i = 0; i < namelen; i++) dst[i] = toupper(src[i]);
+	while (namelen < 8) dst[namelen++] = ' ';
+	for (int i = 0; i < 3; i++) dst[8 + i] = toupper(ext[i]);
+}
+
+static int fits83(const char *name)
+{
+	const char *ext = strrchr(name, '.');
+	if (!ext) return strlen(name) <= 8;
+	return (ext - name) <= 8 && strlen(ext + 1) <= 3;
+}
+
+static void release_watch(dircache_dir_t *dir)
+{
+	if (dir->wd < 0) return;
+
+	// the same inode may be cached under another path
+	int shared = 0;
+	for (int i = 0; i < DIRCACHE_MAX; i++) if (&dirs[i] != dir && dirs[i].wd == dir->wd) shared = 1;
+	if (!shared) inotify_rm_watch(ino_fd, dir->wd);
+	dir->wd = -1;
+}
+
+static void drain_events()
+{
+	if (ino_fd < 0) return;
+
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	int len;
+	while ((len = read(ino_fd, buf, sizeof(buf))) > 0)
+	{
+		for (char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len)
+		{
+			const struct inotify_event *ev = (const struct inotify_event*)p;
+			for (int i = 0; i < DIRCACHE_MAX; i++)
+			{
+				if (dirs[i].wd != ev->wd) continue;
+				dirs[i].valid = 0;
+				if (ev->mask & IN_IGNORED) dirs[i].wd = -1;
+			}
+		}
+	}
+}
+
+// inotify doesn't see changes made by other hosts on network mounts
+static int local_fs(const char *path)
+{
+	struct statfs fs;
+	if (statfs(path, &fs) < 0) return 0;
+
+	switch ((uint32_t)fs.f_type)
+	{
+	case 0x6969:     // NFS
+	case 0xFF534D42: // CIFS
+	case 0xFE534D42: // SMB2
+	case 0x517B:     // SMB
+	case 0x65735546: // FUSE
+		return 0;
+	}
+
+	return 1;
+}
+
+static int read_dir(dircache_dir_t *dir)
+{
+	PROFILE_FUNCTION();
+
+	DIR *d = opendir(dir->path.c_str());
+	if (!d) return 0;
+
+	dir->items.clear();
+
+	struct dirent64 *de;
+	while ((de = readdir64(d)))
+	{
+		struct stat64 st;
+		if (fstatat64(dirfd(d), de->d_name, &st, 0) < 0) continue;
+
+		dircache_item_t item = {};
+		strcpy(item.name, de->d_name);
+		if (fits83(de->d_name))
+		{
+			dircache_name83(de->d_name, item.name83);
+			item.name83[11] = 0;
+		}
+		item.type = de->d_type;
+		item.mode = st.st_mode;
+		item.size = st.st_size;
+		item.mtime = st.st_mtime;
+		dir->items.push_back(item);
+	}
+
+	closedir(d);
+	return 1;
+}
+
+static const std::vector<dircache_item_t> *get_dir(const char *path)
+{
+	if (ino_fd < 0)
+	{
+		ino_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (ino_fd < 0) printf("dircache: inotify is not available, caching is disabled.\n");
+	}
+
+	const char *full = getFullPath(path);
+	drain_events();
+
+	dircache_dir_t *dir = 0;
+	for (int i = 0; i < DIRCACHE_MAX; i++)
+	{
+		if (dirs[i].stamp && dirs[i].path == full)
+		{
+			dir = &dirs[i];
+			break;
+		}
+	}
+
+	if (!dir)
+	{
+		// evict the least recently used directory
+		dir = &dirs[0];
+		for (int i = 1; i < DIRCACHE_MAX; i++)
+		{
+			if (dirs[i].stamp < dir->stamp) dir = &dirs[i];
+		}
+
+		if (dir->stamp) release_watch(dir);
+		dir->path = full;
+		dir->wd = -1;
+		dir->valid = 0;
+	}
+
+	dir->stamp = ++dir_stamp;
+	if (dir->valid) return &dir->items;
+
+	// watch before reading, so changes made during the read invalidate it again
+	if (dir->wd < 0 && ino_fd >= 0 && local_fs(full)) dir->wd = inotify_add_watch(ino_fd, full, DIRCACHE_WATCH);
+
+	if (!read_dir(dir))
+	{
+		release_watch(dir);
+		dir->items.clear();
+		dir->stamp = 0;
+		return 0;
+	}
+
+	// without a watch the listing is used for this request only
+	dir->valid = (dir->wd >= 0);
+	return &dir->items;
+}
+
+int dircache_get(const char *path, std::vector<dircache_item_t> &items, std::function<bool(const dircache_item_t &)> filter)
+{
+	PROFILE_FUNCTION();
+
+	std::lock_guard<std::mutex> lock(dirs_lock);
+	const std::vector<dircache_item_t> *dir = get_dir(path);
+	if (!dir) return 0;
+
+	for (const dircache_item_t &item : *dir)
+	{
+		if (!filter || filter(item)) items.push_back(item);
+	}
+
+	return 1;
+}
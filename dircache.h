@@ -0,0 +1,28 @@
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <inttypes.h>
+#include <time.h>
+#include <vector>
+#include <functional>
+
+struct dircache_item_t
+{
+	char     name[256];
+	char     name83[12]; // space padded "NAME    EXT", empty if the name doesn't fit 8.3
+	uint8_t  type;       // DT_* from readdir
+	uint32_t mode;
+	uint64_t size;
+	time_t   mtime;
+};
+
+// Copies the cached listing of path, including "." and "..", into items. Entries which can't
+// be stat'ed are left out, filter (if given) selects the entries to copy.
+// Directories are watched through inotify and re-read after any change. Directories which
+// can't be watched (e.g. on network mounts) are re-read on every call.
+// Returns 0 if path is not a readable directory. Can be called from any thread.
+int dircache_get(const char *path, std::vector<dircache_item_t> &items, std::function<bool(const dircache_item_t &)> filter = nullptr);
+
+void dircache_name83(const char *src, char *dst);
+
+#endif
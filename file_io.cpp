@@ -32,6 +32,7 @@
 #include "scheduler.h"
 #include "video.h"
 #include "support.h"
+#include "memimg.h"
 
 #define MIN(a,b) (((a)<(b)) ? (a) : (b))
 
@@ -52,18 +53,20 @@ DirNameSet DirNames;
 // in a zip archive, the zip will only be opened once and things will be more responsive
 // ** We have to open the file outselves with open() so we can set O_CLOEXEC to prevent
 // leaking the file descriptor when the user changes cores
+// The cache is per thread, share servers open zips on the offload thread.
 
-static mz_zip_archive last_zip_archive = {};
-static int last_zip_fd = -1;
-static FILE *last_zip_cfile = NULL;
-static char last_zip_fname[256] = {};
+static thread_local mz_zip_archive last_zip_archive = {};
+static thread_local int last_zip_fd = -1;
+static thread_local FILE *last_zip_cfile = NULL;
+static thread_local char last_zip_fname[256] = {};
 static char scanned_path[1024] = {};
 static int scanned_opts = 0;
 
 static int iSelectedEntry = 0;       // selected entry index
 static int iFirstEntry = 0;
 
-static char full_path[2100];
+// per thread, share servers resolve paths on the offload thread
+static thread_local char full_path[2100];
 uint8_t loadbuf[LOADBUF_SZ];
 
 fileTYPE::fileTYPE()
@@ -174,7 +177,7 @@ static int get_stmode(const char *path)
 struct stat64* getPathStat(const char *path)
 {
 	make_fullpath(path);
-	static struct stat64 st;
+	static thread_local struct stat64 st;
 	return (stat64(full_path, &st) >= 0) ? &st : NULL;
 }
 
@@ -294,6 +297,7 @@ void FileClose(fileTYPE *file)
 	if (file->filp)
 	{
 		//printf("closing %p\n", file->filp);
+		if (file->type == 1) memimg_release(file);
 		fclose(file->filp);
 		if (file->type == 1)
 		{
@@ -455,7 +459,7 @@ int FileOpenEx(fileTYPE *file, const char *name, int mode, char mute, int use_zi
 	}
 	else
 	{
-		int fd = (mode == -1) ? shm_open("/vdsk", O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0777) : open(full_path, mode | O_CLOEXEC, 0777);
+		int fd = (mode == -1) ? shm_open(full_path, O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0777) : open(full_path, mode | O_CLOEXEC, 0777);
 		if (fd <= 0)
 		{
 			if(!mute) printf("FileOpenEx(open) File:%s, error: %s.\n", full_path, strerror(errno));
@@ -590,7 +594,7 @@ int FileSeek(fileTYPE *file, __off64_t offset, int origin)
 			file->zip->offset = 0;
 		}
 
-		static char buf[4*1024];
+		static thread_local char buf[4*1024];
 		while (file->zip->offset < offset)
 		{
 			const size_t want_len = MIN((__off64_t)sizeof(buf), offset - file->zip->offset);
@@ -1665,33 +1669,39 @@ int ScanDirectory(char* path, int mode, const char *extension, int options, cons
 							found = !strcasecmp(de->d_name + strlen(de->d_name) - 4, ".iso");
 						}
 
-						char *fext = strrchr(de->d_name, '.');
+						const char *fext = strrchr(de->d_name, '.');
 						if (fext) fext++;
-						while (!found && *ext && fext)
-						{
-							char e[4];
-							memcpy(e, ext, 3);
-							if (e[2] == ' ')
-							{
-								e[2] = 0;
-								if (e[1] == ' ') e[1] = 0;
-							}
 
-							e[3] = 0;
-							found = 1;
-							for (int i = 0; i < 4; i++)
+						// packed images (.gz/.zst) also match by their inner extension where they are mounted through memimg
+						const char *inner = (options & SCANO_MEMIMG) ? memimg_inner_ext(de->d_name) : 0;
+						for (int pass = 0; pass < 2 && !found; pass++, fext = inner, ext = extension)
+						{
+							while (!found && *ext && fext)
 							{
-								if (e[i] == '*') break;
-								if (e[i] == '?' && fext[i]) continue;
-
-								if (tolower(e[i]) != tolower(fext[i])) found = 0;
-
-								if (!e[i] || !found) break;
+								char e[4];
+								memcpy(e, ext, 3);
+								if (e[2] == ' ')
+								{
+									e[2] = 0;
+									if (e[1] == ' ') e[1] = 0;
+								}
+
+								e[3] = 0;
+								found = 1;
+								for (int i = 0; i < 4; i++)
+								{
+									if (e[i] == '*') break;
+									if (e[i] == '?' && fext[i]) continue;
+
+									if (tolower(e[i]) != tolower(fext[i])) found = 0;
+
+									if (!e[i] || !found) break;
+								}
+								if (found) break;
+
+								if (strlen(ext) < 3) break;
+								ext += 3;
 							}
-							if (found) break;
-
-							if (strlen(ext) < 3) break;
-							ext += 3;
 						}
 						if (!found) continue;
 					}
@@ -76,6 +76,7 @@ char* flist_GetPrevNext(const char* base_path, const char* file, const char* ext
 #define SCANO_NOZIP      0b001000000
 #define SCANO_CLEAR      0b010000000 // allow backspace key, clear FC option
 #define SCANO_SAVES      0b100000000
+#define SCANO_MEMIMG     0b1000000000 // match .gz/.zst packed images by inner extension
 
 void FindStorage();
 int  getStorage(int from_setting);
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <semaphore.h>
+
+#include "file_tx.h"
+#include "user_io.h"
+#include "menu.h"
+#include "offload.h"
+#include "profiling.h"
+
+#define TX_BUFS     4
+#define TX_BUF_SZ   (256 * 1024)
+#define TX_PROGRESS (64 * 1024)
+#define DDR_BUF_SZ  (1024 * 1024)
+
+struct tx_ring_t
+{
+	fileTYPE *f;
+	int       fd;            // plain files are read with pread, bypassing stdio
+	uint8_t  *buf[TX_BUFS];
+	uint32_t  size[TX_BUFS]; // requested
+	uint32_t  len[TX_BUFS];  // read
+	sem_t     filled[TX_BUFS];
+};
+
+static tx_ring_t ring = {};
+
+static void ring_read(uint32_t slot, uint32_t len, __off64_t pos = -1)
+{
+	offload_add_work([slot, len, pos]
+	{
+		int ret;
+		if (pos < 0)
+		{
+			ret = FileReadAdv(ring.f, ring.buf[slot], len, -1);
+		}
+		else
+		{
+			ret = 0;
+			while ((uint32_t)ret < len)
+			{
+				ssize_t res = pread64(ring.fd, ring.buf[slot] + ret, len - ret, pos + ret);
+				if (res <= 0) break;
+				ret += res;
+			}
+		}
+		ring.len[slot] = (ret > 0) ? ret : 0;
+		sem_post(&ring.filled[slot]);
+	});
+}
+
+static int ring_open(fileTYPE *f, uint32_t buf_size = TX_BUF_SZ)
+{
+	for (int i = 0; i < TX_BUFS; i++)
+	{
+		if (posix_memalign((void**)&ring.buf[i], 4096, buf_size)) ring.buf[i] = 0;
+		if (!ring.buf[i])
+		{
+			while (i--)
+			{
+				free(ring.buf[i]);
+				ring.buf[i] = 0;
+			}
+			return 0;
+		}
+		sem_init(&ring.filled[i], 0, 0);
+	}
+
+	ring.f = f;
+	ring.fd = -1;
+	return 1;
+}
+
+static void ring_close()
+{
+	for (int i = 0; i < TX_BUFS; i++)
+	{
+		sem_destroy(&ring.filled[i]);
+		free(ring.buf[i]);
+		ring.buf[i] = 0;
+	}
+	ring.f = 0;
+	ring.fd = -1;
+}
+
+static void send_chunk(fileTYPE *f, uint8_t *buf, uint32_t pos, uint32_t len, uint32_t total, int use_progress)
+{
+	// sub-chunks keep the progress bar moving on slow cores
+	for (uint32_t off = 0; off < len; off += TX_PROGRESS)
+	{
+		uint32_t sz = (len - off > TX_PROGRESS) ? TX_PROGRESS : len - off;
+		user_io_file_tx_data(buf + off, sz);
+		if (use_progress) ProgressMessage("Loading", f->name, pos + off + sz, total);
+	}
+}
+
+uint32_t file_tx_send(fileTYPE *f, uint32_t len, file_tx_hook_t hook, int use_progress)
+{
+	PROFILE_FUNCTION();
+
+	uint32_t sent = 0;
+
+	if (!ring_open(f))
+	{
+		printf("file_tx: not enough memory, sending synchronously.\n");
+
+		static uint8_t buf[4096];
+		while (sent < len)
+		{
+			uint32_t chunk = (len - sent > sizeof(buf)) ? sizeof(buf) : len - sent;
+			int ret = FileReadAdv(f, buf, chunk, -1);
+			if (ret <= 0) break;
+
+			if (hook) hook(buf, sent, ret);
+			send_chunk(f, buf, sent, ret, len, use_progress);
+			sent += ret;
+			if ((uint32_t)ret < chunk) break;
+		}
+		return sent;
+	}
+
+	uint32_t queued = 0;
+	int pending = 0;
+	for (int i = 0; i < TX_BUFS && queued < len; i++)
+	{
+		ring.size[i] = (len - queued > TX_BUF_SZ) ? TX_BUF_SZ : len - queued;
+		ring_read(i, ring.size[i]);
+		queued += ring.size[i];
+		pending++;
+	}
+
+	uint32_t slot = 0;
+	while (pending)
+	{
+		sem_wait(&ring.filled[slot]);
+		pending--;
+
+		uint32_t got = ring.len[slot];
+		if (got)
+		{
+			if (hook) hook(ring.buf[slot], sent, got);
+			send_chunk(f, ring.buf[slot], sent, got, len, use_progress);
+			sent += got;
+		}
+
+		if (got < ring.size[slot])
+		{
+			printf("file_tx: short read, %u of %u bytes sent.\n", sent, len);
+			break;
+		}
+
+		if (queued < len)
+		{
+			ring.size[slot] = (len - queued > TX_BUF_SZ) ? TX_BUF_SZ : len - queued;
+			ring_read(slot, ring.size[slot]);
+			queued += ring.size[slot];
+			pending++;
+		}
+
+		slot = (slot + 1) % TX_BUFS;
+	}
+
+	// reads still in flight after a short read
+	while (pending--)
+	{
+		slot = (slot + 1) % TX_BUFS;
+		sem_wait(&ring.filled[slot]);
+	}
+
+	ring_close();
+	return sent;
+}
+
+uint32_t file_tx_ddr(fileTYPE *f, uint8_t *dst, uint32_t len, file_tx_hook_t hook, int use_progress)
+{
+	PROFILE_FUNCTION();
+
+	uint32_t sent = 0;
+
+	if (!ring_open(f, DDR_BUF_SZ))
+	{
+		printf("file_tx: not enough memory, loading synchronously.\n");
+
+		while (sent < len)
+		{
+			uint32_t chunk = (len - sent > (256 * 1024)) ? (256 * 1024) : len - sent;
+			int ret = FileReadAdv(f, dst + sent, chunk, -1);
+			if (ret <= 0) break;
+
+			if (hook) hook(dst + sent, sent, ret);
+			sent += ret;
+			if (use_progress) ProgressMessage("Loading", f->name, sent, len);
+			if ((uint32_t)ret < chunk) break;
+		}
+		return sent;
+	}
+
+	// Plain files are read straight from the descriptor at explicit offsets.
+	// Zip members still go through the sequential FileReadAdv.
+	__off64_t start = f->offset;
+	if (f->filp)
+	{
+		ring.fd = fileno(f->filp);
+		posix_fadvise(ring.fd, start, len, POSIX_FADV_SEQUENTIAL);
+	}
+
+	uint32_t queued = 0;
+	int pending = 0;
+	for (int i = 0; i < TX_BUFS && queued < len; i++)
+	{
+		ring.size[i] = (len - queued > DDR_BUF_SZ) ? DDR_BUF_SZ : len - queued;
+		ring_read(i, ring.size[i], (ring.fd < 0) ? -1 : start + queued);
+		queued += ring.size[i];
+		pending++;
+	}
+
+	uint32_t slot = 0;
+	while (pending)
+	{
+		sem_wait(&ring.filled[slot]);
+		pending--;
+
+		// The hook works on cached memory, so byte order fixes and hashing
+		// cost nothing extra; DDR is only written once, sequentially.
+		uint32_t got = ring.len[slot];
+		if (got)
+		{
+			if (hook) hook(ring.buf[slot], sent, got);
+			memcpy(dst + sent, ring.buf[slot], got);
+			sent += got;
+			if (use_progress) ProgressMessage("Loading", f->name, sent, len);
+		}
+
+		if (got < ring.size[slot])
+		{
+			printf("file_tx: short read, %u of %u bytes loaded.\n", sent, len);
+			break;
+		}
+
+		if (queued < len)
+		{
+			ring.size[slot] = (len - queued > DDR_BUF_SZ) ? DDR_BUF_SZ : len - queued;
+			ring_read(slot, ring.size[slot], (ring.fd < 0) ? -1 : start + queued);
+			queued += ring.size[slot];
+			pending++;
+		}
+
+		slot = (slot + 1) % TX_BUFS;
+	}
+
+	while (pending--)
+	{
+		slot = (slot + 1) % TX_BUFS;
+		sem_wait(&ring.filled[slot]);
+	}
+
+	// stdio position is stale after pread
+	if (ring.fd >= 0) FileSeek(f, start + sent, SEEK_SET);
+
+	ring_close();
+	return sent;
+}
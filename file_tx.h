@@ -0,0 +1,22 @@
+#ifndef FILE_TX_H
+#define FILE_TX_H
+
+#include <inttypes.h>
+#include <functional>
+
+#include "file_io.h"
+
+// Called in-stream on every chunk before it's sent. pos is relative to the start of the transfer.
+typedef std::function<void(uint8_t *buf, uint32_t pos, uint32_t len)> file_tx_hook_t;
+
+// Sends len bytes from the current position of f as FIO_FILE_TX_DAT. The file is read
+// into a ring of buffers on the offload thread while the previous ones go over the bus.
+// Returns number of bytes sent (less than len on a short read).
+uint32_t file_tx_send(fileTYPE *f, uint32_t len, file_tx_hook_t hook = nullptr, int use_progress = 0);
+
+// Loads len bytes from the current position of f into mapped FPGA memory. Plain files are
+// read with pread in 1MB chunks on the offload thread, skipping stdio. The hook may modify
+// the data (byte order) and runs on cached memory right before the single copy to dst.
+uint32_t file_tx_ddr(fileTYPE *f, uint8_t *dst, uint32_t len, file_tx_hook_t hook = nullptr, int use_progress = 0);
+
+#endif
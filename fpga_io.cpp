@@ -8,14 +8,19 @@
 #include <termios.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <inttypes.h>
 
 #include "fpga_io.h"
+#include "spi_trace.h"
 #include "file_io.h"
 #include "input.h"
 #include "osd.h"
 #include "menu.h"
 #include "shmem.h"
 #include "offload.h"
+#include "memimg.h"
+#include "blkprof.h"
+#include "fpga_sim.h"
 
 #include "fpga_base_addr_ac5.h"
 #include "fpga_manager.h"
@@ -26,13 +31,15 @@
 #define FPGA_REG_BASE 0xFF000000
 #define FPGA_REG_SIZE 0x01000000
 
-#define MAP_ADDR(x) (volatile uint32_t*)(&map_base[(((uint32_t)(x)) & 0xFFFFFF)>>2])
+#define MAP_ADDR(x) (volatile uint32_t*)(&map_base[(((uint32_t)(uintptr_t)(x)) & 0xFFFFFF)>>2])
 #define IS_REG(x) (((((uint32_t)(x))-1)>=(FPGA_REG_BASE - 1)) && ((((uint32_t)(x))-1)<(FPGA_REG_BASE + FPGA_REG_SIZE - 1)))
 
 #define fatal(x) munmap((void*)map_base, FPGA_REG_SIZE); close(fd); exit(x)
 
 static struct socfpga_reset_manager  *reset_regs   = (socfpga_reset_manager *)SOCFPGA_RSTMGR_ADDRESS;
+#ifndef MISTER_SIM
 static struct socfpga_fpga_manager   *fpgamgr_regs = (socfpga_fpga_manager *)SOCFPGA_FPGAMGRREGS_ADDRESS;
+#endif
 static struct socfpga_system_manager *sysmgr_regs  = (socfpga_system_manager *)SOCFPGA_SYSMGR_ADDRESS;
 static struct nic301_registers       *nic301_regs  = (nic301_registers *)SOCFPGA_L3REGS_ADDRESS;
 
@@ -48,6 +55,8 @@ static uint32_t *map_base;
 /* Timeout count */
 #define FPGA_TIMEOUT_CNT		0x1000000
 
+#ifndef MISTER_SIM
+
 /* Set CD ratio */
 static void fpgamgr_set_cd_ratio(unsigned long ratio)
 {
@@ -375,6 +384,23 @@ static int socfpga_load(const void *rbf_data, size_t rbf_size)
 	return fpgamgr_program_poll_usermode();
 }
 
+#else
+
+// no FPGA manager on the host, the simulated core is always in user mode
+static int fpgamgr_test_fpga_ready(void)
+{
+	return 1;
+}
+
+static int socfpga_load(const void *rbf_data, size_t rbf_size)
+{
+	(void)rbf_data;
+	printf("SIM: skipping bitstream (%u bytes).\n", (uint32_t)rbf_size);
+	return 0;
+}
+
+#endif
+
 static void do_bridge(uint32_t enable)
 {
 	if (enable)
@@ -461,12 +487,12 @@ int fpga_load_rbf(const char *name, const char *cfg, const char *xml)
 		}
 		else
 		{
-			printf("Bitstream size: %lld bytes\n", st.st_size);
+			printf("Bitstream size: %" PRId64 " bytes\n", (int64_t)st.st_size);
 
 			void *buf = malloc(st.st_size);
 			if (!buf)
 			{
-				printf("Couldn't allocate %llu bytes.\n", st.st_size);
+				printf("Couldn't allocate %" PRId64 " bytes.\n", (int64_t)st.st_size);
 				ret = -1;
 			}
 			else
@@ -507,31 +533,43 @@ int fpga_load_rbf(const char *name, const char *cfg, const char *xml)
 	return ret;
 }
 
+#ifdef MISTER_SIM
+#define fpga_gpo_writeN(value) fpga_sim_gpo_write(value)
+#define fpga_gpi_read() fpga_sim_gpi_read()
+#else
+#define fpga_gpo_writeN(value) writel((value), (void*)(SOCFPGA_MGR_ADDRESS + 0x10))
+#define fpga_gpi_read() (int)readl((void*)(SOCFPGA_MGR_ADDRESS + 0x14))
+#endif
+
 static uint32_t gpo_copy = 0;
 void inline fpga_gpo_write(uint32_t value)
 {
 	gpo_copy = value;
-	writel(value, (void*)(SOCFPGA_MGR_ADDRESS + 0x10));
+	fpga_gpo_writeN(value);
 }
 
-#define fpga_gpo_writeN(value) writel((value), (void*)(SOCFPGA_MGR_ADDRESS + 0x10))
 #define fpga_gpo_read() gpo_copy //readl((void*)(SOCFPGA_MGR_ADDRESS + 0x10))
-#define fpga_gpi_read() (int)readl((void*)(SOCFPGA_MGR_ADDRESS + 0x14))
 
 void fpga_core_write(uint32_t offset, uint32_t value)
 {
-	if (offset <= 0x1FFFFF) writel(value, (void*)(SOCFPGA_LWFPGASLAVES_ADDRESS + (offset & ~3)));
+	if (offset <= 0x1FFFFF) writel(value, (void*)(uintptr_t)(SOCFPGA_LWFPGASLAVES_ADDRESS + (offset & ~3)));
 }
 
 uint32_t fpga_core_read(uint32_t offset)
 {
-	if (offset <= 0x1FFFFF) return readl((void*)(SOCFPGA_LWFPGASLAVES_ADDRESS + (offset & ~3)));
+	if (offset <= 0x1FFFFF) return readl((void*)(uintptr_t)(SOCFPGA_LWFPGASLAVES_ADDRESS + (offset & ~3)));
 	return 0;
 }
 
 int fpga_io_init()
 {
+#ifdef MISTER_SIM
+	// HPS registers are plain memory on the host, GPO/GPI go to the SSPI model
+	map_base = (uint32_t*)calloc(1, FPGA_REG_SIZE);
+	fpga_sim_init();
+#else
 	map_base = (uint32_t*)shmem_map(FPGA_REG_BASE, FPGA_REG_SIZE);
+#endif
 	if (!map_base) return -1;
 
 	fpga_gpo_write(0);
@@ -596,6 +634,11 @@ void reboot(int cold)
 		shmem_unmap(buf, 0x1000);
 	}
 
+#ifdef MISTER_SIM
+	printf("SIM: reboot requested.\n");
+	exit(0);
+#endif
+
 	writel(1, &reset_regs->ctrl);
 	while (1) sleep(1);
 }
@@ -620,6 +663,8 @@ void app_restart(const char *path, const char *xml, const char *exe)
 	input_switch(0);
 	input_uinp_destroy();
 
+	memimg_sync();
+	blkprof_sync();
 	offload_stop();
 
 	const char *appname = exe ? exe : getappname();
@@ -671,6 +716,8 @@ void fpga_wait_to_reset()
 
 uint16_t fpga_spi(uint16_t word)
 {
+	SPI_TRACE_WORD(word);
+
 	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE)) | word;
 
 	fpga_gpo_write(gpo);
@@ -704,8 +751,95 @@ uint16_t fpga_spi(uint16_t word)
 	return (uint16_t)gpi;
 }
 
+static int fpga_spi_wait_ack(int ack)
+{
+	int gpi;
+	do
+	{
+		gpi = fpga_gpi_read();
+		if (gpi < 0)
+		{
+			printf("GPI[31]==1. FPGA is uninitialized?\n");
+			fpga_wait_to_reset();
+			return 0;
+		}
+	} while (!!(gpi & SSPI_ACK) != ack);
+
+	return 1;
+}
+
+// Same handshake as fpga_spi(), so cores can still stall the transfer.
+void fpga_spi_block_write(const uint16_t *buf, uint32_t length)
+{
+	SPI_TRACE_BLOCK(length ? buf[0] : 0, length);
+
+	uint32_t gpoH = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
+	uint32_t gpo = gpoH;
+
+	while (length--)
+	{
+		gpo = gpoH | *buf++;
+		fpga_gpo_writeN(gpo);
+		fpga_gpo_writeN(gpo | SSPI_STROBE);
+		if (!fpga_spi_wait_ack(1)) return;
+		fpga_gpo_writeN(gpo);
+		if (!fpga_spi_wait_ack(0)) return;
+	}
+	fpga_gpo_write(gpo);
+}
+
+void fpga_spi_block_write_8(const uint8_t *buf, uint32_t length)
+{
+	SPI_TRACE_BLOCK(length ? buf[0] : 0, length);
+
+	uint32_t gpoH = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
+	uint32_t gpo = gpoH;
+
+	while (length--)
+	{
+		gpo = gpoH | *buf++;
+		fpga_gpo_writeN(gpo);
+		fpga_gpo_writeN(gpo | SSPI_STROBE);
+		if (!fpga_spi_wait_ack(1)) return;
+		fpga_gpo_writeN(gpo);
+		if (!fpga_spi_wait_ack(0)) return;
+	}
+	fpga_gpo_write(gpo);
+}
+
+void fpga_spi_block_read(uint16_t *buf, uint32_t length)
+{
+	SPI_TRACE_BLOCK(0, length);
+
+	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
+
+	while (length--)
+	{
+		fpga_gpo_writeN(gpo);
+		fpga_gpo_writeN(gpo | SSPI_STROBE);
+		if (!fpga_spi_wait_ack(1)) return;
+		fpga_gpo_writeN(gpo);
+
+		int gpi;
+		do
+		{
+			gpi = fpga_gpi_read();
+			if (gpi < 0)
+			{
+				printf("GPI[31]==1. FPGA is uninitialized?\n");
+				fpga_wait_to_reset();
+				return;
+			}
+		} while (gpi & SSPI_ACK);
+
+		*buf++ = (uint16_t)gpi;
+	}
+	fpga_gpo_write(gpo);
+}
+
 uint16_t fpga_spi_fast(uint16_t word)
 {
+	SPI_TRACE_WORD(word);
 	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE)) | word;
 	fpga_gpo_write(gpo);
 	fpga_gpo_write(gpo | SSPI_STROBE);
@@ -715,6 +849,8 @@ uint16_t fpga_spi_fast(uint16_t word)
 
 void fpga_spi_fast_block_write(const uint16_t *buf, uint32_t length)
 {
+	SPI_TRACE_BLOCK(length ? buf[0] : 0, length);
+
 	uint32_t gpoH = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 	uint32_t gpo = gpoH;
 
@@ -730,6 +866,8 @@ void fpga_spi_fast_block_write(const uint16_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_read(uint16_t *buf, uint32_t length)
 {
+	SPI_TRACE_BLOCK(0, length);
+
 	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 	uint32_t rem = length % 16;
 	length /= 16;
@@ -813,6 +951,8 @@ void fpga_spi_fast_block_read(uint16_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_write_8(const uint8_t *buf, uint32_t length)
 {
+	SPI_TRACE_BLOCK(length ? buf[0] : 0, length);
+
 	uint32_t gpoH = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 	uint32_t gpo = gpoH;
 	uint32_t rem = length % 16;
@@ -899,6 +1039,8 @@ void fpga_spi_fast_block_write_8(const uint8_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_read_8(uint8_t *buf, uint32_t length)
 {
+	SPI_TRACE_BLOCK(0, length);
+
 	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 	uint32_t rem = length % 16;
 	length /= 16;
@@ -982,6 +1124,8 @@ void fpga_spi_fast_block_read_8(uint8_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_write_be(const uint16_t *buf, uint32_t length)
 {
+	SPI_TRACE_BLOCK(length ? buf[0] : 0, length);
+
 	uint32_t gpoH = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 	uint32_t gpo = gpoH;
 
@@ -999,6 +1143,8 @@ void fpga_spi_fast_block_write_be(const uint16_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_read_be(uint16_t *buf, uint32_t length)
 {
+	SPI_TRACE_BLOCK(0, length);
+
 	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 
 	// should be optimized for speed by compiler automatically
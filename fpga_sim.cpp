@@ -0,0 +1,263 @@
+#ifdef MISTER_SIM
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+
+#include "fpga_sim.h"
+#include "user_io.h"
+
+#define GPO_STROBE   (1<<17)
+#define GPO_FPGA_EN  (1<<18)
+#define GPO_OSD_EN   (1<<19)
+#define GPO_IO_EN    (1<<20)
+#define GPO_USERMODE (1<<31)
+
+#define GPI_ACK      (1<<17)
+#define GPI_WIDE     (1<<16)
+
+#define TRACE_WORDS  32
+
+enum
+{
+	CH_NONE = -1,
+	CH_FPGA,
+	CH_OSD,
+	CH_IO
+};
+
+static const char *ch_names[] = { "fpga", "osd", "io" };
+
+struct sim_reply_t
+{
+	int ch;
+	uint16_t cmd;
+	std::vector<uint16_t> data;
+};
+
+// SD card request raised by the core, reported by UIO_GET_SDSTAT until its sectors are transferred
+struct sim_sd_req_t
+{
+	uint16_t stat;
+	uint32_t lba;
+	uint16_t fill;
+};
+
+static std::vector<sim_reply_t> replies;
+static std::deque<sim_sd_req_t> sd_reqs;
+static sim_reply_t sd_reply = {};
+static int sd_fill = -1;
+static uint32_t core_type = 0xA4;
+static uint32_t io_wide = 0;
+
+static uint32_t gpo = 0;
+static uint16_t dout = 0;
+static int ack = 0;
+
+static int cur_ch = CH_NONE;
+static uint32_t cur_idx = 0;
+static const sim_reply_t *cur_reply = 0;
+static uint16_t cur_words[TRACE_WORDS];
+
+static FILE *trace = 0;
+
+static int parse_channel(const char *name)
+{
+	for (int i = 0; i < (int)(sizeof(ch_names) / sizeof(ch_names[0])); i++)
+	{
+		if (!strcmp(name, ch_names[i])) return i;
+	}
+	return CH_NONE;
+}
+
+static void load_script(const char *path)
+{
+	FILE *fp = fopen(path, "rt");
+	if (!fp)
+	{
+		printf("SIM: can't open script %s\n", path);
+		return;
+	}
+
+	char line[1024];
+	while (fgets(line, sizeof(line), fp))
+	{
+		char *p = strchr(line, '#');
+		if (p) *p = 0;
+
+		char name[16];
+		int n = 0;
+		if (sscanf(line, "%15s %n", name, &n) != 1) continue;
+		p = line + n;
+
+		if (!strcmp(name, "core")) core_type = strtoul(p, 0, 16) & 0xFF;
+		else if (!strcmp(name, "wide")) io_wide = strtoul(p, 0, 0) ? GPI_WIDE : 0;
+		else if (!strcmp(name, "sd"))
+		{
+			char op[4] = {};
+			int disk = 0, lba = 0, blks = 1, fill = 0;
+			if (sscanf(p, "%i %3s %i %i %i", &disk, op, &lba, &blks, &fill) < 3 || disk < 0 || disk > 15 || blks < 1 || blks > 64 ||
+				(strcmp(op, "rd") && strcmp(op, "wr")))
+			{
+				printf("SIM: bad sd request: %s", p);
+				continue;
+			}
+
+			// 512 byte blocks
+			sim_sd_req_t req = {};
+			req.stat = 0x8000 | ((blks - 1) << 9) | (2 << 6) | (disk << 2) | (strcmp(op, "rd") ? 2 : 1);
+			req.lba = lba;
+			req.fill = (fill & 0xFF) * 0x101;
+			sd_reqs.push_back(req);
+		}
+		else
+		{
+			sim_reply_t reply = {};
+			reply.ch = parse_channel(name);
+			if (reply.ch == CH_NONE)
+			{
+				printf("SIM: unknown script entry: %s\n", name);
+				continue;
+			}
+
+			reply.cmd = strtoul(p, &p, 16);
+			while (*p == ' ' || *p == '\t') p++;
+
+			// the reply to the command word itself comes first
+			reply.data.push_back(0);
+			if (*p == '"')
+			{
+				for (p++; *p && *p != '"'; p++) reply.data.push_back((uint8_t)*p);
+				reply.data.push_back(0);
+			}
+			else
+			{
+				char *end;
+				for (uint32_t w = strtoul(p, &end, 16); end != p; w = strtoul(p, &end, 16))
+				{
+					reply.data.push_back(w);
+					p = end;
+				}
+			}
+
+			replies.push_back(reply);
+		}
+	}
+
+	fclose(fp);
+	printf("SIM: core type %02X, %d scripted replies, %d SD requests.\n", core_type, (int)replies.size(), (int)sd_reqs.size());
+}
+
+void fpga_sim_init()
+{
+	const char *script = getenv("MISTER_SIM_SCRIPT");
+	if (script) load_script(script);
+
+	const char *trace_path = getenv("MISTER_SIM_TRACE");
+	if (trace_path)
+	{
+		trace = fopen(trace_path, "wt");
+		if (!trace) printf("SIM: can't create trace %s\n", trace_path);
+	}
+}
+
+static void end_transfer()
+{
+	if (trace && cur_ch != CH_NONE && cur_idx)
+	{
+		fprintf(trace, "%s", ch_names[cur_ch]);
+		for (uint32_t i = 0; i < cur_idx && i < TRACE_WORDS; i++) fprintf(trace, " %04X", cur_words[i]);
+		if (cur_idx > TRACE_WORDS) fprintf(trace, " ... (%u words)", cur_idx);
+		fprintf(trace, "\n");
+	}
+
+	cur_idx = 0;
+	cur_reply = 0;
+	sd_fill = -1;
+}
+
+// Replaces the scripted reply while SD requests are pending.
+static void sd_transfer(uint16_t word)
+{
+	if (sd_reqs.empty()) return;
+
+	const sim_sd_req_t &req = sd_reqs.front();
+	if (word == UIO_GET_SDSTAT)
+	{
+		sd_reply.data = { req.stat, 0, (uint16_t)req.lba, (uint16_t)(req.lba >> 16) };
+		cur_reply = &sd_reply;
+	}
+	else if ((word & 0xFF) == UIO_SECTOR_RD || (word & 0xFF) == UIO_SECTOR_WR)
+	{
+		// data written by the core, read data goes to the trace
+		if ((word & 0xFF) == UIO_SECTOR_WR) sd_fill = req.fill;
+		printf("SIM: SD %s lba %u on disk %d served.\n", ((req.stat & 3) == 2) ? "write" : "read", req.lba, (req.stat >> 2) & 0xF);
+		sd_reqs.pop_front();
+	}
+}
+
+static uint16_t transfer_word(uint16_t word)
+{
+	if (!cur_idx)
+	{
+		for (const sim_reply_t &reply : replies)
+		{
+			if (reply.ch == cur_ch && reply.cmd == word)
+			{
+				cur_reply = &reply;
+				break;
+			}
+		}
+
+		if (cur_ch == CH_IO) sd_transfer(word);
+	}
+
+	uint16_t res = (cur_reply && cur_idx < cur_reply->data.size()) ? cur_reply->data[cur_idx] : 0;
+	if (sd_fill >= 0 && cur_idx) res = sd_fill;
+	if (cur_idx < TRACE_WORDS) cur_words[cur_idx] = word;
+	cur_idx++;
+	return res;
+}
+
+static int gpo_channel(uint32_t value)
+{
+	if (value & GPO_OSD_EN) return CH_OSD;
+	if (value & GPO_IO_EN) return CH_IO;
+	if (value & GPO_FPGA_EN) return CH_FPGA;
+	return CH_NONE;
+}
+
+void fpga_sim_gpo_write(uint32_t value)
+{
+	uint32_t old = gpo;
+	gpo = value;
+
+	int ch = gpo_channel(value);
+	if (ch != cur_ch)
+	{
+		end_transfer();
+		cur_ch = ch;
+	}
+
+	// the word is latched on the rising edge of strobe and acknowledged at once
+	if ((value & GPO_STROBE) && !(old & GPO_STROBE))
+	{
+		if (cur_ch != CH_NONE) dout = transfer_word(value & 0xFFFF);
+		ack = 1;
+	}
+	else if (!(value & GPO_STROBE))
+	{
+		ack = 0;
+	}
+}
+
+int fpga_sim_gpi_read()
+{
+	// core identity is readable while HPS user mode flag is clear
+	if (!(gpo & GPO_USERMODE)) return (0x5CA623 << 8) | core_type;
+	return dout | io_wide | (ack ? GPI_ACK : 0);
+}
+
+#endif
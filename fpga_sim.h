@@ -0,0 +1,24 @@
+#ifndef FPGA_SIM_H
+#define FPGA_SIM_H
+
+#include <inttypes.h>
+
+// Software model of the HPS GPO/GPI registers and the SSPI strobe/ack protocol,
+// used by host builds (make SIM=1) instead of the real FPGA.
+//
+// MISTER_SIM_SCRIPT=<file> sets the core identity and scripted replies:
+//   core <type>                   core type reported by fpga_core_id() (hex, default a4)
+//   wide <0|1>                    16-bit file I/O
+//   <fpga|io|osd> <cmd> <w0> ...  words returned for a transfer starting with cmd (hex)
+//   <fpga|io|osd> <cmd> "text"    string reply, one character per word, zero terminated
+//   sd <disk> <rd|wr> <lba> [<blocks> [<fill>]]
+//                                 SD request of 512 byte blocks raised by the core. Requests are
+//                                 reported by UIO_GET_SDSTAT in script order, each until its
+//                                 UIO_SECTOR_RD/WR transfer. Written sectors are filled with <fill>.
+// MISTER_SIM_TRACE=<file> records every transfer as "<ch> <cmd> <words...>".
+
+void fpga_sim_init();
+void fpga_sim_gpo_write(uint32_t gpo);
+int  fpga_sim_gpi_read();
+
+#endif
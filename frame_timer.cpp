@@ -17,6 +17,7 @@
 #define SEVENTYFIVEHERTZ 1326260 // highest refresh rate we consider valid 75.4hz
 
 uint64_t global_frame_counter = 0;
+static struct timespec frame_ts = {};
 
 extern VideoInfo current_video_info; // from video.cpp
 static bool timer_started = false;
@@ -136,4 +137,20 @@ void frame_timer() {
 		if (timer_started && check_vtimer())
 			global_frame_counter++;
 	}
+
+	static uint64_t last_frame = 0;
+	if (last_frame != global_frame_counter)
+	{
+		last_frame = global_frame_counter;
+		clock_gettime(CLOCK_MONOTONIC, &frame_ts);
+	}
+}
+
+uint8_t frame_timer_phase() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	uint64_t ns = (now.tv_sec - frame_ts.tv_sec) * 1000000000ULL + now.tv_nsec - frame_ts.tv_nsec;
+	uint64_t frame_ns = get_vtime() * 10ull;
+	return (ns >= frame_ns) ? 255 : (uint8_t)((ns * 256) / frame_ns);
 }
@@ -10,6 +10,9 @@
 
 void frame_timer();
 
+// position inside the current frame, 0-255 (0 = frame tick has just been seen)
+uint8_t frame_timer_phase();
+
 // global
 extern uint64_t global_frame_counter; // used by FRAME_TICK()
 extern bool fpga_vsync_timer;         // does this core expose the frame counter directly?
@@ -7,6 +7,8 @@
 #include "file_io.h"
 #include "user_io.h"
 #include "profiling.h"
+#include "str_util.h"
+#include "dbindex.h"
 
 
 
@@ -476,34 +478,34 @@ static bool parse_mapping_string(char *map_str, char *guid, int dev_fd, uint32_t
 #define GCDB_DIR  "/media/fat/linux/gamecontrollerdb/"
 
 
-bool read_controller_map_from_file(char *fname, char *guid, int dev_fd, uint32_t *fill_map)
+// the last matching entry in the file wins
+static bool guid_entry_match(const char *line, void *user)
 {
-	fileTextReader reader;
-	char matched[1024] = {};
-	char *map_start = NULL;
+	char *matched = (char *)user;
+	static char entry[2048];
 
-	if (FileOpenTextReader(&reader, fname))
+	strcpyz(entry, sizeof(entry), line);
+	char *gcom = strchr(entry, ',');
+	if (gcom && cdb_entry_matches(gcom))
 	{
-		const char *line;
-		printf("Gamecontrollerdb: searching for GUID %s in file %s\n", guid, fname);
-		while ((line = FileReadLine(&reader)))
+		char *map_start = strchr(gcom+1, ',');
+		if (map_start)
 		{
-			if (line[0] == '#') continue;
-			const char *gcom = strchr(line, ',');
-			if (!strncasecmp(line, guid, gcom-line))
-			{
-				if (cdb_entry_matches((char *)gcom))
-				{
-					map_start = strchr((char *)gcom+1, ',');
-					if (map_start)
-					{
-						strncpy(matched, map_start+1, sizeof(matched));
-					}
-				}
-			}
+			strncpy(matched, map_start+1, 1024);
+			matched[1023] = 0;
 		}
-
 	}
+
+	return false;
+}
+
+bool read_controller_map_from_file(char *fname, char *guid, int dev_fd, uint32_t *fill_map)
+{
+	char matched[1024] = {};
+
+	printf("Gamecontrollerdb: searching for GUID %s in file %s\n", guid, fname);
+	dbindex_find(fname, DBI_GCDB, DBK_GUID, guid, guid_entry_match, matched);
+
 	if (matched[0] != 0)
 	{
 		printf("Gamecontrollerdb: found match, using config %s\n", matched);
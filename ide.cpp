@@ -21,6 +21,7 @@
 #include "file_io.h"
 #include "hardware.h"
 #include "ide.h"
+#include "blkprof.h"
 
 #if 0
 	#define dbg_printf     printf
@@ -453,6 +454,9 @@ void ide_img_set(uint32_t drvnum, fileTYPE *f, int cd, int sectors, int heads, i
 	if (drive->placeholder && drive->present && !drive->cd) drive->placeholder = 0;
 	if (drive->placeholder) drive->cd = 1;
 
+	blkprof_close(BLKPROF_IDE(drvnum));
+	if (drive->present && !drive->cd) blkprof_open(BLKPROF_IDE(drvnum), drive->f, drive->f->path);
+
 	ide_reg_set(&ide_inst[port], 6, ((drive->present || drive->placeholder) ? 9 : 8) << (drv * 4));
 	ide_reg_set(&ide_inst[port], 6, 0x200);
 
@@ -761,7 +765,10 @@ inline int readhdd(drive_t *drive, uint32_t lba, int cnt)
 	}
 	else
 	{
-		return FileReadAdv(drive->f, ide_buf, cnt * 512, -1);
+		uint64_t prof_t = blkprof_time();
+		int ret = FileReadAdv(drive->f, ide_buf, cnt * 512, -1);
+		blkprof_access(BLKPROF_IDE(drive->drvnum), (uint64_t)(lba - drive->offset) * 512, cnt * 512, 0, prof_t);
+		return ret;
 	}
 }
 
@@ -864,7 +871,9 @@ static void process_write(ide_config *ide, int multi)
 		}
 		else
 		{
+			uint64_t prof_t = blkprof_time();
 			if (!ide->null) ide->null = (lba < ide->drive[ide->regs.drv].offset) ? 0 : (FileWriteAdv(ide->drive[ide->regs.drv].f, ide_buf, cnt * 512, -1) <= 0);
+			if (lba >= ide->drive[ide->regs.drv].offset) blkprof_access(BLKPROF_IDE(ide->drive[ide->regs.drv].drvnum), (uint64_t)(lba - ide->drive[ide->regs.drv].offset) * 512, cnt * 512, 1, prof_t);
 			lba += cnt;
 			ide->regs.sector_count -= cnt;
 			put_lba(ide, lba);
@@ -34,6 +34,7 @@
 #include "gamecontroller_db.h"
 #include "str_util.h"
 #include "frame_timer.h"
+#include "input_latency.h"
 
 #define NUMDEV 30
 #define UINPUT_NAME "MiSTer virtual input"
@@ -1834,11 +1835,26 @@ static inline void joy_clamp(int* value, const int min, const int max)
 	}
 }
 
-static inline float boxradf(const float angle)
+// Distance from center for |x|,|y| <= 128 in 1/256 units.
+static uint16_t joy_radius_lut[129][129];
+
+static uint32_t joy_radius_q8(int ax, int ay)
 {
-	return 1.0f / fmaxf(fabsf(sinf(angle)), fabsf(cosf(angle)));
+	if (ax > 128 || ay > 128) return (uint32_t)lrintf(hypotf(ax, ay) * 256.0f);
+
+	static bool init = false;
+	if (!init)
+	{
+		for (int i = 0; i <= 128; i++)
+			for (int j = 0; j <= 128; j++) joy_radius_lut[i][j] = (uint16_t)lrintf(hypotf(i, j) * 256.0f);
+		init = true;
+	}
+
+	return joy_radius_lut[ax][ay];
 }
 
+// Fixed point version of the radial scaled deadzone, no trigonometry needed:
+// the box radius for the angle is radius / max(|x|,|y|) and the direction is x/radius, y/radius.
 static void joy_apply_deadzone(int* x, int* y, const devInput* dev, const int stick) {
 	// Don't be fancy with such a small deadzone.
 	if (dev->deadzone <= 2) 
@@ -1848,34 +1864,41 @@ static void joy_apply_deadzone(int* x, int* y, const devInput* dev, const int st
 		return;
 	}
 
-	const float radius = hypotf(*x, *y);
-	if (radius <= (float)dev->deadzone)
+	const int ax = abs(*x), ay = abs(*y);
+	const int32_t radius = joy_radius_q8(ax, ay); // Q8
+	const int32_t deadzone = dev->deadzone << 8;  // Q8
+	if (radius <= deadzone)
 	{
 		*x = *y = 0;
 		return;
 	}
 
-	const float angle = atan2f(*y, *x);
-	const float box_radius = boxradf(angle);
+	const int32_t box_radius = (radius << 8) / ((ax > ay) ? ax : ay); // Q16, 1.0 - 1.414
 
 	/* A measure of how "cardinal" the angle is,
 	   i.e closeness to [0, 90, 180, 270] degrees (0.0 - 1.0). */
-	const float cardinality = (1.4142136f - box_radius) * 2.4142136f;
+	int32_t cardinality = (int32_t)(((int64_t)(92682 - box_radius) * 158217) >> 16); // (sqrt2 - box) * (1 + sqrt2), Q16
+	if (cardinality < 0) cardinality = 0;
+	if (cardinality > 65536) cardinality = 65536;
 
 	// Expected range for the given angle.
-	const float max_cardinal = dev->max_cardinal[stick] > (2.0f * dev->deadzone) ? dev->max_cardinal[stick] : 127.0f;
-	const float max_diagonal = dev->max_range[stick] > (2.0f * dev->deadzone) ? dev->max_range[stick] : 127.0f;
-	const float range = cardinality * max_cardinal + (1.0f - cardinality) * max_diagonal;
+	const int32_t max_cardinal = (dev->max_cardinal[stick] > (2 * (int)dev->deadzone) ? dev->max_cardinal[stick] : 127) << 8; // Q8
+	const int32_t max_diagonal = dev->max_range[stick] > (2.0f * dev->deadzone) ? (int32_t)lrintf(dev->max_range[stick] * 256.0f) : (127 << 8);
+	const int32_t range = (int32_t)(((int64_t)cardinality * max_cardinal + (int64_t)(65536 - cardinality) * max_diagonal) >> 16); // Q8
 
-	const float weight = 1.0f - fmaxf(range - radius, .0f) / (range - dev->deadzone);
-	const float adjusted_radius = fminf(weight * range, max_cardinal * box_radius);
+	const int32_t span = (range > deadzone) ? (range - deadzone) : 1;
+	const int32_t weight = 65536 - (int32_t)(((int64_t)((range > radius) ? (range - radius) : 0) << 16) / span); // Q16
+	int32_t adjusted_radius = (int32_t)(((int64_t)weight * range) >> 16);
+	const int32_t box_limit = (int32_t)(((int64_t)max_cardinal * box_radius) >> 16);
+	if (adjusted_radius > box_limit) adjusted_radius = box_limit;
 
 	/* Don't ever return a larger magnitude than that was given.
 	   The whole point of this function is to subtract some magnitude, not add. */
 	if (adjusted_radius > radius) return;
 
-	*x = nearbyintf(adjusted_radius * cosf(angle));
-	*y = nearbyintf(adjusted_radius * sinf(angle));
+	// round to nearest, away from zero
+	*x = (int)(((int64_t)adjusted_radius * *x * 2 + ((*x < 0) ? -radius : radius)) / (2 * radius));
+	*y = (int)(((int64_t)adjusted_radius * *y * 2 + ((*y < 0) ? -radius : radius)) / (2 * radius));
 
 	// Just to be sure.
 	const int min_range = is_psx() ? -128 : -127;
@@ -2045,6 +2068,8 @@ static void joy_digital(int jnum, uint32_t mask, uint32_t code, char press, int
 	int num = jnum - 1;
 	if (num < NUMPLAYERS)
 	{
+		input_latency_track(num);
+
 		// autofire handler moved to helper function for clarity
 		if (handle_autofire_toggle(num, mask, code, press, bnum, dont_save)) {
 			return;
@@ -2265,15 +2290,28 @@ static bool joy_dir_is_diagonal(const int x, const int y)
 		abs((x > y) == (x > -y) ? (float)y / x : (float)x / y) >= JOY_DIAG_THRESHOLD;
 }
 
+// Stick positions are collected from all events of the poll and sent once by joy_analog_flush().
+static int joy_analog_pos[2][NUMPLAYERS][2] = {};
+static int joy_analog_dev[2][NUMPLAYERS] = {}; // device index + 1, 0 if nothing to send
+
+// Last position sent per stick. Must be invalidated whenever the stick
+// is written elsewhere (digital to analog translation) or input is regrabbed.
+static int joy_analog_sent[2][NUMPLAYERS][2] = {};
+static bool joy_analog_valid[2][NUMPLAYERS] = {};
+
+static void joy_analog_invalidate()
+{
+	memset(joy_analog_valid, 0, sizeof(joy_analog_valid));
+}
+
 static void joy_analog(int dev, int axis, int offset, int stick = 0)
 {
 	int num = input[dev].num;
-	static int pos[2][NUMPLAYERS][2] = {};
 
 	if (grabbed && num > 0 && --num < NUMPLAYERS)
 	{
-		pos[stick][num][axis] = offset;
-		int x = pos[stick][num][0], y = pos[stick][num][1];
+		joy_analog_pos[stick][num][axis] = offset;
+		int x = joy_analog_pos[stick][num][0], y = joy_analog_pos[stick][num][1];
 
 		if (joy_dir_is_diagonal(x, y))
 		{
@@ -2294,23 +2332,61 @@ static void joy_analog(int dev, int axis, int offset, int stick = 0)
 			input[dev].max_cardinal[stick] = c_dist;
 		}
 
-		joy_apply_deadzone(&x, &y, &input[dev], stick);
+		joy_analog_dev[stick][num] = dev + 1;
+		input_latency_track(num);
+	}
+}
+
+static void joy_analog_flush()
+{
+	// sticks to send per player after N64 stick swap, and the player whose input caused it
+	int send[NUMPLAYERS][2] = {};
 
-		if (is_n64())
+	for (int player = 0; player < NUMPLAYERS; player++)
+	{
+		for (int src = 0; src < 2; src++)
 		{
-			// Emulate N64 joystick range and shape for regular -127-+127 controllers
-			n64_joy_emu(x, y, &x, &y, input[dev].max_cardinal[stick], input[dev].max_range[stick]);
-			stick_swap(num, stick, &num, &stick);
+			int dev = joy_analog_dev[src][player] - 1;
+			if (dev < 0) continue;
+			joy_analog_dev[src][player] = 0;
+
+			int num = player, stick = src;
+			int x = joy_analog_pos[src][player][0], y = joy_analog_pos[src][player][1];
+
+			joy_apply_deadzone(&x, &y, &input[dev], stick);
+
+			if (is_n64())
+			{
+				// Emulate N64 joystick range and shape for regular -127-+127 controllers
+				n64_joy_emu(x, y, &x, &y, input[dev].max_cardinal[stick], input[dev].max_range[stick]);
+				stick_swap(num, stick, &num, &stick);
+			}
+
+			// jitter inside the deadzone doesn't need to reach the core
+			if (joy_analog_valid[stick][num] && joy_analog_sent[stick][num][0] == x && joy_analog_sent[stick][num][1] == y) continue;
+			joy_analog_valid[stick][num] = true;
+			joy_analog_sent[stick][num][0] = x;
+			joy_analog_sent[stick][num][1] = y;
+			send[num][stick] = player + 1;
 		}
+	}
 
-		if (stick)
+	for (int num = 0; num < NUMPLAYERS; num++)
+	{
+		int *l = joy_analog_sent[0][num], *r = joy_analog_sent[1][num];
+
+		if (send[num][0] && send[num][1] && (user_io_get_caps() & UIO_CAP_ASTICK_PAIR))
 		{
-			user_io_r_analog_joystick(num, (char)x, (char)y);
+			user_io_analog_joystick_pair(num, (char)l[0], (char)l[1], (char)r[0], (char)r[1]);
 		}
 		else
 		{
-			user_io_l_analog_joystick(num, (char)x, (char)y);
+			if (send[num][0]) user_io_l_analog_joystick(num, (char)l[0], (char)l[1]);
+			if (send[num][1]) user_io_r_analog_joystick(num, (char)r[0], (char)r[1]);
 		}
+
+		if (send[num][0]) input_latency_sent(send[num][0] - 1);
+		if (send[num][1] && send[num][1] != send[num][0]) input_latency_sent(send[num][1] - 1);
 	}
 }
 
@@ -2459,6 +2535,7 @@ void reset_players()
 	for (int i = 0; i < NUMPLAYERS; i++) {
 		clear_autofire(i);
 	}
+	joy_analog_invalidate();
 	memset(player_pad, 0, sizeof(player_pad));
 	memset(player_pdsp, 0, sizeof(player_pdsp));
 }
@@ -2626,6 +2703,8 @@ static void input_cb(struct input_event *ev, struct input_absinfo *absinfo, int
 	//check if device is a part of multifunctional device
 	if (!JOYCON_COMBINED(dev) && input[dev].bind >= 0) dev = input[dev].bind;
 
+	input_latency_event(menu_event ? NULL : &ev->time, input[dev].name);
+
 	if (ev->type == EV_KEY)
 	{
 		if (input[dev].timeout > 0) input[dev].timeout = cfg.bt_auto_disconnect * 10;
@@ -5991,6 +6070,8 @@ int input_poll(int getchar)
 		autofire_mask[i] = build_autofire_mask(i);
 	}
 
+	joy_analog_flush();
+
 	if (grabbed)
 	{
 		for (int i = 0; i < NUMPLAYERS; i++) {
@@ -6000,6 +6081,8 @@ int input_poll(int getchar)
 			{
 				joy_mask_prev[i] = joy_mask[i];
 				user_io_digital_joystick(i, joy_mask[i], newdir);
+				if (user_io_get_joy_transl() == 1) joy_analog_invalidate();
+				input_latency_sent(i);
 			}
 		}
 	}
@@ -6008,11 +6091,17 @@ int input_poll(int getchar)
 	{
 		for (int i = 0; i < NUMPLAYERS; i++)
 		{
-			if(joy_mask[i]) user_io_digital_joystick(i, 0, 1);
+			if (joy_mask[i])
+			{
+				user_io_digital_joystick(i, 0, 1);
+				if (user_io_get_joy_transl() == 1) joy_analog_invalidate();
+			}
 		}
 		memset(key_states, 0, sizeof(key_states));
 	}
 
+	input_latency_flush();
+
 	if (mouse_req)
 	{
 		static uint32_t old_time = 0;
@@ -6076,6 +6165,7 @@ void input_switch(int grab)
 {
 	if (grab >= 0) grabbed = grab;
 	//printf("input_switch(%d), grabbed = %d\n", grab, grabbed);
+	joy_analog_invalidate();
 
 	for (int i = 0; i < NUMDEV; i++)
 	{
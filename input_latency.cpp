@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "input_latency.h"
+#include "frame_timer.h"
+#include "hardware.h"
+#include "cfg.h"
+
+#define LAT_DEVICES   16
+#define LAT_PLAYERS   6
+#define LAT_BIN_US    250  // histogram resolution
+#define LAT_BINS      128  // 0-32ms, last bin holds everything above
+#define LAT_PHASES    16
+
+struct lat_dev_t
+{
+	char     name[128];
+	uint32_t count;
+	uint64_t sum_us;
+	uint32_t max_us;
+	uint32_t bins[LAT_BINS];
+	uint32_t phase[LAT_PHASES];
+};
+
+struct lat_pending_t
+{
+	struct timeval time;
+	int dev;
+};
+
+static lat_dev_t lat_dev[LAT_DEVICES] = {};
+static lat_pending_t lat_pending[LAT_PLAYERS] = {};
+static struct timeval cur_time = {};
+static int cur_dev = -1;
+static int last_dev = -1;
+static int dirty = 0;
+
+static int get_dev(const char *devname)
+{
+	for (int i = 0; i < LAT_DEVICES; i++)
+	{
+		if (!lat_dev[i].name[0] || !strcmp(lat_dev[i].name, devname))
+		{
+			if (!lat_dev[i].name[0]) snprintf(lat_dev[i].name, sizeof(lat_dev[i].name), "%s", devname);
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void input_latency_event(const struct timeval *time, const char *devname)
+{
+	if (!cfg.input_latency) return;
+
+	cur_dev = time ? get_dev(devname) : -1;
+	if (time) cur_time = *time;
+}
+
+void input_latency_track(int player)
+{
+	if (cur_dev < 0 || player < 0 || player >= LAT_PLAYERS) return;
+	if (lat_pending[player].dev) return;
+
+	lat_pending[player].time = cur_time;
+	lat_pending[player].dev = cur_dev + 1;
+}
+
+void input_latency_sent(int player)
+{
+	if (player < 0 || player >= LAT_PLAYERS || !lat_pending[player].dev) return;
+
+	// evdev timestamps use CLOCK_REALTIME unless requested otherwise
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	lat_dev_t *dev = &lat_dev[lat_pending[player].dev - 1];
+	lat_pending[player].dev = 0;
+
+	int64_t us = (now.tv_sec - lat_pending[player].time.tv_sec) * 1000000LL + (now.tv_nsec / 1000) - lat_pending[player].time.tv_usec;
+	if (us < 0) return;
+
+	uint32_t bin = us / LAT_BIN_US;
+	if (bin >= LAT_BINS) bin = LAT_BINS - 1;
+
+	dev->count++;
+	dev->sum_us += us;
+	if (us > dev->max_us) dev->max_us = us;
+	dev->bins[bin]++;
+	dev->phase[frame_timer_phase() / (256 / LAT_PHASES)]++;
+
+	last_dev = dev - lat_dev;
+	dirty = 1;
+}
+
+static uint32_t percentile(const lat_dev_t *dev, int pct)
+{
+	uint32_t limit = (uint32_t)(((uint64_t)dev->count * pct) / 100);
+	uint32_t acc = 0;
+	int i;
+	for (i = 0; i < LAT_BINS - 1; i++)
+	{
+		acc += dev->bins[i];
+		if (acc > limit) break;
+	}
+
+	// upper edge of the bin, but never above the real maximum
+	uint32_t us = (i + 1) * LAT_BIN_US;
+	return (us > dev->max_us) ? dev->max_us : us;
+}
+
+static void export_results()
+{
+	FILE *fp = fopen("/tmp/input_latency.txt", "wt");
+	if (!fp) return;
+
+	for (int i = 0; i < LAT_DEVICES; i++)
+	{
+		const lat_dev_t *dev = &lat_dev[i];
+		if (!dev->count) continue;
+
+		fprintf(fp, "%s\n", dev->name);
+		fprintf(fp, "  samples %u, mean %" PRIu64 "us, p50 %uus, p90 %uus, p99 %uus, max %uus\n", dev->count, dev->sum_us / dev->count,
+			percentile(dev, 50), percentile(dev, 90), percentile(dev, 99), dev->max_us);
+
+		fprintf(fp, "  latency (us):");
+		for (int n = 0; n < LAT_BINS; n++) if (dev->bins[n]) fprintf(fp, " <%d:%u", (n + 1) * LAT_BIN_US, dev->bins[n]);
+		fprintf(fp, "\n  frame phase (1/%d):", LAT_PHASES);
+		for (int n = 0; n < LAT_PHASES; n++) fprintf(fp, " %u", dev->phase[n]);
+		fprintf(fp, "\n\n");
+	}
+
+	fclose(fp);
+}
+
+void input_latency_flush()
+{
+	static unsigned long export_timer = 0;
+
+	if (!cfg.input_latency) return;
+
+	memset(lat_pending, 0, sizeof(lat_pending));
+	cur_dev = -1;
+
+	if (dirty && (!export_timer || CheckTimer(export_timer)))
+	{
+		export_timer = GetTimer(10000);
+		dirty = 0;
+		export_results();
+	}
+}
+
+int input_latency_info(char *name, char *stats, int len)
+{
+	if (!cfg.input_latency || last_dev < 0) return 0;
+
+	const lat_dev_t *dev = &lat_dev[last_dev];
+	snprintf(name, len, "%s", dev->name);
+	snprintf(stats, len, "p50 %u.%u p99 %u.%u max %u.%u ms", percentile(dev, 50) / 1000, (percentile(dev, 50) / 100) % 10,
+		percentile(dev, 99) / 1000, (percentile(dev, 99) / 100) % 10, dev->max_us / 1000, (dev->max_us / 100) % 10);
+	return 1;
+}
@@ -0,0 +1,23 @@
+#ifndef INPUT_LATENCY_H
+#define INPUT_LATENCY_H
+
+#include <sys/time.h>
+
+// Measures time from evdev event timestamp to the joystick SPI write (enabled by input_latency=1).
+
+// event which is being processed now, time is copied; NULL for synthesized events
+void input_latency_event(const struct timeval *time, const char *devname);
+
+// player state changed by the current event (keeps the oldest pending event)
+void input_latency_track(int player);
+
+// player state has been sent to the core
+void input_latency_sent(int player);
+
+// drops pending events which didn't lead to an update, exports results periodically
+void input_latency_flush();
+
+// summary for OSD, returns 0 if there is nothing to show
+int input_latency_info(char *name, char *stats, int len);
+
+#endif
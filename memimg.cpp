@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+
+#include "memimg.h"
+#include "hardware.h"
+#include "menu.h"
+#include "offload.h"
+#include "profiling.h"
+#include "miniz.h"
+#include "zstd.h"
+
+#define MEMIMG_MAX   8
+#define MEMIMG_IDLE  3000 // ms without writes before an image is written back
+#define MEMIMG_LIMIT (4 * 1024 * 1024) // decoded size, enough for any floppy image
+
+#define CODEC_GZIP   1
+#define CODEC_ZSTD   2
+
+struct memimg_t
+{
+	fileTYPE *f;
+	char      path[1024];
+	int       writeback;
+	timespec  saved; // vdsk mtime when last written back
+	timespec  seen;  // vdsk mtime at last poll
+	unsigned long idle;
+};
+
+static memimg_t images[MEMIMG_MAX] = {};
+
+static int get_codec(const char *name, int *inner_len)
+{
+	int len = strlen(name);
+	*inner_len = len;
+	if (len > 4 && !strcasecmp(name + len - 4, ".adz")) return CODEC_GZIP;
+	if (len > 3 && !strcasecmp(name + len - 3, ".gz"))
+	{
+		*inner_len = len - 3;
+		return CODEC_GZIP;
+	}
+	if (len > 4 && !strcasecmp(name + len - 4, ".zst"))
+	{
+		*inner_len = len - 4;
+		return CODEC_ZSTD;
+	}
+	return 0;
+}
+
+const char *memimg_inner_ext(const char *name)
+{
+	int len;
+	if (!get_codec(name, &len)) return 0;
+	if (len == (int)strlen(name)) return "adf";
+
+	static char ext[8];
+	const char *p = name + len - 1;
+	while (p > name && *p != '.' && *p != '/') p--;
+	if (*p != '.' || name + len - p - 1 >= (int)sizeof(ext)) return 0;
+
+	memcpy(ext, p + 1, name + len - p - 1);
+	ext[name + len - p - 1] = 0;
+	return ext;
+}
+
+static int gz_decode(const uint8_t *src, uint32_t size, fileTYPE *f)
+{
+	if (size < 18 || src[0] != 0x1F || src[1] != 0x8B || src[2] != 8) return 0;
+
+	uint8_t flags = src[3];
+	uint32_t pos = 10;
+	if (flags & 4) pos += 2 + (src[pos] | (src[pos + 1] << 8));
+	if (flags & 8) while (pos < size && src[pos++]);
+	if (flags & 16) while (pos < size && src[pos++]);
+	if (flags & 2) pos += 2;
+	if (pos + 8 > size) return 0;
+
+	// decoded into a buffer of the size given by the trailer, longer streams fail
+	const uint8_t *trl = src + size - 8;
+	uint32_t crc = trl[0] | (trl[1] << 8) | (trl[2] << 16) | (trl[3] << 24);
+	uint32_t isize = trl[4] | (trl[5] << 8) | (trl[6] << 16) | (trl[7] << 24);
+	if (isize > MEMIMG_LIMIT) return -1;
+
+	uint8_t *out = (uint8_t*)malloc(isize ? isize : 1);
+	if (!out) return 0;
+
+	size_t len = tinfl_decompress_mem_to_mem(out, isize, src + pos, size - pos - 8, 0);
+	int ret = (len == isize) && (crc == crc32(0, out, len));
+	if (!ret) printf("memimg: gzip checksum mismatch.\n");
+	else ret = FileWriteAdv(f, out, len) == (int)len;
+
+	free(out);
+	return ret;
+}
+
+static int zst_decode(const uint8_t *src, uint32_t size, fileTYPE *f)
+{
+	ZSTD_DStream *ds = ZSTD_createDStream();
+	if (!ds) return 0;
+
+	size_t out_size = ZSTD_DStreamOutSize();
+	uint8_t *buf = (uint8_t*)malloc(out_size);
+
+	ZSTD_inBuffer in = { src, size, 0 };
+	uint32_t total = 0;
+	int ret = buf && !ZSTD_isError(ZSTD_initDStream(ds));
+	while (ret > 0 && in.pos < in.size)
+	{
+		ZSTD_outBuffer out = { buf, out_size, 0 };
+		size_t res = ZSTD_decompressStream(ds, &out, &in);
+		total += out.pos;
+		if (ZSTD_isError(res))
+		{
+			printf("memimg: %s\n", ZSTD_getErrorName(res));
+			ret = 0;
+		}
+		else if (total > MEMIMG_LIMIT)
+		{
+			ret = -1;
+		}
+		else if (out.pos && FileWriteAdv(f, buf, out.pos) != (int)out.pos)
+		{
+			ret = 0;
+		}
+	}
+
+	free(buf);
+	ZSTD_freeDStream(ds);
+	return ret;
+}
+
+static int get_mtime(fileTYPE *f, timespec *ts)
+{
+	struct stat64 st;
+	if (!f->filp || fstat64(fileno(f->filp), &st) < 0) return 0;
+	*ts = st.st_mtim;
+	return 1;
+}
+
+static int same_time(const timespec *a, const timespec *b)
+{
+	return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+// Runs on the offload thread. The image is written next to the original and renamed over it.
+static void gz_save(const char *path, uint8_t *buf, uint32_t size)
+{
+	PROFILE_FUNCTION();
+
+	size_t len = 0;
+	void *comp = tdefl_compress_mem_to_heap(buf, size, &len, tdefl_create_comp_flags_from_zip_params(6, -15, MZ_DEFAULT_STRATEGY));
+	if (!comp)
+	{
+		printf("memimg: failed to compress %s\n", path);
+		return;
+	}
+
+	uint32_t crc = crc32(0, buf, size);
+	uint8_t hdr[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 3 };
+	uint8_t trl[8] = {
+		(uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16), (uint8_t)(crc >> 24),
+		(uint8_t)size, (uint8_t)(size >> 8), (uint8_t)(size >> 16), (uint8_t)(size >> 24)
+	};
+
+	char tmp[1100];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	int ok = 0;
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd >= 0)
+	{
+		ok = write(fd, hdr, sizeof(hdr)) == sizeof(hdr) &&
+			write(fd, comp, len) == (ssize_t)len &&
+			write(fd, trl, sizeof(trl)) == sizeof(trl) &&
+			!fsync(fd);
+		close(fd);
+	}
+
+	if (ok && !rename(tmp, path)) printf("memimg: saved %s (%u -> %u bytes)\n", path, size, (uint32_t)len + 18);
+	else
+	{
+		printf("memimg: failed to save %s\n", path);
+		unlink(tmp);
+	}
+
+	mz_free(comp);
+}
+
+static void writeback(memimg_t *m, const timespec *mtime)
+{
+	uint32_t size = FileGetSize(m->f);
+	uint8_t *buf = (uint8_t*)malloc(size ? size : 1);
+	if (!buf) return;
+
+	// snapshot on the caller's thread, compression happens in the background
+	if (pread(fileno(m->f->filp), buf, size, 0) != (ssize_t)size)
+	{
+		free(buf);
+		return;
+	}
+
+	m->saved = *mtime;
+
+	char *path = strdup(m->path);
+	offload_add_work([path, buf, size]
+	{
+		gz_save(path, buf, size);
+		free(buf);
+		free(path);
+	});
+}
+
+// the whole image is held in RAM, hard disk images stay packed
+static void too_large(const char *name)
+{
+	printf("memimg: %s is larger than %d bytes unpacked.\n", name, MEMIMG_LIMIT);
+	Info("Packed image is too large.\nUnpack it to mount.", 3000);
+}
+
+int memimg_open(fileTYPE *f, const char *name, int *writable)
+{
+	PROFILE_FUNCTION();
+
+	int len;
+	int codec = get_codec(name, &len);
+	if (!codec) return 0;
+
+	int slot = 0;
+	while (slot < MEMIMG_MAX && images[slot].f && images[slot].f != f) slot++;
+	if (slot >= MEMIMG_MAX)
+	{
+		printf("memimg: too many images mounted.\n");
+		return 0;
+	}
+
+	int size = FileLoad(name, 0, 0);
+	if (size > MEMIMG_LIMIT)
+	{
+		too_large(name);
+		return 0;
+	}
+
+	uint8_t *src = (size > 0) ? (uint8_t*)malloc(size) : 0;
+	if (!src || FileLoad(name, src, size) != size)
+	{
+		free(src);
+		return 0;
+	}
+
+	char vname[32];
+	sprintf(vname, "vdsk_img%d", slot);
+	if (!FileOpenEx(f, vname, -1))
+	{
+		free(src);
+		printf("ERROR: fail to create vdsk\n");
+		return 0;
+	}
+
+	int ret = (codec == CODEC_GZIP) ? gz_decode(src, size, f) : zst_decode(src, size, f);
+	free(src);
+
+	if (ret <= 0)
+	{
+		if (ret < 0) too_large(name);
+		else printf("memimg: failed to decode %s\n", name);
+		FileClose(f);
+		return 0;
+	}
+
+	f->size = FileGetSize(f);
+	FileSeek(f, 0, SEEK_SET);
+
+	if (codec != CODEC_GZIP) *writable = 0;
+
+	memimg_t *m = &images[slot];
+	m->f = f;
+	snprintf(m->path, sizeof(m->path), "%s", getFullPath(name));
+	m->writeback = *writable;
+	get_mtime(f, &m->saved);
+	m->seen = m->saved;
+
+	printf("memimg: %s decoded to %" PRIu64 " bytes in RAM.\n", name, (uint64_t)f->size);
+	return 1;
+}
+
+void memimg_release(fileTYPE *f)
+{
+	for (int i = 0; i < MEMIMG_MAX; i++)
+	{
+		memimg_t *m = &images[i];
+		if (m->f != f) continue;
+
+		timespec ts;
+		if (m->writeback && get_mtime(f, &ts) && !same_time(&ts, &m->saved)) writeback(m, &ts);
+		m->f = 0;
+	}
+}
+
+void memimg_sync()
+{
+	for (int i = 0; i < MEMIMG_MAX; i++)
+	{
+		memimg_t *m = &images[i];
+		timespec ts;
+		if (m->f && m->writeback && get_mtime(m->f, &ts) && !same_time(&ts, &m->saved)) writeback(m, &ts);
+	}
+}
+
+void memimg_poll()
+{
+	static unsigned long timer = 0;
+	if (timer && !CheckTimer(timer)) return;
+	timer = GetTimer(1000);
+
+	for (int i = 0; i < MEMIMG_MAX; i++)
+	{
+		memimg_t *m = &images[i];
+		timespec ts;
+		if (!m->f || !m->writeback || !get_mtime(m->f, &ts)) continue;
+
+		if (!same_time(&ts, &m->seen))
+		{
+			m->seen = ts;
+			m->idle = GetTimer(MEMIMG_IDLE);
+		}
+		else if (!same_time(&ts, &m->saved) && CheckTimer(m->idle))
+		{
+			writeback(m, &ts);
+		}
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef MEMIMG_H
+#define MEMIMG_H
+
+#include "file_io.h"
+
+// Compressed disk images (.gz, .adz and .zst) are decoded once into a vdsk
+// memory file on mount, so all track access is served from RAM. Writes to a
+// gzip image are recompressed back to its path after a few idle seconds and
+// when the image is closed. zstd images are mounted read-only.
+
+// Returns the extension of the image inside a compressed name ("adf" for
+// "game.adz", "d64" for "game.d64.gz") or 0 if the name isn't a packed image.
+const char *memimg_inner_ext(const char *name);
+
+// Decodes name into f. Returns 0 on failure or if the image is larger than
+// 4MB unpacked; writable is cleared for images that can't be written back.
+int  memimg_open(fileTYPE *f, const char *name, int *writable);
+
+// Called by FileClose for vdsk files; writes back pending changes.
+void memimg_release(fileTYPE *f);
+
+void memimg_poll();
+
+// Queues write back of all modified images (before Main restarts).
+void memimg_sync();
+
+#endif
@@ -66,6 +66,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "profiling.h"
 #include "str_util.h"
 #include "autofire.h"
+#include "input_latency.h"
 
 /*menu states*/
 enum MENU
@@ -714,7 +715,7 @@ static void printSysInfo()
 		int n = 2;
 		static int flip = 0;
 
-		char str[40];
+		char str[40], lat[40];
 		OsdWrite(n++, info_top, 0, 0);
 
 		int j = 0;
@@ -774,6 +775,12 @@ static void printSysInfo()
 			}
 			infowrite(n++, str);
 		}
+		else if ((flip & 2) && input_latency_info(str, lat, sizeof(lat)))
+		{
+			infowrite(n++, "");
+			infowrite(n++, str);
+			infowrite(n++, lat);
+		}
 		else
 		{
 			infowrite(n++, "");
@@ -1743,7 +1750,7 @@ void HandleUI(void)
 				if (select)
 				{
 					ioctl_index = 0;
-					SelectFile(Selected_S[menusub], "ADF", SCANO_DIR | SCANO_UMOUNT, MENU_ARCHIE_MAIN_FILE_SELECTED, MENU_ARCHIE_MAIN1);
+					SelectFile(Selected_S[menusub], "ADF", SCANO_DIR | SCANO_UMOUNT | SCANO_MEMIMG, MENU_ARCHIE_MAIN_FILE_SELECTED, MENU_ARCHIE_MAIN1);
 				}
 				break;
 
@@ -2394,6 +2401,9 @@ void HandleUI(void)
 
 						if (is_psx()) fs_Options |= SCANO_NOZIP;
 
+						// mounted by user_io_file_mount, which opens packed images through memimg
+						if (!(fs_Options & SCANO_NOZIP) && !is_x86() && !is_pcxt() && !(is_uneon() && ioctl_index >= 2)) fs_Options |= SCANO_MEMIMG;
+
 						if (!mgl->done) menustate = MENU_GENERIC_IMAGE_SELECTED;
 						else if (select) SelectFile(Selected_tmp, ext, fs_Options, fs_MenuSelect, fs_MenuCancel);
 						else if (recent_init(ioctl_index + 500)) menustate = MENU_RECENT1;
@@ -5830,7 +5840,7 @@ void HandleUI(void)
 				else
 				{
 					df[menusub].status = 0;
-					fs_Options = SCANO_DIR;
+					fs_Options = SCANO_DIR | SCANO_MEMIMG;
 					fs_MenuSelect = MENU_MINIMIG_ADFFILE_SELECTED;
 					fs_MenuCancel = MENU_MINIMIG_MAIN1;
 					strcpy(fs_pFileExt, "ADF");
@@ -52,7 +52,10 @@ static void *worker_thread(void *)
 		pthread_mutex_unlock(&s_queue_lock);
 
 		// execute
-		current_work->handler();
+		{
+			PROFILE_SCOPE("offload_work");
+			current_work->handler();
+		}
 		current_work->handler = nullptr;
 
 		// lock and move tail forward
@@ -84,6 +87,7 @@ void offload_start()
 	pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
 
 	pthread_create(&s_thread_handle, &attr, worker_thread, nullptr);
+	pthread_setname_np(s_thread_handle, "offload");
 }
 
 void offload_stop()
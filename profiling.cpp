@@ -3,10 +3,16 @@
 #include "profiling.h"
 
 #include "str_util.h"
+#include "offload.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <atomic>
 
 struct Event
 {
@@ -15,34 +21,51 @@ struct Event
 	struct timespec ts;
 };
 
-static constexpr int MAX_EVENTS = 512; // must be pow2
-static Event s_events[MAX_EVENTS]; // circular buffer
-static uint32_t s_event_tail = 0;
+static constexpr int MAX_EVENTS = 8192; // must be pow2
 
-static constexpr Event *get_event(uint32_t idx)
+// Every thread gets its own event ring on first use. Rings are never freed,
+// so the exporter can walk the list while the owners keep running.
+struct ThreadRing
 {
-	return &s_events[idx % MAX_EVENTS];
-}
+	Event events[MAX_EVENTS]; // circular buffer
+	std::atomic<uint32_t> tail;
+	pid_t tid;
+	char name[16];
+	ThreadRing *next;
 
-uint32_t profiling_event_begin(const char *name)
+	// Bookkeeping data for spike report
+	uint64_t inclusive_times[MAX_EVENTS];
+	uint64_t other_times[MAX_EVENTS];
+	uint32_t pair_stack[MAX_EVENTS / 2];
+};
+
+static std::atomic<ThreadRing*> s_rings(nullptr);
+static thread_local ThreadRing *t_ring = nullptr;
+
+static ThreadRing *get_ring()
 {
-	Event *newEvent = get_event(s_event_tail);
-	newEvent->begin_idx = s_event_tail;
-	newEvent->name = name;
-	clock_gettime(CLOCK_MONOTONIC, &newEvent->ts);
+	if (t_ring) return t_ring;
 
-	uint32_t r = s_event_tail;
-	s_event_tail++;
-	return r;
+	ThreadRing *ring = (ThreadRing*)calloc(1, sizeof(ThreadRing));
+	if (!ring)
+	{
+		printf("profiling: not enough memory for event ring.\n");
+		exit(1);
+	}
+
+	ring->tid = syscall(SYS_gettid);
+	pthread_getname_np(pthread_self(), ring->name, sizeof(ring->name));
+
+	ThreadRing *head = s_rings.load();
+	do ring->next = head; while (!s_rings.compare_exchange_weak(head, ring));
+
+	t_ring = ring;
+	return ring;
 }
 
-void profiling_event_end(uint32_t begin_idx, const char *name)
+static Event *get_event(ThreadRing *ring, uint32_t idx)
 {
-	Event *newEvent = get_event(s_event_tail);
-	newEvent->begin_idx = begin_idx;
-	newEvent->name = name;
-	clock_gettime(CLOCK_MONOTONIC, &newEvent->ts);
-	s_event_tail++;
+	return &ring->events[idx % MAX_EVENTS];
 }
 
 // result_ns = a - b
@@ -63,59 +86,192 @@ static uint64_t delta_ns(const struct timespec *a, const struct timespec *b)
 	return delta;
 }
 
+static uint64_t ts_us(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000ULL + ts->tv_nsec / 1000;
+}
+
+// Log-linear histogram of microseconds: values below 32 get exact buckets,
+// above that every power of two is split into 16 buckets (~6% resolution).
+static constexpr int HIST_BUCKETS = 464;
+
+static int hist_bucket(uint32_t us)
+{
+	if (us < 32) return us;
+	int msb = 31 - __builtin_clz(us);
+	return (msb - 4) * 16 + (us >> (msb - 4));
+}
+
+static uint32_t hist_value(int bucket)
+{
+	if (bucket < 32) return bucket;
+	int msb = bucket / 16 + 3;
+	return ((bucket % 16) + 16) << (msb - 4);
+}
+
+enum
+{
+	METRIC_SCOPE = 1,
+	METRIC_COUNTER,
+	METRIC_GAUGE
+};
+
+struct Metric
+{
+	std::atomic<const char*> name;
+	int kind;
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sum;
+	std::atomic<uint32_t> max;
+	std::atomic<int64_t> value;
+	std::atomic<uint32_t> buckets[HIST_BUCKETS];
+};
+
+static constexpr int MAX_METRICS = 128; // must be pow2
+static Metric s_metrics[MAX_METRICS];
+static pthread_mutex_t s_metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static Metric *get_metric(const char *name, int kind)
+{
+	uint32_t hash = 5381;
+	for (const char *p = name; *p; p++) hash = hash * 33 + *p;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int i = 0; i < MAX_METRICS; i++)
+		{
+			Metric *m = &s_metrics[(hash + i) % MAX_METRICS];
+			const char *mname = m->name.load(std::memory_order_acquire);
+			if (!mname)
+			{
+				if (!pass) break;
+
+				// slot is claimed under the lock so two threads don't register the same name twice
+				m->kind = kind;
+				m->name.store(name, std::memory_order_release);
+				pthread_mutex_unlock(&s_metrics_lock);
+				return m;
+			}
+			if (m->kind == kind && (mname == name || !strcmp(mname, name)))
+			{
+				if (pass) pthread_mutex_unlock(&s_metrics_lock);
+				return m;
+			}
+		}
+
+		if (pass) break;
+		pthread_mutex_lock(&s_metrics_lock);
+	}
+
+	pthread_mutex_unlock(&s_metrics_lock);
+	return nullptr;
+}
+
+static void metric_record(const char *name, uint64_t ns)
+{
+	Metric *m = get_metric(name, METRIC_SCOPE);
+	if (!m) return;
+
+	uint32_t us = (ns / 1000ULL > 0xFFFFFFFFULL) ? 0xFFFFFFFF : (uint32_t)(ns / 1000ULL);
+	m->count.fetch_add(1, std::memory_order_relaxed);
+	m->sum.fetch_add(us, std::memory_order_relaxed);
+	m->buckets[hist_bucket(us)].fetch_add(1, std::memory_order_relaxed);
+
+	uint32_t max = m->max.load(std::memory_order_relaxed);
+	while (us > max && !m->max.compare_exchange_weak(max, us, std::memory_order_relaxed));
+}
+
+void profiling_counter_add(const char *name, int64_t delta)
+{
+	Metric *m = get_metric(name, METRIC_COUNTER);
+	if (m) m->value.fetch_add(delta, std::memory_order_relaxed);
+}
+
+void profiling_gauge_set(const char *name, int64_t value)
+{
+	Metric *m = get_metric(name, METRIC_GAUGE);
+	if (m) m->value.store(value, std::memory_order_relaxed);
+}
+
+uint32_t profiling_event_begin(const char *name)
+{
+	ThreadRing *ring = get_ring();
+	uint32_t r = ring->tail.load(std::memory_order_relaxed);
+
+	Event *newEvent = get_event(ring, r);
+	newEvent->begin_idx = r;
+	newEvent->name = name;
+	clock_gettime(CLOCK_MONOTONIC, &newEvent->ts);
+
+	ring->tail.store(r + 1, std::memory_order_release);
+	return r;
+}
+
+void profiling_event_end(uint32_t begin_idx, const char *name)
+{
+	ThreadRing *ring = get_ring();
+	uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+
+	Event *newEvent = get_event(ring, tail);
+	newEvent->begin_idx = begin_idx;
+	newEvent->name = name;
+	clock_gettime(CLOCK_MONOTONIC, &newEvent->ts);
+
+	ring->tail.store(tail + 1, std::memory_order_release);
 
-// Bookkeeping data for spike report
-static uint64_t inclusive_times[MAX_EVENTS];
-static uint64_t other_times[MAX_EVENTS];
-static uint32_t pair_stack[MAX_EVENTS / 2];
+	// begin event is still in the ring unless the scope contains too many events
+	if ((tail - begin_idx) < MAX_EVENTS) metric_record(name, delta_ns(&newEvent->ts, &get_event(ring, begin_idx)->ts));
+}
 
 void profiling_spike_report(uint32_t begin_idx, uint32_t spike_us)
 {
+	ThreadRing *ring = get_ring();
+	uint32_t tail = ring->tail.load(std::memory_order_relaxed);
 	int stack_pos = 0;
 
-	if ((s_event_tail - begin_idx) < 2) return; // not enough events
-	if ((s_event_tail - begin_idx) > MAX_EVENTS) return; // too many events
+	if ((tail - begin_idx) < 2) return; // not enough events
+	if ((tail - begin_idx) > MAX_EVENTS) return; // too many events
 
-	const uint64_t total_ns = delta_ns(&get_event(s_event_tail - 1)->ts, &get_event(begin_idx)->ts);
+	const uint64_t total_ns = delta_ns(&get_event(ring, tail - 1)->ts, &get_event(ring, begin_idx)->ts);
 
 	if (total_ns < (spike_us * 1000ULL)) return; // below threshold
 
-	for (uint32_t idx = begin_idx; idx != s_event_tail; idx++)
+	for (uint32_t idx = begin_idx; idx != tail; idx++)
 	{
 		const uint32_t cyc_idx = idx % MAX_EVENTS;
-		Event *event = get_event(idx);
+		Event *event = get_event(ring, idx);
 
 		if (event->begin_idx == idx)
 		{
-			pair_stack[stack_pos] = cyc_idx;
-			inclusive_times[cyc_idx] = 0;
-			other_times[cyc_idx] = 0;
+			ring->pair_stack[stack_pos] = cyc_idx;
+			ring->inclusive_times[cyc_idx] = 0;
+			ring->other_times[cyc_idx] = 0;
 			stack_pos++;
 		}
 		else
 		{
 			stack_pos--;
-			uint32_t span_idx = pair_stack[stack_pos];
-			const uint64_t inclusive_ns = delta_ns(&event->ts, &get_event(span_idx)->ts);
-			inclusive_times[span_idx] = inclusive_ns;
-			if (stack_pos > 0) other_times[pair_stack[stack_pos-1]] += inclusive_ns;
+			uint32_t span_idx = ring->pair_stack[stack_pos];
+			const uint64_t inclusive_ns = delta_ns(&event->ts, &ring->events[span_idx].ts);
+			ring->inclusive_times[span_idx] = inclusive_ns;
+			if (stack_pos > 0) ring->other_times[ring->pair_stack[stack_pos-1]] += inclusive_ns;
 		}
 	}
 
 	char label[256];
 	int indent = 0;
-	printf("\n%lluus spike over %uus limit.\n", total_ns / 1000ULL, spike_us);
+	printf("\n%" PRIu64 "us spike over %uus limit.\n", total_ns / 1000, spike_us);
 	printf("+----- Name -----------------------------------------+ Inc(us) + Exc(us) +\n");
-	for (uint32_t idx = begin_idx; idx != s_event_tail; idx++)
+	for (uint32_t idx = begin_idx; idx != tail; idx++)
 	{
 		const uint32_t cyc_idx = idx % MAX_EVENTS;
-		Event *event = get_event(idx);
+		Event *event = get_event(ring, idx);
 
 		if (event->begin_idx == idx)
 		{
 			memset(label, ' ', indent);
 			strcpyz(label + indent, sizeof(label) - indent, event->name);
-			printf("| %-50s | %7llu | %7llu |\n", label, inclusive_times[cyc_idx] / 1000ULL, (inclusive_times[cyc_idx] - other_times[cyc_idx]) / 1000ULL);
+			printf("| %-50s | %7" PRIu64 " | %7" PRIu64 " |\n", label, ring->inclusive_times[cyc_idx] / 1000, (ring->inclusive_times[cyc_idx] - ring->other_times[cyc_idx]) / 1000);
 			indent += 2;
 		}
 		else
@@ -127,4 +283,141 @@ void profiling_spike_report(uint32_t begin_idx, uint32_t spike_us)
 	fflush(stdout);
 }
 
-#endif // PROFILING
\ No newline at end of file
+static uint32_t hist_percentile(const uint32_t *buckets, uint64_t count, double pct)
+{
+	uint64_t limit = (uint64_t)(count * pct / 100.0);
+	uint64_t acc = 0;
+	for (int i = 0; i < HIST_BUCKETS; i++)
+	{
+		acc += buckets[i];
+		if (acc > limit) return hist_value(i);
+	}
+	return hist_value(HIST_BUCKETS - 1);
+}
+
+static void export_metrics(const char *path)
+{
+	FILE *fp = fopen(path, "wt");
+	if (!fp) return;
+
+	static uint32_t buckets[HIST_BUCKETS];
+
+	fprintf(fp, "+----- Scope ----------------------------+    Count + Mean(us) +  p50 +  p90 +  p99 + p99.9 +   Max +\n");
+	for (int i = 0; i < MAX_METRICS; i++)
+	{
+		Metric *m = &s_metrics[i];
+		const char *name = m->name.load(std::memory_order_acquire);
+		if (!name || m->kind != METRIC_SCOPE) continue;
+
+		uint64_t count = 0;
+		for (int b = 0; b < HIST_BUCKETS; b++)
+		{
+			buckets[b] = m->buckets[b].load(std::memory_order_relaxed);
+			count += buckets[b];
+		}
+		if (!count) continue;
+
+		fprintf(fp, "| %-38s | %8" PRIu64 " | %8" PRIu64 " | %4u | %4u | %4u | %5u | %5u |\n", name, count, m->sum.load() / count,
+			hist_percentile(buckets, count, 50), hist_percentile(buckets, count, 90), hist_percentile(buckets, count, 99),
+			hist_percentile(buckets, count, 99.9), m->max.load());
+	}
+	fprintf(fp, "+----------------------------------------+----------+----------+------+------+------+-------+-------+\n\n");
+
+	for (int i = 0; i < MAX_METRICS; i++)
+	{
+		Metric *m = &s_metrics[i];
+		const char *name = m->name.load(std::memory_order_acquire);
+		if (!name || m->kind == METRIC_SCOPE) continue;
+		fprintf(fp, "%s %s = %" PRId64 "\n", (m->kind == METRIC_COUNTER) ? "counter" : "gauge  ", name, m->value.load());
+	}
+
+	fclose(fp);
+}
+
+static void json_name(FILE *fp, const char *name)
+{
+	fputc('"', fp);
+	for (const char *p = name; *p; p++)
+	{
+		if (*p == '"' || *p == '\\') fputc('\\', fp);
+		if ((uint8_t)*p >= 0x20) fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
+
+// Chrome trace event format, load it in chrome://tracing or ui.perfetto.dev
+static void export_trace(const char *path)
+{
+	FILE *fp = fopen(path, "wt");
+	if (!fp) return;
+
+	pid_t pid = getpid();
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	fprintf(fp, "{\"traceEvents\":[");
+	const char *sep = "\n";
+	for (ThreadRing *ring = s_rings.load(); ring; ring = ring->next)
+	{
+		fprintf(fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", sep, pid, ring->tid);
+		json_name(fp, ring->name[0] ? ring->name : "thread");
+		fprintf(fp, "}}");
+		sep = ",\n";
+
+		// leave some distance from the writer so the events read are complete
+		uint32_t tail = ring->tail.load(std::memory_order_acquire);
+		uint32_t first = (tail > MAX_EVENTS - 256) ? tail - (MAX_EVENTS - 256) : 0;
+
+		for (uint32_t idx = first; idx != tail; idx++)
+		{
+			Event *event = get_event(ring, idx);
+			fprintf(fp, ",\n{\"ph\":\"%c\",\"name\":", (event->begin_idx == idx) ? 'B' : 'E');
+			json_name(fp, event->name);
+			fprintf(fp, ",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 "}", pid, ring->tid, ts_us(&event->ts));
+		}
+	}
+
+	for (int i = 0; i < MAX_METRICS; i++)
+	{
+		Metric *m = &s_metrics[i];
+		const char *name = m->name.load(std::memory_order_acquire);
+		if (!name || m->kind == METRIC_SCOPE) continue;
+
+		fprintf(fp, "%s{\"ph\":\"C\",\"name\":", sep);
+		sep = ",\n";
+		json_name(fp, name);
+		fprintf(fp, ",\"pid\":%d,\"ts\":%" PRIu64 ",\"args\":{\"value\":%" PRId64 "}}", pid, ts_us(&now), m->value.load());
+	}
+
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+}
+
+void profiling_export()
+{
+	export_metrics("/tmp/MiSTer_profile.txt");
+	export_trace("/tmp/MiSTer_profile.json");
+}
+
+void profiling_poll()
+{
+	static struct timespec last = {};
+	static std::atomic<bool> busy(false);
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!last.tv_sec) last = now;
+	if (delta_ns(&now, &last) < 60000000000ULL) return;
+
+	last = now;
+
+	// the files are written on the offload thread, the rings and metrics can be read while in use
+	if (busy.exchange(true)) return;
+	offload_add_work([]
+	{
+		profiling_export();
+		busy.store(false);
+	});
+}
+
+#endif // PROFILING
@@ -9,6 +9,16 @@ uint32_t profiling_event_begin(const char *name);
 void profiling_event_end(uint32_t begin_idx, const char *name);
 void profiling_spike_report(uint32_t begin_idx, uint32_t spike_us);
 
+// name must be a string literal or otherwise outlive the process
+void profiling_counter_add(const char *name, int64_t delta);
+void profiling_gauge_set(const char *name, int64_t value);
+
+// Periodically writes /tmp/MiSTer_profile.txt (latency histograms, counters, gauges)
+// and /tmp/MiSTer_profile.json (Chrome trace of the per-thread event rings)
+// on the offload thread.
+void profiling_poll();
+void profiling_export();
+
 struct ProfilingScopedEvent
 {
 	const char *name;
@@ -40,6 +50,9 @@ struct ProfilingScopedEvent
 #define PROFILE_FUNCTION() ProfilingScopedEvent __scope_timer(__FUNCTION__)
 #define SPIKE_SCOPE(name, us) ProfilingScopedEvent __scope_timer(name, us)
 #define SPIKE_FUNCTION(us) ProfilingScopedEvent __scope_timer(__FUNCTION__, us)
+#define PROFILE_COUNTER(name, delta) profiling_counter_add(name, delta)
+#define PROFILE_GAUGE(name, value) profiling_gauge_set(name, value)
+#define PROFILE_POLL() profiling_poll()
 
 #else // PROFILING
 
@@ -47,6 +60,9 @@ struct ProfilingScopedEvent
 #define PROFILE_FUNCTION()
 #define SPIKE_SCOPE(name, us)
 #define SPIKE_FUNCTION(us)
+#define PROFILE_COUNTER(name, delta)
+#define PROFILE_GAUGE(name, value)
+#define PROFILE_POLL()
 
 #endif // PROFILING
 
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+
+#include "romhash.h"
+#include "file_io.h"
+#include "offload.h"
+#include "profiling.h"
+#include "lib/md5/md5.h"
+#include "miniz.h"
+
+#define HASH_SLOTS   4
+#define HASH_SLOT_SZ (256 * 1024)
+
+static int hash_flags = 0;
+static uint32_t hash_crc = 0;
+static MD5Context hash_md5;
+
+static uint8_t *slot_buf[HASH_SLOTS] = {};
+static uint32_t slot_cur = 0;
+static uint32_t slot_len = 0;
+static sem_t slot_free;
+
+// Runs on the offload thread (or inline if buffers couldn't be allocated).
+static void hash_process(uint8_t *buf, uint32_t len)
+{
+	if (hash_flags & HASH_MD5) MD5Update(&hash_md5, buf, len);
+	if (hash_flags & HASH_CRC32)
+	{
+		if (hash_flags & HASH_CRC_SWAP16)
+		{
+			for (uint32_t i = 0; i + 1 < len; i += 2)
+			{
+				uint8_t tmp = buf[i];
+				buf[i] = buf[i + 1];
+				buf[i + 1] = tmp;
+			}
+		}
+		hash_crc = crc32(hash_crc, buf, len);
+	}
+}
+
+static void slot_flush()
+{
+	uint8_t *buf = slot_buf[slot_cur];
+	uint32_t len = slot_len;
+
+	offload_add_work([buf, len]
+	{
+		hash_process(buf, len);
+		sem_post(&slot_free);
+	});
+
+	slot_cur = (slot_cur + 1) % HASH_SLOTS;
+	slot_len = 0;
+}
+
+void romhash_begin(int flags)
+{
+	hash_flags = flags;
+	hash_crc = 0;
+	MD5Init(&hash_md5);
+
+	slot_cur = 0;
+	slot_len = 0;
+	for (int i = 0; i < HASH_SLOTS; i++)
+	{
+		slot_buf[i] = (uint8_t*)malloc(HASH_SLOT_SZ);
+		if (!slot_buf[i])
+		{
+			printf("romhash: not enough memory, hashing inline.\n");
+			while (i--)
+			{
+				free(slot_buf[i]);
+				slot_buf[i] = 0;
+			}
+			break;
+		}
+	}
+
+	sem_init(&slot_free, 0, HASH_SLOTS);
+}
+
+void romhash_update(const void *buf, uint32_t len)
+{
+	PROFILE_FUNCTION();
+
+	const uint8_t *src = (const uint8_t*)buf;
+	while (len)
+	{
+		if (!slot_buf[0])
+		{
+			static uint8_t tmp[4096];
+			uint32_t chunk = (len > sizeof(tmp)) ? sizeof(tmp) : len;
+			memcpy(tmp, src, chunk);
+			hash_process(tmp, chunk);
+			src += chunk;
+			len -= chunk;
+			continue;
+		}
+
+		if (!slot_len) sem_wait(&slot_free);
+
+		uint32_t chunk = HASH_SLOT_SZ - slot_len;
+		if (chunk > len) chunk = len;
+
+		memcpy(slot_buf[slot_cur] + slot_len, src, chunk);
+		slot_len += chunk;
+		src += chunk;
+		len -= chunk;
+
+		if (slot_len == HASH_SLOT_SZ) slot_flush();
+	}
+}
+
+void romhash_end(romhash_t *res)
+{
+	PROFILE_FUNCTION();
+
+	if (slot_buf[0])
+	{
+		if (slot_len) slot_flush();
+
+		// wait for all queued slots to be processed
+		for (int i = 0; i < HASH_SLOTS; i++) sem_wait(&slot_free);
+
+		for (int i = 0; i < HASH_SLOTS; i++)
+		{
+			free(slot_buf[i]);
+			slot_buf[i] = 0;
+		}
+	}
+
+	sem_destroy(&slot_free);
+
+	memset(res, 0, sizeof(romhash_t));
+	res->crc = hash_crc;
+	if (hash_flags & HASH_MD5) MD5Final(res->md5, &hash_md5);
+}
+
+#define HASHCACHE_NAME  "hashcache.bin"
+#define HASHCACHE_MAX   256
+#define HASHCACHE_MAGIC 0x48534831 // HSH1
+
+struct hashcache_rec_t
+{
+	uint32_t  path_crc;
+	uint32_t  flags;
+	uint64_t  size;
+	int64_t   mtime;
+	uint64_t  start;
+	uint64_t  len;
+	uint32_t  stamp;
+	romhash_t hash;
+};
+
+struct hashcache_t
+{
+	uint32_t magic;
+	uint32_t stamp;
+	hashcache_rec_t rec[HASHCACHE_MAX];
+};
+
+static hashcache_t hcache;
+static int hcache_loaded = 0;
+
+static void hashcache_load()
+{
+	if (hcache_loaded) return;
+	hcache_loaded = 1;
+
+	if (FileLoadConfig(HASHCACHE_NAME, 0, 0) != sizeof(hcache) ||
+		!FileLoadConfig(HASHCACHE_NAME, &hcache, sizeof(hcache)) ||
+		hcache.magic != HASHCACHE_MAGIC)
+	{
+		memset(&hcache, 0, sizeof(hcache));
+		hcache.magic = HASHCACHE_MAGIC;
+	}
+}
+
+static int hashcache_key(const char *path, hashcache_rec_t *key)
+{
+	char full[1024];
+	snprintf(full, sizeof(full), "%s", getFullPath(path));
+	key->path_crc = crc32(0, (const uint8_t*)full, strlen(full));
+
+	// files inside zip archives take size and mtime from the archive itself
+	struct stat64 st;
+	if (stat64(full, &st) < 0)
+	{
+		char *p = strcasestr(full, ".zip/");
+		if (!p) return 0;
+		p[4] = 0;
+		if (stat64(full, &st) < 0) return 0;
+	}
+
+	key->size = st.st_size;
+	key->mtime = st.st_mtime;
+	return 1;
+}
+
+static hashcache_rec_t *hashcache_find(const hashcache_rec_t *key)
+{
+	for (int i = 0; i < HASHCACHE_MAX; i++)
+	{
+		hashcache_rec_t *rec = &hcache.rec[i];
+		if (rec->stamp && rec->path_crc == key->path_crc && rec->flags == key->flags &&
+			rec->size == key->size && rec->mtime == key->mtime &&
+			rec->start == key->start && rec->len == key->len) return rec;
+	}
+
+	return 0;
+}
+
+int romhash_cache_get(const char *path, int flags, uint64_t start, uint64_t len, romhash_t *res)
+{
+	hashcache_rec_t key = {};
+	key.flags = flags;
+	key.start = start;
+	key.len = len;
+	if (!hashcache_key(path, &key)) return 0;
+
+	hashcache_load();
+	hashcache_rec_t *rec = hashcache_find(&key);
+	if (!rec) return 0;
+
+	memcpy(res, &rec->hash, sizeof(romhash_t));
+	rec->stamp = ++hcache.stamp;
+	printf("romhash: using cached hash for %s\n", path);
+	return 1;
+}
+
+void romhash_cache_put(const char *path, int flags, uint64_t start, uint64_t len, const romhash_t *res)
+{
+	hashcache_rec_t key = {};
+	key.flags = flags;
+	key.start = start;
+	key.len = len;
+	if (!hashcache_key(path, &key)) return;
+
+	hashcache_load();
+	hashcache_rec_t *rec = hashcache_find(&key);
+	if (!rec)
+	{
+		// replace the least recently used record
+		rec = &hcache.rec[0];
+		for (int i = 1; i < HASHCACHE_MAX; i++)
+		{
+			if (hcache.rec[i].stamp < rec->stamp) rec = &hcache.rec[i];
+		}
+	}
+
+	memcpy(rec, &key, sizeof(hashcache_rec_t));
+	memcpy(&rec->hash, res, sizeof(romhash_t));
+	rec->stamp = ++hcache.stamp;
+
+	FileSaveConfig(HASHCACHE_NAME, &hcache, sizeof(hcache));
+}
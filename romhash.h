@@ -0,0 +1,26 @@
+#ifndef ROMHASH_H
+#define ROMHASH_H
+
+#include <inttypes.h>
+
+#define HASH_CRC32       1
+#define HASH_MD5         2
+#define HASH_CRC_SWAP16  4 // CRC32 is calculated over 16-bit byte swapped data
+
+struct romhash_t
+{
+	uint32_t crc;
+	uint8_t  md5[16];
+};
+
+// One pass CRC32/MD5 hashing. Data is copied into internal buffers
+// and hashed on the offload thread while the caller keeps loading.
+void romhash_begin(int flags);
+void romhash_update(const void *buf, uint32_t len);
+void romhash_end(romhash_t *res);
+
+// Persistent cache keyed by path, file size, mtime and hashed range.
+int  romhash_cache_get(const char *path, int flags, uint64_t start, uint64_t len, romhash_t *res);
+void romhash_cache_put(const char *path, int flags, uint64_t start, uint64_t len, const romhash_t *res);
+
+#endif
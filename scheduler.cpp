@@ -1,5 +1,6 @@
 #include "scheduler.h"
 #include <stdio.h>
+#include <time.h>
 #include "libco.h"
 #include "menu.h"
 #include "user_io.h"
@@ -8,12 +9,28 @@
 #include "fpga_io.h"
 #include "osd.h"
 #include "profiling.h"
+#include "spi_trace.h"
 
 static cothread_t co_scheduler = nullptr;
 static cothread_t co_poll = nullptr;
 static cothread_t co_ui = nullptr;
 static cothread_t co_last = nullptr;
 
+// longest recent UI pass, decays slowly so a single spike doesn't pin it
+static uint64_t ui_pass_us = 1000;
+
+// waits wake up this much before the deadline and spin the rest. Twice the
+// worst timer latency seen, drops back slowly, so a wait is only late when a
+// sleep overshoots by more than that.
+static uint64_t wake_late_us = 2000;
+
+static uint64_t get_us()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_BOOTTIME, &tp);
+	return (uint64_t)tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+}
+
 static void scheduler_wait_fpga_ready(void)
 {
 	while (!is_fpga_ready(1))
@@ -35,6 +52,8 @@ static void scheduler_co_poll(void)
 			input_poll(0);
 		}
 
+		PROFILE_POLL();
+		SPI_TRACE_POLL();
 		scheduler_yield();
 	}
 }
@@ -58,7 +77,13 @@ static void scheduler_schedule(void)
 	if (co_last == co_poll)
 	{
 		co_last = co_ui;
+
+		uint64_t start = get_us();
 		co_switch(co_ui);
+		uint64_t pass = get_us() - start;
+
+		if (pass > ui_pass_us) ui_pass_us = pass;
+		else ui_pass_us -= (ui_pass_us - pass) / 16;
 	}
 	else
 	{
@@ -93,3 +118,35 @@ void scheduler_yield(void)
 {
 	co_switch(co_scheduler);
 }
+
+void scheduler_wait_until(uint64_t deadline_us)
+{
+	for (;;)
+	{
+		uint64_t now = get_us();
+		if (now >= deadline_us) return;
+
+		uint64_t remaining = deadline_us - now;
+		if (remaining > ui_pass_us * 2 + wake_late_us)
+		{
+			// callers run on the poll task, so keep input going while it is parked
+			input_poll(0);
+			scheduler_yield();
+		}
+		else if (remaining > wake_late_us * 2)
+		{
+			// short waits are spun, sleeping would save less than the margin
+			uint64_t wake = deadline_us - wake_late_us;
+			struct timespec ts = { (time_t)(wake / 1000000), (long)(wake % 1000000) * 1000 };
+			clock_nanosleep(CLOCK_BOOTTIME, TIMER_ABSTIME, &ts, NULL);
+
+			now = get_us();
+			uint64_t late = (now > wake) ? now - wake : 0;
+			late *= 2;
+			if (late > wake_late_us) wake_late_us = late;
+			else wake_late_us -= (wake_late_us - late) / 256;
+			if (wake_late_us < 100) wake_late_us = 100;
+			if (wake_late_us > 10000) wake_late_us = 10000;
+		}
+	}
+}
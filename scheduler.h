@@ -1,10 +1,17 @@
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
+#include <inttypes.h>
+
 #define USE_SCHEDULER
 
 void scheduler_init(void);
 void scheduler_run(void);
 void scheduler_yield(void);
 
+// Returns at the given CLOCK_BOOTTIME time (in us). Other tasks run while
+// there is time for them, then it sleeps until shortly before the deadline
+// (by the worst timer latency seen) and spins the rest. Short waits are spun.
+void scheduler_wait_until(uint64_t deadline_us);
+
 #endif
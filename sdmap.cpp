@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sdmap.h"
+#include "profiling.h"
+
+#define SDMAP_DISKS   16
+#define SDMAP_WINDOW  (64 * 1024 * 1024)
+#define SDMAP_AHEAD   (256 * 1024) // read ahead of a sequential stream
+#define SDMAP_STREAMS 4            // recently served ranges tracked per disk
+
+struct sdmap_stream_t
+{
+	uint64_t next;    // offset following the last served range
+	uint64_t advised; // end of the range already passed to MADV_WILLNEED
+	uint32_t stamp;
+};
+
+struct sdmap_t
+{
+	int       fd;
+	uint64_t  size;
+	uint8_t  *map;
+	uint64_t  map_start;
+	uint32_t  map_len;
+	uint32_t  stamp;
+	sdmap_stream_t streams[SDMAP_STREAMS];
+};
+
+static sdmap_t maps[SDMAP_DISKS] = {};
+static uint32_t page_size = 0;
+
+static void unmap_window(sdmap_t *m)
+{
+	if (m->map) munmap(m->map, m->map_len);
+	m->map = 0;
+	m->map_start = 0;
+	m->map_len = 0;
+}
+
+static int map_window(sdmap_t *m, uint64_t offset, uint32_t len)
+{
+	uint64_t start = offset & ~(uint64_t)(SDMAP_WINDOW - 1);
+	if (offset + len > start + SDMAP_WINDOW) start = offset & ~(uint64_t)(page_size - 1);
+
+	uint64_t map_len = m->size - start;
+	if (map_len > SDMAP_WINDOW) map_len = SDMAP_WINDOW;
+
+	unmap_window(m);
+	void *map = mmap(0, map_len, PROT_READ, MAP_SHARED, m->fd, start);
+	if (map == MAP_FAILED)
+	{
+		printf("sdmap: mmap failed at %llu, using regular reads.\n", (unsigned long long)start);
+		close(m->fd);
+		m->fd = -1;
+		return 0;
+	}
+
+	m->map = (uint8_t*)map;
+	m->map_start = start;
+	m->map_len = map_len;
+	return 1;
+}
+
+void sdmap_open(int disk, fileTYPE *f)
+{
+	sdmap_close(disk);
+	if (!page_size) page_size = sysconf(_SC_PAGESIZE);
+
+	// zip and memory images have no plain file behind them
+	if (!f->filp || f->zip || f->type || !f->size) return;
+
+	struct stat64 st;
+	if (fstat64(fileno(f->filp), &st) < 0 || !S_ISREG(st.st_mode)) return;
+
+	// own descriptor, so the window can be moved whatever happens to f
+	int fd = fcntl(fileno(f->filp), F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) return;
+
+	sdmap_t *m = &maps[disk];
+	m->fd = fd;
+	m->size = st.st_size;
+	if (!map_window(m, 0, 0)) return;
+
+	printf("sdmap: %s mapped on %d slot\n", f->name, disk);
+}
+
+void sdmap_close(int disk)
+{
+	sdmap_t *m = &maps[disk];
+	unmap_window(m);
+	if (m->fd > 0) close(m->fd);
+	memset(m, 0, sizeof(sdmap_t));
+	m->fd = -1;
+}
+
+void sdmap_resize(int disk, uint64_t size)
+{
+	if (disk < 0 || disk >= SDMAP_DISKS) return;
+
+	sdmap_t *m = &maps[disk];
+	if (m->fd <= 0 || size <= m->size) return;
+
+	// a window cut short by the old end is mapped again on the next read
+	if (m->map && m->map_len < SDMAP_WINDOW && m->map_start + m->map_len == m->size) unmap_window(m);
+	m->size = size;
+}
+
+static void advise(sdmap_t *m, sdmap_stream_t *s, uint64_t end)
+{
+	uint64_t map_end = m->map_start + m->map_len;
+	if (s->advised < end) s->advised = end;
+	if (s->advised >= map_end || s->advised - end >= SDMAP_AHEAD / 2) return;
+
+	uint64_t from = s->advised & ~(uint64_t)(page_size - 1);
+	uint64_t to = end + SDMAP_AHEAD;
+	if (to > map_end) to = map_end;
+
+	madvise(m->map + (from - m->map_start), to - from, MADV_WILLNEED);
+	s->advised = to;
+}
+
+// Requests continuing one of the recently served ranges are treated as
+// sequential streams and get read ahead. Other requests replace the least
+// recently used range.
+static void track(sdmap_t *m, uint64_t offset, uint32_t len)
+{
+	sdmap_stream_t *s = 0;
+	sdmap_stream_t *lru = &m->streams[0];
+	for (int i = 0; i < SDMAP_STREAMS; i++)
+	{
+		if (m->streams[i].stamp && m->streams[i].next == offset)
+		{
+			s = &m->streams[i];
+			break;
+		}
+		if (m->streams[i].stamp < lru->stamp) lru = &m->streams[i];
+	}
+
+	if (s)
+	{
+		PROFILE_COUNTER("sdmap_seq", 1);
+		advise(m, s, offset + len);
+	}
+	else
+	{
+		s = lru;
+		s->advised = offset + len;
+	}
+
+	s->next = offset + len;
+	s->stamp = ++m->stamp;
+}
+
+const uint8_t *sdmap_get(int disk, uint64_t offset, uint32_t len)
+{
+	if (disk < 0 || disk >= SDMAP_DISKS) return 0;
+
+	sdmap_t *m = &maps[disk];
+	if (m->fd <= 0 || !len || offset + len > m->size) return 0;
+
+	if (!m->map || offset < m->map_start || offset + len > m->map_start + m->map_len)
+	{
+		PROFILE_COUNTER("sdmap_remap", 1);
+		if (!map_window(m, offset, len)) return 0;
+	}
+
+	track(m, offset, len);
+
+	// fault the pages in now so the SPI transfer doesn't stall on I/O
+	const volatile uint8_t *p = m->map + (offset - m->map_start);
+	for (uint32_t i = 0; i < len; i += page_size) (void)p[i];
+	(void)p[len - 1];
+
+	return (const uint8_t*)p;
+}
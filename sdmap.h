@@ -0,0 +1,23 @@
+#ifndef SDMAP_H
+#define SDMAP_H
+
+#include <inttypes.h>
+#include "file_io.h"
+
+// Memory mapped SD images. Sector reads are sent to the core straight from
+// the page cache instead of going through stdio and the sector buffers.
+// Large images are mapped through a sliding window.
+
+// Maps f for disk if it is a plain file. Unmaps any previous image.
+// Writes through f land in the same page cache, so the mapping sees them.
+void sdmap_open(int disk, fileTYPE *f);
+void sdmap_close(int disk);
+
+// New size after a write grew the image, so the added sectors are mapped too.
+void sdmap_resize(int disk, uint64_t size);
+
+// Returns len bytes at offset with the pages already faulted in,
+// or 0 if the range must be read the usual way.
+const uint8_t *sdmap_get(int disk, uint64_t offset, uint32_t len);
+
+#endif
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "share_io.h"
+#include "offload.h"
+#include "profiling.h"
+
+#define RA_SIZE (64 * 1024)
+
+static fileTYPE *ra_file = 0;
+static dev_t     ra_dev = 0;  // the buffered file, also when written through another handle
+static ino_t     ra_ino = 0;
+static uint8_t  *ra_buf = 0;
+static uint64_t  ra_pos = 0;
+static uint32_t  ra_len = 0;
+static uint64_t  ra_next = 0; // end of the last read
+static int       ra_seq = 0;
+
+void share_async_run(share_async_t *req, std::function<void()> work)
+{
+	if (!req->init)
+	{
+		sem_init(&req->done, 0, 0);
+		req->init = 1;
+	}
+
+	req->busy = 1;
+	offload_add_work([req, work]
+	{
+		work();
+		sem_post(&req->done);
+
+		// the guest is busy with the response now
+		share_ra_fill();
+	});
+}
+
+int share_async_done(share_async_t *req)
+{
+	if (!req->busy || sem_trywait(&req->done)) return 0;
+	req->busy = 0;
+	return 1;
+}
+
+void share_async_sync(share_async_t *req)
+{
+	if (req->busy)
+	{
+		sem_wait(&req->done);
+		req->busy = 0;
+	}
+
+	// read-ahead may still be running
+	sem_t idle;
+	sem_init(&idle, 0, 0);
+	offload_add_work([&idle] { sem_post(&idle); });
+	sem_wait(&idle);
+	sem_destroy(&idle);
+}
+
+static int file_id(fileTYPE *f, dev_t *dev, ino_t *ino)
+{
+	struct stat st;
+	if (!f->filp || fstat(fileno(f->filp), &st) < 0) return 0;
+
+	*dev = st.st_dev;
+	*ino = st.st_ino;
+	return 1;
+}
+
+int share_ra_read(fileTYPE *f, void *buf, int len, int failres)
+{
+	PROFILE_FUNCTION();
+
+	uint64_t pos = f->offset;
+	if (f->zip)
+	{
+		share_ra_drop(f);
+		return FileReadAdv(f, buf, len, failres);
+	}
+
+	ra_seq = (ra_file == f && pos == ra_next);
+	if (ra_file != f)
+	{
+		ra_file = f;
+		ra_len = 0;
+		if (!file_id(f, &ra_dev, &ra_ino))
+		{
+			ra_file = 0;
+			return FileReadAdv(f, buf, len, failres);
+		}
+	}
+
+	int ret;
+	if (len > 0 && pos >= ra_pos && pos + len <= ra_pos + ra_len)
+	{
+		memcpy(buf, ra_buf + (pos - ra_pos), len);
+		FileSeek(f, pos + len, SEEK_SET);
+		ret = len;
+	}
+	else
+	{
+		ret = FileReadAdv(f, buf, len, failres);
+	}
+
+	ra_next = f->offset;
+	return ret;
+}
+
+void share_ra_fill()
+{
+	PROFILE_FUNCTION();
+
+	if (!ra_file || !ra_seq) return;
+
+	// still at least half a buffer ahead of the guest
+	if (ra_next >= ra_pos && ra_next + RA_SIZE / 2 <= ra_pos + ra_len) return;
+	if (ra_next >= (uint64_t)ra_file->size) return;
+
+	if (!ra_buf) ra_buf = (uint8_t*)malloc(RA_SIZE);
+	if (!ra_buf) return;
+
+	__off64_t offset = ra_file->offset;
+	FileSeek(ra_file, ra_next, SEEK_SET);
+	int len = FileReadAdv(ra_file, ra_buf, RA_SIZE, -1);
+	FileSeek(ra_file, offset, SEEK_SET);
+
+	ra_pos = ra_next;
+	ra_len = (len > 0) ? len : 0;
+}
+
+void share_ra_drop(fileTYPE *f)
+{
+	if (!ra_file) return;
+	if (f && f != ra_file)
+	{
+		dev_t dev;
+		ino_t ino;
+		if (!file_id(f, &dev, &ino) || dev != ra_dev || ino != ra_ino) return;
+	}
+
+	ra_file = 0;
+	ra_len = 0;
+	ra_seq = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef SHARE_IO_H
+#define SHARE_IO_H
+
+#include <inttypes.h>
+#include <semaphore.h>
+#include <functional>
+
+#include "file_io.h"
+
+// Shared folder requests are executed on the offload thread. The guest has a single
+// request buffer, so at most one request plus one read-ahead job are in flight.
+struct share_async_t
+{
+	int busy;
+	int init;
+	sem_t done;
+};
+
+void share_async_run(share_async_t *req, std::function<void()> work);
+int  share_async_done(share_async_t *req);   // non-blocking, 1 once the request has completed
+void share_async_sync(share_async_t *req);   // waits for all queued work incl. read-ahead
+
+// Single stream read-ahead for sequential reads of a share file.
+int  share_ra_read(fileTYPE *f, void *buf, int len, int failres = 0); // reads at f->offset
+void share_ra_fill();                        // on the offload thread after the response is posted
+void share_ra_drop(fileTYPE *f = 0);         // drops it if f is the same file, f = 0 drops everything
+
+#endif
@@ -10,6 +10,7 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <inttypes.h>
 
 #include "shmem.h"
 
@@ -17,6 +18,28 @@ static int memfd = -1;
 
 void *shmem_map(uint32_t address, uint32_t size)
 {
+#ifdef MISTER_SIM
+	// host builds back the physical address space with a sparse file
+	if (memfd < 0)
+	{
+		const char *path = getenv("MISTER_SIM_MEM");
+		if (!path) path = "/tmp/MiSTer_sim_mem.bin";
+
+		memfd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (memfd == -1)
+		{
+			printf("Error: Unable to open %s!\n", path);
+			return 0;
+		}
+	}
+
+	struct stat64 st;
+	if (!fstat64(memfd, &st) && (uint64_t)st.st_size < (uint64_t)address + size && ftruncate(memfd, (uint64_t)address + size) < 0)
+	{
+		printf("Error: Unable to grow sim memory to 0x%" PRIX64 "!\n", (uint64_t)address + size);
+		return 0;
+	}
+#else
 	if (memfd < 0)
 	{
 		memfd = open("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC);
@@ -26,6 +49,7 @@ void *shmem_map(uint32_t address, uint32_t size)
 			return 0;
 		}
 	}
+#endif
 
 	void *res = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, address);
 	if (res == (void *)-1)
@@ -41,7 +65,7 @@ int shmem_unmap(void* map, uint32_t size)
 {
 	if (munmap(map, size) < 0)
 	{
-		printf("Error: Unable to unmap(0x%X, %d)!\n", (uint32_t)map, size);
+		printf("Error: Unable to unmap(%p, %d)!\n", map, size);
 		return 0;
 	}
 
@@ -1,6 +1,8 @@
+#define SPI_TRACE_NO_WRAP
 #include "spi.h"
 #include "hardware.h"
 #include "fpga_io.h"
+#include "spi_trace.h"
 
 #define SSPI_FPGA_EN (1<<18)
 #define SSPI_OSD_EN  (1<<19)
@@ -10,12 +12,14 @@
 
 void EnableFpga()
 {
+	SPI_TRACE_BEGIN(SPI_CS_FPGA);
 	fpga_spi_en(SSPI_FPGA_EN, 1);
 }
 
 void DisableFpga()
 {
 	fpga_spi_en(SSPI_FPGA_EN, 0);
+	SPI_TRACE_END();
 }
 
 static int osd_target = OSD_ALL;
@@ -34,22 +38,26 @@ void EnableOsd()
 	if (osd_target & OSD_HDMI) mask &= ~SSPI_FPGA_EN;
 	if (osd_target & OSD_VGA) mask &= ~SSPI_IO_EN;
 
+	SPI_TRACE_BEGIN(SPI_CS_OSD);
 	fpga_spi_en(mask, 1);
 }
 
 void DisableOsd()
 {
 	fpga_spi_en(SSPI_OSD_EN | SSPI_IO_EN | SSPI_FPGA_EN, 0);
+	SPI_TRACE_END();
 }
 
 void EnableIO()
 {
+	SPI_TRACE_BEGIN(SPI_CS_IO);
 	fpga_spi_en(SSPI_IO_EN, 1);
 }
 
 void DisableIO()
 {
 	fpga_spi_en(SSPI_IO_EN, 0);
+	SPI_TRACE_END();
 }
 
 uint32_t spi32_w(uint32_t parm)
@@ -181,14 +189,12 @@ void spi_write(const uint8_t *addr, uint32_t len, int wide)
 {
 	if (wide)
 	{
-		uint32_t len16 = len >> 1;
-		uint16_t *a16 = (uint16_t*)addr;
-		while (len16--) spi_w(*a16++);
-		if(len & 1) spi_w(*((uint8_t*)a16));
+		fpga_spi_block_write((const uint16_t*)addr, len >> 1);
+		if(len & 1) spi_w(addr[len - 1]);
 	}
 	else
 	{
-		while (len--) spi_b(*addr++);
+		fpga_spi_block_write_8(addr, len);
 	}
 }
 
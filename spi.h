@@ -60,4 +60,24 @@ uint16_t spi_uio_cmd16(uint8_t cmd, uint16_t parm);
 void spi_uio_cmd32(uint8_t cmd, uint32_t parm, int wide);
 void spi_uio_cmd32_cont(uint8_t cmd, uint32_t parm);
 
+#if defined(SPI_TRACE) && !defined(SPI_TRACE_NO_WRAP)
+// tag every chip select window with the source file that opened it
+#include "spi_trace.h"
+#define SPI_TRACE_TAG(call) (spi_trace_owner(__FILE__), call)
+#define EnableFpga() SPI_TRACE_TAG(EnableFpga())
+#define EnableOsd() SPI_TRACE_TAG(EnableOsd())
+#define EnableIO() SPI_TRACE_TAG(EnableIO())
+#define spi_osd_cmd_cont(...) SPI_TRACE_TAG(spi_osd_cmd_cont(__VA_ARGS__))
+#define spi_osd_cmd(...) SPI_TRACE_TAG(spi_osd_cmd(__VA_ARGS__))
+#define spi_osd_cmd8_cont(...) SPI_TRACE_TAG(spi_osd_cmd8_cont(__VA_ARGS__))
+#define spi_osd_cmd8(...) SPI_TRACE_TAG(spi_osd_cmd8(__VA_ARGS__))
+#define spi_uio_cmd_cont(...) SPI_TRACE_TAG(spi_uio_cmd_cont(__VA_ARGS__))
+#define spi_uio_cmd(...) SPI_TRACE_TAG(spi_uio_cmd(__VA_ARGS__))
+#define spi_uio_cmd8_cont(...) SPI_TRACE_TAG(spi_uio_cmd8_cont(__VA_ARGS__))
+#define spi_uio_cmd8(...) SPI_TRACE_TAG(spi_uio_cmd8(__VA_ARGS__))
+#define spi_uio_cmd16(...) SPI_TRACE_TAG(spi_uio_cmd16(__VA_ARGS__))
+#define spi_uio_cmd32(...) SPI_TRACE_TAG(spi_uio_cmd32(__VA_ARGS__))
+#define spi_uio_cmd32_cont(...) SPI_TRACE_TAG(spi_uio_cmd32_cont(__VA_ARGS__))
+#endif
+
 #endif // SPI_H
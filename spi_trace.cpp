@@ -0,0 +1,219 @@
+#ifdef SPI_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include <atomic>
+
+#include "spi_trace.h"
+#include "offload.h"
+
+static constexpr uint32_t MAX_RECORDS = 4096; // must be pow2
+static constexpr uint32_t MAX_OWNERS = 64;
+static constexpr uint32_t MAX_LONGEST = 8;
+static constexpr uint64_t REPORT_NS = 10000000000ULL;
+
+struct Window
+{
+	const char *owner;
+	uint64_t begin_ns;
+	uint32_t dur_ns;
+	uint32_t words;
+	uint16_t cmd;
+	uint8_t cs;
+};
+
+struct OwnerStats
+{
+	const char *owner;
+	uint32_t windows;
+	uint64_t words;
+	uint64_t busy_ns;
+	uint32_t max_ns;
+};
+
+// written by the main thread only, readers pick up the tail with acquire
+static Window s_ring[MAX_RECORDS];
+static std::atomic<uint32_t> s_ring_tail(0);
+
+static OwnerStats s_owners[MAX_OWNERS];
+static uint32_t s_owner_cnt = 0;
+static Window s_longest[MAX_LONGEST];
+
+static const char *s_pending_owner = 0;
+static Window s_cur;
+static int s_open = 0;
+static uint64_t s_report_ns = 0;
+static uint64_t s_report_due = 0;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static const char *owner_name(const char *owner)
+{
+	if (!owner) return "unknown";
+	const char *p = strrchr(owner, '/');
+	return p ? p + 1 : owner;
+}
+
+static const char *cs_name(int cs)
+{
+	if (cs & SPI_CS_OSD) return "osd";
+	if (cs & SPI_CS_IO) return "io";
+	return "fpga";
+}
+
+static OwnerStats *get_owner(const char *owner)
+{
+	for (uint32_t i = 0; i < s_owner_cnt; i++)
+	{
+		if (s_owners[i].owner == owner) return &s_owners[i];
+	}
+
+	if (s_owner_cnt == MAX_OWNERS) return &s_owners[MAX_OWNERS - 1];
+	OwnerStats *stats = &s_owners[s_owner_cnt++];
+	memset(stats, 0, sizeof(OwnerStats));
+	stats->owner = owner;
+	return stats;
+}
+
+// The ring is copied here, the file is written on the offload thread.
+static void dump_ring()
+{
+	uint32_t tail = s_ring_tail.load(std::memory_order_acquire);
+	uint32_t first = (tail > MAX_RECORDS) ? tail - MAX_RECORDS : 0;
+	uint32_t count = tail - first;
+
+	Window *copy = (Window*)malloc(count * sizeof(Window));
+	if (!copy) return;
+	for (uint32_t i = 0; i < count; i++) copy[i] = s_ring[(first + i) % MAX_RECORDS];
+
+	offload_add_work([copy, count]
+	{
+		FILE *fp = fopen("/tmp/spi_trace.txt", "wt");
+		if (fp)
+		{
+			fprintf(fp, "# begin_us cs owner cmd words dur_us\n");
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const Window *w = &copy[i];
+				fprintf(fp, "%" PRIu64 " %s %s %04X %u %u\n", w->begin_ns / 1000, cs_name(w->cs), owner_name(w->owner), w->cmd, w->words, w->dur_ns / 1000);
+			}
+			fclose(fp);
+		}
+		free(copy);
+	});
+}
+
+static void report(uint64_t now)
+{
+	uint64_t period = now - s_report_ns;
+	uint64_t busy = 0;
+	for (uint32_t i = 0; i < s_owner_cnt; i++) busy += s_owners[i].busy_ns;
+
+	printf("\nSPI bus: %" PRIu64 "ms, busy %" PRIu64 ".%02" PRIu64 "%%\n", period / 1000000, (busy * 100) / period, ((busy * 10000) / period) % 100);
+	printf("+----- Owner ------------------+ Windows +    Words + Busy(us) + Max(us) +\n");
+	for (uint32_t i = 0; i < s_owner_cnt; i++)
+	{
+		const OwnerStats *s = &s_owners[i];
+		printf("| %-28s | %7u | %8" PRIu64 " | %8" PRIu64 " | %7u |\n", owner_name(s->owner), s->windows, s->words, s->busy_ns / 1000, s->max_ns / 1000);
+	}
+	printf("+------------------------------+---------+----------+----------+---------+\n");
+
+	for (uint32_t i = 0; i < MAX_LONGEST && s_longest[i].dur_ns; i++)
+	{
+		const Window *w = &s_longest[i];
+		printf("  %6uus %-4s %-24s cmd %04X, %u words\n", w->dur_ns / 1000, cs_name(w->cs), owner_name(w->owner), w->cmd, w->words);
+	}
+
+	dump_ring();
+
+	s_owner_cnt = 0;
+	memset(s_longest, 0, sizeof(s_longest));
+	s_report_ns = now;
+}
+
+void spi_trace_owner(const char *owner)
+{
+	s_pending_owner = owner;
+}
+
+void spi_trace_begin(int cs)
+{
+	if (s_open)
+	{
+		s_cur.cs |= cs;
+		return;
+	}
+
+	s_open = 1;
+	s_cur.owner = s_pending_owner;
+	s_cur.cs = cs;
+	s_cur.cmd = 0;
+	s_cur.words = 0;
+	s_cur.begin_ns = now_ns();
+	s_pending_owner = 0;
+}
+
+void spi_trace_word(uint16_t word)
+{
+	if (!s_open) return;
+	if (!s_cur.words) s_cur.cmd = word;
+	s_cur.words++;
+}
+
+void spi_trace_block(uint16_t first, uint32_t count)
+{
+	if (!s_open || !count) return;
+	if (!s_cur.words) s_cur.cmd = first;
+	s_cur.words += count;
+}
+
+void spi_trace_end()
+{
+	if (!s_open) return;
+	s_open = 0;
+
+	uint64_t now = now_ns();
+	s_cur.dur_ns = (uint32_t)(now - s_cur.begin_ns);
+
+	uint32_t tail = s_ring_tail.load(std::memory_order_relaxed);
+	s_ring[tail % MAX_RECORDS] = s_cur;
+	s_ring_tail.store(tail + 1, std::memory_order_release);
+
+	OwnerStats *stats = get_owner(s_cur.owner);
+	stats->windows++;
+	stats->words += s_cur.words;
+	stats->busy_ns += s_cur.dur_ns;
+	if (s_cur.dur_ns > stats->max_ns) stats->max_ns = s_cur.dur_ns;
+
+	// keep the longest windows sorted, longest first
+	for (uint32_t i = 0; i < MAX_LONGEST; i++)
+	{
+		if (s_cur.dur_ns > s_longest[i].dur_ns)
+		{
+			memmove(&s_longest[i + 1], &s_longest[i], (MAX_LONGEST - i - 1) * sizeof(Window));
+			s_longest[i] = s_cur;
+			break;
+		}
+	}
+
+	// the report is printed from the poll loop, not inside the chip select window
+	if (!s_report_ns) s_report_ns = now;
+	else if (!s_report_due && now - s_report_ns >= REPORT_NS) s_report_due = now;
+}
+
+void spi_trace_poll()
+{
+	if (!s_report_due) return;
+	report(s_report_due);
+	s_report_due = 0;
+}
+
+#endif // SPI_TRACE
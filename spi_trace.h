@@ -0,0 +1,38 @@
+#ifndef SPI_TRACE_H
+#define SPI_TRACE_H 1
+
+#include <inttypes.h>
+
+#define SPI_CS_FPGA 1
+#define SPI_CS_OSD  2
+#define SPI_CS_IO   4
+
+#ifdef SPI_TRACE
+
+// Records every chip select window (owner, command, words, duration) into a ring.
+// Utilisation per owner and the longest windows are reported every 10 seconds
+// by spi_trace_poll, the ring is dumped to /tmp/spi_trace.txt at the same time.
+void spi_trace_owner(const char *owner);
+void spi_trace_begin(int cs);
+void spi_trace_word(uint16_t word);
+void spi_trace_block(uint16_t first, uint32_t count);
+void spi_trace_end();
+void spi_trace_poll();
+
+#define SPI_TRACE_BEGIN(cs) spi_trace_begin(cs)
+#define SPI_TRACE_WORD(w) spi_trace_word(w)
+#define SPI_TRACE_BLOCK(first, count) spi_trace_block(first, count)
+#define SPI_TRACE_END() spi_trace_end()
+#define SPI_TRACE_POLL() spi_trace_poll()
+
+#else // SPI_TRACE
+
+#define SPI_TRACE_BEGIN(cs)
+#define SPI_TRACE_WORD(w)
+#define SPI_TRACE_BLOCK(first, count)
+#define SPI_TRACE_END()
+#define SPI_TRACE_POLL()
+
+#endif // SPI_TRACE
+
+#endif // SPI_TRACE_H
@@ -2,10 +2,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sched.h>
+#include <atomic>
+#include <new>
 
 #include "../../file_io.h"
 #include "../../user_io.h"
 #include "../../hardware.h"
+#include "../../offload.h"
 
 
 #include "dsk2nib_lib.h"
@@ -133,58 +137,25 @@ static int phys_to_logical_sector(int phys_sector) {
     return 0; // fallback
 }
 
-void a2_readDsk2Nib(fileTYPE*fd, uint64_t offset, uchar *byte) {
-    int nib_track = offset / BYTES_PER_NIB_TRACK;
-    uint64_t track_offset = offset % BYTES_PER_NIB_TRACK;
+// Encode one DSK track (16 sectors in file order) into a NIB track
+static void encode_track(const uchar *dsk_track, int nib_track, uchar *nib_track_data) {
     int volume = DEFAULT_VOLUME;
-    
-    // Bounds check
-    if (nib_track >= TRACKS_PER_DISK) {
-        memset(byte, 0, 512);
-        return;
-    }
-    
-    // Build entire NIB track in memory
-    uchar nib_track_data[BYTES_PER_NIB_TRACK];
-    
+
     // Process all 16 sectors in this track
     for (int phys_sector = 0; phys_sector < SECTORS_PER_TRACK; phys_sector++) {
         // Convert physical sector to logical sector
         int logical_sector = phys_to_logical_sector(phys_sector);
-        
+
         // Get corresponding DSK soft sector
         int dsk_soft_sector = soft_interleave[logical_sector];
-        
-        // Read DSK sector data
-        uchar dsk_sector[BYTES_PER_SECTOR];
-        off_t dsk_offset = (off_t)nib_track * BYTES_PER_TRACK + (off_t)dsk_soft_sector * BYTES_PER_SECTOR;
-
-	if (FileSeek(fd, dsk_offset, SEEK_SET))
-        {
-             if (FileReadAdv(fd, dsk_sector, BYTES_PER_SECTOR))
-             {
-		     // good
-             }
-	     else {
-            	memset(dsk_sector, 0, BYTES_PER_SECTOR);
-	     }
-        } else {
-            memset(dsk_sector, 0, BYTES_PER_SECTOR);
-	}
 
-        
-        //if (lseek(fd, dsk_offset, SEEK_SET) == -1) {
-        //} else if (read(fd, dsk_sector, BYTES_PER_SECTOR) != BYTES_PER_SECTOR) {
-        //    memset(dsk_sector, 0, BYTES_PER_SECTOR);
-        //}
-        
         // Build NIB sector structure
         nib_sector_t nib_sector;
-        
+
         // Initialize gaps
         memset(nib_sector.gap1, GAP_BYTE, GAP1_LEN);
         memset(nib_sector.gap2, GAP_BYTE, GAP2_LEN);
-        
+
         // Set address field
         memcpy(nib_sector.addr.prolog, addr_prolog, 3);
         memcpy(nib_sector.addr.epilog, addr_epilog, 3);
@@ -193,31 +164,157 @@ void a2_readDsk2Nib(fileTYPE*fd, uint64_t offset, uchar *byte) {
         odd_even_encode(nib_sector.addr.sector, logical_sector);
         int csum = volume ^ nib_track ^ logical_sector;
         odd_even_encode(nib_sector.addr.checksum, csum);
-        
+
         // Set data field
         memcpy(nib_sector.data.prolog, data_prolog, 3);
         memcpy(nib_sector.data.epilog, data_epilog, 3);
-        nibbilize(dsk_sector, &nib_sector.data);
-        
+        nibbilize((uchar*)dsk_track + dsk_soft_sector * BYTES_PER_SECTOR, &nib_sector.data);
+
         // Copy this sector to the track buffer
         memcpy(nib_track_data + phys_sector * BYTES_PER_NIB_SECTOR, &nib_sector, sizeof(nib_sector));
     }
-    
+}
+
+// Per drive cache of the whole disk. The DSK image is read once at mount,
+// NIB tracks are encoded on the offload thread and on demand if the core
+// gets to a track first. Writes update the DSK copy and drop the track.
+// The disk is shared with the prefill job, the last user frees it.
+#define NIB_CACHED_DRIVES 4
+#define TRACK_EMPTY   0
+#define TRACK_BUSY    1
+#define TRACK_READY   2
+
+struct nib_disk_t {
+    uchar dsk[TRACKS_PER_DISK * BYTES_PER_TRACK];
+    uchar nib[TRACKS_PER_DISK * BYTES_PER_NIB_TRACK];
+    std::atomic<int> state[TRACKS_PER_DISK];
+    std::atomic<int> refs;
+    std::atomic<int> cancel;                     // set on close, stops the prefill job
+};
+
+struct nib_cache_t {
+    fileTYPE *fd;
+    nib_disk_t *disk;
+};
+
+static nib_cache_t nib_cache[NIB_CACHED_DRIVES];
+
+static nib_cache_t *cache_find(fileTYPE *fd) {
+    for (int i = 0; i < NIB_CACHED_DRIVES; i++) {
+        if (nib_cache[i].fd == fd) return &nib_cache[i];
+    }
+    return NULL;
+}
+
+static void disk_release(nib_disk_t *d) {
+    if (--d->refs == 0) delete d;
+}
+
+// Claims and encodes the track unless another thread has it.
+static int disk_encode(nib_disk_t *d, int track) {
+    int expected = TRACK_EMPTY;
+    if (!d->state[track].compare_exchange_strong(expected, TRACK_BUSY)) return 0;
+
+    encode_track(d->dsk + track * BYTES_PER_TRACK, track, d->nib + track * BYTES_PER_NIB_TRACK);
+    d->state[track] = TRACK_READY;
+    return 1;
+}
+
+static const uchar *disk_track(nib_disk_t *d, int track) {
+    while (d->state[track] != TRACK_READY) {
+        if (!disk_encode(d, track)) sched_yield();
+    }
+    return d->nib + track * BYTES_PER_NIB_TRACK;
+}
+
+void a2_closeDSK(fileTYPE *fd) {
+    nib_cache_t *c = cache_find(fd);
+    if (!c) return;
+
+    // a running prefill finishes its current track and drops its reference
+    c->disk->cancel = 1;
+    disk_release(c->disk);
+    c->disk = NULL;
+    c->fd = NULL;
+}
+
+void a2_openDSK(fileTYPE *fd) {
+    a2_closeDSK(fd);
+
+    nib_cache_t *c = cache_find(NULL);
+    if (!c) return;
+
+    nib_disk_t *d = new (std::nothrow) nib_disk_t;
+    if (!d) {
+        printf("A2: not enough memory for the NIB cache.\n");
+        return;
+    }
+
+    // short images read as zeros, same as the uncached path
+    memset(d->dsk, 0, sizeof(d->dsk));
+    if (FileSeek(fd, 0, SEEK_SET)) FileReadAdv(fd, d->dsk, sizeof(d->dsk));
+
+    for (int i = 0; i < TRACKS_PER_DISK; i++) d->state[i] = TRACK_EMPTY;
+    d->cancel = 0;
+    d->refs = 2;
+    c->fd = fd;
+    c->disk = d;
+
+    offload_add_work([d]
+    {
+        for (int i = 0; i < TRACKS_PER_DISK && !d->cancel; i++) disk_encode(d, i);
+        disk_release(d);
+    });
+}
+
+void a2_readDsk2Nib(fileTYPE*fd, uint64_t offset, uchar *byte) {
+    int nib_track = offset / BYTES_PER_NIB_TRACK;
+    uint64_t track_offset = offset % BYTES_PER_NIB_TRACK;
+
+    // Bounds check
+    if (nib_track >= TRACKS_PER_DISK) {
+        memset(byte, 0, 512);
+        return;
+    }
+
+    const uchar *nib_track_data;
+    uchar nib_buf[BYTES_PER_NIB_TRACK];
+
+    nib_cache_t *c = cache_find(fd);
+    if (c) {
+        nib_track_data = disk_track(c->disk, nib_track);
+    }
+    else {
+        // Build entire NIB track in memory
+        uchar dsk_track[BYTES_PER_TRACK];
+        off_t dsk_offset = (off_t)nib_track * BYTES_PER_TRACK;
+
+        for (int sector = 0; sector < SECTORS_PER_TRACK; sector++) {
+            uchar *dsk_sector = dsk_track + sector * BYTES_PER_SECTOR;
+            if (!FileSeek(fd, dsk_offset + sector * BYTES_PER_SECTOR, SEEK_SET) || !FileReadAdv(fd, dsk_sector, BYTES_PER_SECTOR)) {
+                memset(dsk_sector, 0, BYTES_PER_SECTOR);
+            }
+        }
+
+        encode_track(dsk_track, nib_track, nib_buf);
+        nib_track_data = nib_buf;
+    }
+
     // Copy requested 512 bytes from the track
     int bytes_to_copy = 512;
     int available_bytes = BYTES_PER_NIB_TRACK - track_offset;
-    
+
     if (available_bytes <= 0) {
         memset(byte, 0, 512);
         return;
     }
-    
+
     if (bytes_to_copy > available_bytes) {
         bytes_to_copy = available_bytes;
     }
-    
+
     memcpy(byte, nib_track_data + track_offset, bytes_to_copy);
-    
+
     // Fill remaining bytes with zeros if needed
     if (bytes_to_copy < 512) {
         memset(byte + bytes_to_copy, 0, 512 - bytes_to_copy);
@@ -456,6 +553,19 @@ void a2_writeNib2Dsk(fileTYPE*fd, uint64_t offset, uchar *byte) {
                 if (FileSeek(fd,dsk_offset, SEEK_SET))
 	//			if (lseek(fd, dsk_offset, SEEK_SET) != -1) {
 		    FileWriteAdv(fd, dsk_sector,BYTES_PER_SECTOR);
+
+                nib_cache_t *c = cache_find(fd);
+                if (c) {
+                    // hold the track so no encode reads it while it changes
+                    nib_disk_t *d = c->disk;
+                    int st = d->state[track_num];
+                    while (st == TRACK_BUSY || !d->state[track_num].compare_exchange_weak(st, TRACK_BUSY)) {
+                        sched_yield();
+                        st = d->state[track_num];
+                    }
+                    memcpy(d->dsk + dsk_offset, dsk_sector, BYTES_PER_SECTOR);
+                    d->state[track_num] = TRACK_EMPTY;
+                }
                     //write(fd, dsk_sector, BYTES_PER_SECTOR);
                 //}
             }
@@ -5,6 +5,11 @@
 
 typedef unsigned char uchar;
 
+// Per drive NIB track cache, filled on the offload thread after mount.
+// Without it tracks are converted from the file on every read.
+void a2_openDSK(fileTYPE *fd);
+void a2_closeDSK(fileTYPE *fd);
+
 // Library function for on-demand DSK to NIB conversion
 void a2_readDsk2Nib(fileTYPE*fd, uint64_t offset, uchar *byte);
 
@@ -786,23 +786,39 @@ static uint64_t get_us(uint64_t offset)
 	return (uint64_t)(res + offset);
 }
 
-static uint8_t check_us(uint64_t time)
+#ifdef SIO_TRACE
+// Records every wait as "<us since the previous wait ended> <wait us>", the
+// format read by tests/sio_replay.cpp.
+static void sio_trace_wait(uint64_t time)
 {
-	long int remaining = time - get_us(0);
-#ifdef USE_SCHEDULER
-	if(remaining >= (long int)10000)
+	static FILE *trace = 0;
+	static uint64_t last = 0;
+
+	if (!trace)
 	{
-		input_poll(0);
-		scheduler_yield();
+		trace = fopen("/tmp/sio_trace.txt", "wt");
+		if (!trace) return;
+		setvbuf(trace, NULL, _IOLBF, 0);
+		fprintf(trace, "# gap_us wait_us\n");
 	}
-#endif
-	return remaining <= 0;
+
+	uint64_t now = get_us(0);
+	if (time) fprintf(trace, "%" PRIu64 " %" PRIu64 "\n", last ? now - last : 0, time);
+	last = now + time;
 }
+#endif
 
 static void wait_us(uint64_t time)
 {
+#ifdef SIO_TRACE
+	sio_trace_wait(time);
+#endif
 	time = get_us(time);
-	while (!check_us(time));
+#ifdef USE_SCHEDULER
+	scheduler_wait_until(time);
+#else
+	while ((int64_t)(time - get_us(0)) > 0);
+#endif
 }
 
 static void getCurrentHeadPosition()
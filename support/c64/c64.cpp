@@ -13,6 +13,7 @@
 #include "../../input.h"
 
 #include "c64.h"
+#include "c64_gcr.h"
 
 //#define dbgprintf printf
 #define dbgprintf(...)
@@ -376,6 +377,58 @@ static int start_sectors[4][85] = {
 	// }
 };
 
+static uint8_t *encode_track(int idx, uint8_t track_h, const uint8_t *src, int size, uint8_t *gcrptr)
+{
+	uint8_t sec = 0;
+	for (int ptr = 0; ptr < size; ptr += 256)
+	{
+		uint8_t hdr[8] = { 0x08, (uint8_t)(sec ^ track_h ^ gcr_info[idx].id[0] ^ gcr_info[idx].id[1]), sec, track_h, gcr_info[idx].id[1], gcr_info[idx].id[0], 0x0F, 0x0F };
+
+		memset(gcrptr, 0xFF, 5);
+		gcrptr = gcr_encode(hdr, sizeof(hdr), gcrptr + 5);
+		memset(gcrptr, 0x55, 9);
+		gcrptr += 9;
+
+		uint8_t data[260];
+		uint8_t cs = 0;
+		data[0] = 0x07;
+		for (int i = 0; i < 256; i++) cs ^= (data[i + 1] = src[ptr + i]);
+		data[257] = cs;
+		data[258] = 0;
+		data[259] = 0;
+
+		memset(gcrptr, 0xFF, 5);
+		gcrptr = gcr_encode(data, sizeof(data), gcrptr + 5);
+
+		int gap = (track_h < 18) ? 8 : (track_h < 25) ? 17 : (track_h < 31) ? 12 : 9;
+		memset(gcrptr, 0x55, gap);
+		gcrptr += gap;
+		sec++;
+	}
+
+	return gcrptr;
+}
+
+// encoded D64 tracks, dropped when the track is written or the disk ID changes
+struct gcr_track_t
+{
+	uint8_t *data;
+	uint32_t size;
+};
+
+static gcr_track_t gcr_cache[16][84] = {};
+
+static void cache_invalidate(int idx, int track)
+{
+	for (int i = 0; i < 84; i++)
+	{
+		if (track >= 0 && i != track) continue;
+		free(gcr_cache[idx][i].data);
+		gcr_cache[idx][i].data = 0;
+		gcr_cache[idx][i].size = 0;
+	}
+}
+
 int c64_openGCR(const char *path, fileTYPE *f, int idx)
 {
 	// Return value:
@@ -388,6 +441,9 @@ int c64_openGCR(const char *path, fileTYPE *f, int idx)
 	//       1=raw GCR supported  (G64_SUPPORT_GCR)
 	//       2=raw MFM supported  (G64_SUPPORT_MFM)
 
+	gcr_init_lut();
+	cache_invalidate(idx, -1);
+
 	gcr_info[idx].f = f;
 	if (!strcasecmp(path + strlen(path) - 4, ".g64") || !strcasecmp(path + strlen(path) - 4, ".g71"))
 	{
@@ -437,61 +493,7 @@ int c64_openGCR(const char *path, fileTYPE *f, int idx)
 void c64_closeGCR(int idx)
 {
 	gcr_info[idx].type = 0;
-}
-
-static const uint8_t gcr_lut[16] = {
-	0x0a, 0x0b, 0x12, 0x13,
-	0x0e, 0x0f, 0x16, 0x17,
-	0x09, 0x19, 0x1a, 0x1b,
-	0x0d, 0x1d, 0x1e, 0x15
-};
-
-static const uint8_t bin_lut[32] = {
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 8, 0, 1, 0, 12, 4, 5,
-	0, 0, 2, 3, 0, 15, 6, 7,
-	0, 9, 10, 11, 0, 13, 14, 0
-};
-
-static uint8_t *gcrptr;
-static int gcrcnt = 0;
-
-void bin2gcr(uint8_t bin)
-{
-	static uint64_t gcr = 0;
-
-	gcr <<= 5;
-	gcr |= gcr_lut[(bin >> 4) & 0xF];
-	gcr <<= 5;
-	gcr |= gcr_lut[bin & 0xF];
-
-	gcrcnt++;
-	if (gcrcnt == 4)
-	{
-		gcrcnt = 0;
-		*gcrptr++ = (uint8_t)(gcr >> 32);
-		*gcrptr++ = (uint8_t)(gcr >> 24);
-		*gcrptr++ = (uint8_t)(gcr >> 16);
-		*gcrptr++ = (uint8_t)(gcr >> 8);
-		*gcrptr++ = (uint8_t)(gcr);
-	}
-}
-
-void gcr2bin(uint8_t *gcr, uint8_t *bin)
-{
-	// from VICE
-	register uint32_t tmp = *gcr;
-	tmp <<= 13;
-
-	for (int i = 5; i < 13; i += 2, bin++)
-	{
-		gcr++;
-		tmp |= ((uint32_t)(*gcr)) << i;
-		*bin = bin_lut[(tmp >> 16) & 0x1f] << 4;
-		tmp <<= 5;
-		*bin |= bin_lut[(tmp >> 16) & 0x1f];
-		tmp <<= 5;
-	}
+	cache_invalidate(idx, -1);
 }
 
 void c64_readGCR(int idx, uint64_t lba, uint32_t blks)
@@ -533,47 +535,21 @@ void c64_readGCR(int idx, uint64_t lba, uint32_t blks)
 
 		// dbgprintf("GCR physical track=%d%s, logical track=%d, size=%d\n", (track >> 1) + 1, (track & 1) ? ".5" : "", track_h, size);
 		if (size) {
-			FileSeek(gcr_info[idx].f, gcr_info[idx].sector_map[track_f] * 256, SEEK_SET);
-			FileReadAdv(gcr_info[idx].f, trk_buf, size);
-
-			uint8_t sec = 0;
-			gcrptr = gcr_buf + 2;
-			for (int ptr = 0; ptr < size; ptr += 256)
+			gcr_track_t *ct = &gcr_cache[idx][track_f];
+			if (ct->data)
 			{
-				gcrcnt = 0;
-				*gcrptr++ = 0xFF; *gcrptr++ = 0xFF; *gcrptr++ = 0xFF; *gcrptr++ = 0xFF; *gcrptr++ = 0xFF;
-				bin2gcr(0x08);
-				bin2gcr(sec ^ track_h ^ gcr_info[idx].id[0] ^ gcr_info[idx].id[1]);
-				bin2gcr(sec);
-				bin2gcr(track_h);
-				bin2gcr(gcr_info[idx].id[1]);
-				bin2gcr(gcr_info[idx].id[0]);
-				bin2gcr(0x0F);
-				bin2gcr(0x0F);
-				*gcrptr++ = 0x55; *gcrptr++ = 0x55; *gcrptr++ = 0x55; *gcrptr++ = 0x55; *gcrptr++ = 0x55;
-				*gcrptr++ = 0x55; *gcrptr++ = 0x55; *gcrptr++ = 0x55; *gcrptr++ = 0x55;
-
-				uint8_t cs = 0;
-				uint8_t bt;
-
-				*gcrptr++ = 0xFF; *gcrptr++ = 0xFF; *gcrptr++ = 0xFF; *gcrptr++ = 0xFF; *gcrptr++ = 0xFF;
-				bin2gcr(0x07);
-				for (int i = 0; i < 256; i++)
-				{
-					bt = trk_buf[ptr + i];
-					cs ^= bt;
-					bin2gcr(bt);
-				}
-				bin2gcr(cs);
-				bin2gcr(0);
-				bin2gcr(0);
-
-				int gap = (track_h < 18) ? 8 : (track_h < 25) ? 17 : (track_h < 31) ? 12 : 9;
-				while (gap--) *gcrptr++ = 0x55;
-				sec++;
+				memcpy(gcr_buf + 2, ct->data, ct->size);
+			}
+			else
+			{
+				FileSeek(gcr_info[idx].f, gcr_info[idx].sector_map[track_f] * 256, SEEK_SET);
+				FileReadAdv(gcr_info[idx].f, trk_buf, size);
+				ct->size = encode_track(idx, track_h, trk_buf, size, gcr_buf + 2) - gcr_buf - 2;
+				ct->data = (uint8_t*)malloc(ct->size);
+				if (ct->data) memcpy(ct->data, gcr_buf + 2, ct->size);
 			}
 
-			track_size = gcrptr - gcr_buf - 2;
+			track_size = ct->size;
 			dbgprintf("Read GCR track %d: bin_size = %d, gcr_size = %d\n", track_f+1, size, track_size);
 		}
 		else {
@@ -787,6 +763,7 @@ void c64_writeGCR(int idx, uint64_t lba, uint32_t blks)
 
 	dbgprintf("\n\nGCR track = %d\n", track + 1);
 
+	uint8_t id[2] = { gcr_info[idx].id[0], gcr_info[idx].id[1] };
 	int sync = 0;
 	uint8_t prev = 0, started = 0;
 	uint32_t off = 0, ptr = 2;
@@ -807,7 +784,7 @@ void c64_writeGCR(int idx, uint64_t lba, uint32_t blks)
 			uint8_t *hdr = align(gcr_buf + ptr + off, 11);
 
 			uint32_t bin;
-			gcr2bin(hdr, (uint8_t*)&bin);
+			gcr_decode(hdr, 4, (uint8_t*)&bin);
 			if (!started && (bin & 0xFF) == 8)
 			{
 				off = ptr - 2;
@@ -821,7 +798,7 @@ void c64_writeGCR(int idx, uint64_t lba, uint32_t blks)
 			if ((bin & 0xFF) == 8)
 			{
 				sec = (uint8_t)(bin >> 16);
-				gcr2bin(hdr + 5, (uint8_t*)&bin);
+				gcr_decode(hdr + 5, 4, (uint8_t*)&bin);
 				gcr_info[idx].id[1] = (uint8_t)(bin);
 				gcr_info[idx].id[0] = (uint8_t)(bin >> 8);
 
@@ -834,12 +811,7 @@ void c64_writeGCR(int idx, uint64_t lba, uint32_t blks)
 					dbgprintf("data...\n\n");
 					uint8_t *data = align(gcr_buf + ptr + off, 330);
 
-					int dst = 0;
-					int src = 0;
-					for (; dst < 260; src += 5, dst += 4)
-					{
-						gcr2bin(data + src, sec_buf + dst);
-					}
+					gcr_decode(data, 260, sec_buf);
 
 					memcpy(trk_buf + (sec * 256), sec_buf + 1, 256);
 					/*
@@ -874,6 +846,9 @@ void c64_writeGCR(int idx, uint64_t lba, uint32_t blks)
 
 	FileSeek(gcr_info[idx].f, gcr_info[idx].sector_map[track] * 256, SEEK_SET);
 	FileWriteAdv(gcr_info[idx].f, trk_buf, sec_cnt * 256);
+
+	// every sector header carries the disk ID
+	cache_invalidate(idx, (id[0] == gcr_info[idx].id[0] && id[1] == gcr_info[idx].id[1]) ? track : -1);
 }
 
 static const int crt_bank_size = 8192 + 16;
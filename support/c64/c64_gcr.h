@@ -0,0 +1,66 @@
+#ifndef C64_GCR_H
+#define C64_GCR_H
+
+#include <inttypes.h>
+
+// Commodore GCR codec: each nibble becomes a 5 bit code, so 4 bytes pack into 5 GCR bytes.
+// Included by c64.cpp and tests/c64_gcr_test.cpp.
+
+static const uint8_t gcr_lut[16] = {
+	0x0a, 0x0b, 0x12, 0x13,
+	0x0e, 0x0f, 0x16, 0x17,
+	0x09, 0x19, 0x1a, 0x1b,
+	0x0d, 0x1d, 0x1e, 0x15
+};
+
+static const uint8_t bin_lut[32] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 8, 0, 1, 0, 12, 4, 5,
+	0, 0, 2, 3, 0, 15, 6, 7,
+	0, 9, 10, 11, 0, 13, 14, 0
+};
+
+static uint16_t gcr_enc_lut[256];
+static uint8_t gcr_dec_lut[1024];
+
+static void gcr_init_lut()
+{
+	if (gcr_enc_lut[0]) return;
+
+	for (int i = 0; i < 256; i++) gcr_enc_lut[i] = (gcr_lut[i >> 4] << 5) | gcr_lut[i & 0xF];
+	for (int i = 0; i < 1024; i++) gcr_dec_lut[i] = (bin_lut[i >> 5] << 4) | bin_lut[i & 0x1F];
+}
+
+// every 4 bytes become 5 GCR bytes, len must be a multiple of 4
+static uint8_t *gcr_encode(const uint8_t *bin, int len, uint8_t *gcr)
+{
+	for (int i = 0; i < len; i += 4, bin += 4, gcr += 5)
+	{
+		uint64_t v = ((uint64_t)gcr_enc_lut[bin[0]] << 30) | ((uint64_t)gcr_enc_lut[bin[1]] << 20) |
+			((uint32_t)gcr_enc_lut[bin[2]] << 10) | gcr_enc_lut[bin[3]];
+
+		gcr[0] = (uint8_t)(v >> 32);
+		gcr[1] = (uint8_t)(v >> 24);
+		gcr[2] = (uint8_t)(v >> 16);
+		gcr[3] = (uint8_t)(v >> 8);
+		gcr[4] = (uint8_t)v;
+	}
+
+	return gcr;
+}
+
+// every 5 GCR bytes become 4 bytes, len (of bin) must be a multiple of 4
+static void gcr_decode(const uint8_t *gcr, int len, uint8_t *bin)
+{
+	for (int i = 0; i < len; i += 4, bin += 4, gcr += 5)
+	{
+		uint64_t v = ((uint64_t)gcr[0] << 32) | ((uint32_t)gcr[1] << 24) | (gcr[2] << 16) | (gcr[3] << 8) | gcr[4];
+
+		bin[0] = gcr_dec_lut[(v >> 30) & 0x3FF];
+		bin[1] = gcr_dec_lut[(v >> 20) & 0x3FF];
+		bin[2] = gcr_dec_lut[(v >> 10) & 0x3FF];
+		bin[3] = gcr_dec_lut[v & 0x3FF];
+	}
+}
+
+#endif
@@ -27,11 +27,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>
 #include "../../hardware.h"
 #include "../../file_io.h"
+#include "../../memimg.h"
 #include "minimig_fdd.h"
 #include "minimig_config.h"
 #include "../../debug.h"
 #include "../../user_io.h"
 #include "../../menu.h"
+#include "../../spi.h"
 
 unsigned char drives = 0; // number of active drives reported by FPGA (may change only during reset)
 adfTYPE *pdfx;            // drive select pointer
@@ -51,9 +53,25 @@ unsigned char Error;
 
 #define B2W(a,b) (((((uint16_t)(a))<<8) & 0xFF00) | ((uint16_t)(b) & 0x00FF))
 
-						  // sends the data in the sector buffer to the FPGA, translated into an Amiga floppy format sector
+#define SECTOR_WORDS 544 // preamble, sync, header, label, checksums, odd and even data
+#define MFM_CACHED   8   // tracks kept encoded, shared by all drives
+
+typedef struct
+{
+	adfTYPE *drive;
+	int      track;
+	uint32_t stamp;
+	uint16_t mfm[SECTOR_COUNT][SECTOR_WORDS];
+} mfm_track_t;
+
+static mfm_track_t mfm_cache[MFM_CACHED] = {};
+static uint32_t mfm_stamp = 0;
+static uint16_t gap_words[GAP_SIZE / 2];
+
+						  // translates the sector data into an Amiga floppy format sector
 						  // note that we do not insert clock bits because they will be stripped by the Amiga software anyway
-void SendSector(unsigned char *pData, unsigned char sector, unsigned char track, unsigned char dsksynch, unsigned char dsksyncl)
+						  // sync words (1 and 2) are filled in at send time
+static void EncodeSector(uint16_t *out, unsigned char *pData, unsigned char sector, unsigned char track)
 {
 	unsigned char checksum[4];
 	unsigned short i;
@@ -61,48 +79,48 @@ void SendSector(unsigned char *pData, unsigned char sector, unsigned char track,
 	unsigned char *p;
 
 	// preamble
-	spi_w(0xAAAA);
-	spi_w(0xAAAA);
+	*out++ = 0xAAAA;
+	*out++ = 0xAAAA;
 
 	// synchronization
-	spi_w(B2W(dsksynch, dsksyncl));
-	spi_w(B2W(dsksynch, dsksyncl));
+	*out++ = 0;
+	*out++ = 0;
 
 	// odd bits of header
 	x = 0x55;
 	checksum[0] = x;
 	y = (track >> 1) & 0x55;
 	checksum[1] = y;
-	spi_w(B2W(x,y));
+	*out++ = B2W(x,y);
 
 	x = (sector >> 1) & 0x55;
 	checksum[2] = x;
 	y = ((11 - sector) >> 1) & 0x55;
 	checksum[3] = y;
-	spi_w(B2W(x, y));
+	*out++ = B2W(x, y);
 
 	// even bits of header
 	x = 0x55;
 	checksum[0] ^= x;
 	y = track & 0x55;
 	checksum[1] ^= y;
-	spi_w(B2W(x, y));
+	*out++ = B2W(x, y);
 
 	x = sector & 0x55;
 	checksum[2] ^= x;
 	y = (11 - sector) & 0x55;
 	checksum[3] ^= y;
-	spi_w(B2W(x, y));
+	*out++ = B2W(x, y);
 
 	// sector label and reserved area (changes nothing to checksum)
 	i = 0x10;
-	while (i--) spi_w(0xAAAA);
+	while (i--) *out++ = 0xAAAA;
 
-	// send header checksum
-	spi_w(0xAAAA);
-	spi_w(0xAAAA);
-	spi_w(B2W(checksum[0] | 0xAA, checksum[1] | 0xAA));
-	spi_w(B2W(checksum[2] | 0xAA, checksum[3] | 0xAA));
+	// header checksum
+	*out++ = 0xAAAA;
+	*out++ = 0xAAAA;
+	*out++ = B2W(checksum[0] | 0xAA, checksum[1] | 0xAA);
+	*out++ = B2W(checksum[2] | 0xAA, checksum[3] | 0xAA);
 
 	// calculate data checksum
 	checksum[0] = 0;
@@ -124,11 +142,11 @@ void SendSector(unsigned char *pData, unsigned char sector, unsigned char track,
 		checksum[3] ^= x ^ x >> 1;
 	}
 
-	// send data checksum
-	spi_w(0xAAAA);
-	spi_w(0xAAAA);
-	spi_w(B2W(checksum[0] | 0xAA, checksum[1] | 0xAA));
-	spi_w(B2W(checksum[2] | 0xAA, checksum[3] | 0xAA));
+	// data checksum
+	*out++ = 0xAAAA;
+	*out++ = 0xAAAA;
+	*out++ = B2W(checksum[0] | 0xAA, checksum[1] | 0xAA);
+	*out++ = B2W(checksum[2] | 0xAA, checksum[3] | 0xAA);
 
 	// odd bits of data field
 	i = DATA_SIZE / 4;
@@ -137,7 +155,7 @@ void SendSector(unsigned char *pData, unsigned char sector, unsigned char track,
 	{
 		x = (*p++ >> 1) | 0xAA;
 		y = (*p++ >> 1) | 0xAA;
-		spi_w(B2W(x, y));
+		*out++ = B2W(x, y);
 	}
 
 	// even bits of data field
@@ -147,14 +165,72 @@ void SendSector(unsigned char *pData, unsigned char sector, unsigned char track,
 	{
 		x = *p++ | 0xAA;
 		y = *p++ | 0xAA;
-		spi_w(B2W(x, y));
+		*out++ = B2W(x, y);
 	}
 }
 
+static void InvalidateTrack(adfTYPE *drive, int track)
+{
+	for (int i = 0; i < MFM_CACHED; i++)
+	{
+		if (mfm_cache[i].drive == drive && (track < 0 || mfm_cache[i].track == track)) mfm_cache[i].drive = 0;
+	}
+}
+
+// returns the encoded track, reading and encoding it on a miss
+static mfm_track_t *GetTrack(adfTYPE *drive)
+{
+	mfm_track_t *t = 0;
+	for (int i = 0; i < MFM_CACHED; i++)
+	{
+		if (mfm_cache[i].drive == drive && mfm_cache[i].track == drive->track)
+		{
+			t = &mfm_cache[i];
+			t->stamp = ++mfm_stamp;
+			return t;
+		}
+	}
+
+	// replace the least recently used track
+	t = &mfm_cache[0];
+	for (int i = 1; i < MFM_CACHED; i++)
+	{
+		if (mfm_cache[i].stamp < t->stamp) t = &mfm_cache[i];
+	}
+
+	if (!FileSeekLBA(&drive->file, drive->track * SECTOR_COUNT))
+	{
+		return 0;
+	}
+
+	t->drive = 0;
+	for (int sector = 0; sector < SECTOR_COUNT; sector++)
+	{
+		FileReadSec(&drive->file, sector_buffer);
+		EncodeSector(t->mfm[sector], sector_buffer, sector, drive->track);
+	}
+
+	t->drive = drive;
+	t->track = drive->track;
+	t->stamp = ++mfm_stamp;
+	return t;
+}
+
+// sends a cached sector with the requested sync word
+static void SendSector(uint16_t *mfm, unsigned short dsksync)
+{
+	mfm[2] = dsksync;
+	mfm[3] = dsksync;
+	spi_write((uint8_t*)mfm, SECTOR_WORDS * 2, 1);
+}
+
 void SendGap(void)
 {
-	unsigned short i = GAP_SIZE/2;
-	while (i--) spi_w(0xAAAA);
+	if (gap_words[0] != 0xAAAA)
+	{
+		for (unsigned int i = 0; i < sizeof(gap_words) / 2; i++) gap_words[i] = 0xAAAA;
+	}
+	spi_write((uint8_t*)gap_words, sizeof(gap_words), 1);
 }
 
 // read a track from disk
@@ -174,22 +250,24 @@ void ReadTrack(adfTYPE *drive)
 		drive->track = drive->tracks - 1;
 	}
 
-	unsigned long lba;
-
 	if (drive->track != drive->track_prev)
 	{ // track step or track 0, start at beginning of track
 		drive->track_prev = drive->track;
 		sector = 0;
 		drive->sector_offset = sector;
-		lba = drive->track * SECTOR_COUNT;
 	}
 	else
 	{ // same track, start at next sector in track
 		sector = drive->sector_offset;
-		lba = (drive->track * SECTOR_COUNT) + sector;
 	}
 
-	if (!FileSeekLBA(&drive->file, lba))
+	if (!drive->file.opened())
+	{
+		return;
+	}
+
+	mfm_track_t *mfm = GetTrack(drive);
+	if (!mfm)
 	{
 		return;
 	}
@@ -207,8 +285,6 @@ void ReadTrack(adfTYPE *drive)
 
 	while (1)
 	{
-		FileReadSec(&drive->file, sector_buffer);
-
 		EnableFpga();
 
 		// check if FPGA is still asking for data
@@ -239,9 +315,7 @@ void ReadTrack(adfTYPE *drive)
 			// send sector if fpga is still asking for data
 			if (status & CMD_RDTRK)
 			{
-				//GenerateHeader(sector_header, sector_buffer, sector, track, dsksync);
-				//SendSector(sector_header, sector_buffer);
-				SendSector(sector_buffer, sector, track, (unsigned char)(dsksync >> 8), (unsigned char)dsksync);
+				SendSector(mfm->mfm[sector], dsksync);
 
 				if (sector == LAST_SECTOR)
 					SendGap();
@@ -264,11 +338,6 @@ void ReadTrack(adfTYPE *drive)
 		{
 			// go to the start of current track
 			sector = 0;
-			lba = drive->track * SECTOR_COUNT;
-			if (!FileSeekLBA(&drive->file, lba))
-			{
-				return;
-			}
 		}
 
 		// remember current sector
@@ -581,6 +650,7 @@ void WriteTrack(adfTYPE *drive)
 					if (drive->status & DSK_WRITABLE)
 					{
 						FileWriteSec(&drive->file, sector_buffer);
+						InvalidateTrack(drive, Track);
 					}
 					else
 					{
@@ -631,7 +701,11 @@ void InsertFloppy(adfTYPE *drive, char* path)
 {
 	int writable = FileCanWrite(path);
 
-	if (!FileOpenEx(&drive->file, path, writable ? O_RDWR | O_SYNC : O_RDONLY))
+	if (memimg_inner_ext(path))
+	{
+		if (!memimg_open(&drive->file, path, &writable)) return;
+	}
+	else if (!FileOpenEx(&drive->file, path, writable ? O_RDWR | O_SYNC : O_RDONLY))
 	{
 		return;
 	}
@@ -657,6 +731,7 @@ void InsertFloppy(adfTYPE *drive, char* path)
 	drive->sector_offset = 0;
 	drive->track = 0;
 	drive->track_prev = -1;
+	InvalidateTrack(drive, -1);
 
 	menu_debugf("Inserting floppy: \"%s\"\n", path);
 	menu_debugf("file writable: %d\n", writable);
@@ -17,11 +17,16 @@
 #include "../../spi.h"
 #include "../../cfg.h"
 #include "../../shmem.h"
+#include "../../dircache.h"
+#include "../../share_io.h"
+#include "../../profiling.h"
 #include "miminig_fs_messages.h"
 
 #define SHMEM_ADDR      0x27FF4000
 #define SHMEM_SIZE      0x2000
 static uint8_t *shmem = 0;
+static share_async_t req_async = {};
+static int req_diskled = 0; // LED is on the FPGA bus, set from the main thread
 
 #define REQUEST_FLG     0      // 4B
 #define REQUEST_BUFFER  4      // ~512B
@@ -50,7 +55,7 @@ struct lock
 {
 	uint16_t mode;
 	std::string path;
-	std::vector<dirent64> dir_items;
+	std::vector<dircache_item_t> dir_items;
 };
 
 static std::map<uint32_t, lock> locks;
@@ -120,6 +125,24 @@ static uint32_t get_fp()
 	return fp;
 }
 
+// EXAMINE_NEXT walks a snapshot of the directory, objects deleted or renamed away
+// are blanked in it so they are not returned later in the scan.
+static void forget_dir_item(const char *path)
+{
+	const char *p = strrchr(path, '/');
+	if (!p) return;
+
+	std::string dir(path, p - path);
+	for (auto &pair : locks)
+	{
+		if ((pair.second.path.empty() ? basepath : pair.second.path) != dir) continue;
+		for (dircache_item_t &item : pair.second.dir_items)
+		{
+			if (!strcmp(item.name, p + 1)) item.name[0] = 0;
+		}
+	}
+}
+
 static char* find_path(uint32_t key, const char *name)
 {
 	dbg_print("find_path(%d, %s)\n", key, name);
@@ -244,6 +267,8 @@ static void fill_date(time_t time, int date[3])
 
 static int process_request(void *reqres_buffer)
 {
+	PROFILE_FUNCTION();
+
 	static char buf[1024];
 	GenericRequestResponse *reqres = ( GenericRequestResponse *)reqres_buffer;
 
@@ -409,6 +434,9 @@ static int process_request(void *reqres_buffer)
 
 			int disk_key = 666;
 			static char fn[256];
+			int type = 0;
+			time_t time = 0;
+			uint32_t size = 0;
 			if (rtype == ACTION_EXAMINE_OBJECT)
 			{
 				dbg_print("  examine first\n");
@@ -423,22 +451,15 @@ static int process_request(void *reqres_buffer)
 				locks[key].dir_items.clear();
 				if (PathIsDir(name, 0))
 				{
-					const char* full_path = getFullPath(name);
-					DIR *d = opendir(full_path);
-					if (!d)
+					if (!dircache_get(name, locks[key].dir_items, [](const dircache_item_t &item)
+						{
+							return strcmp(item.name, "..") && strcmp(item.name, ".");
+						}))
 					{
-						printf("Couldn't open dir: %s\n", full_path);
+						printf("Couldn't open dir: %s\n", getFullPath(name));
 						ret = ERROR_OBJECT_WRONG_TYPE;
 						break;
 					}
-
-					struct dirent64 *de;
-					while ((de = readdir64(d)))
-					{
-						if (!strcmp(de->d_name, "..") || !strcmp(de->d_name, ".")) continue;
-						locks[key].dir_items.push_back(*de);
-					}
-					closedir(d);
 				}
 			}
 			else
@@ -450,6 +471,13 @@ static int process_request(void *reqres_buffer)
 				uint32_t listed = disk_key - 666;
 				disk_key++;
 
+				// skip entries deleted or renamed since the scan started
+				while (listed < locks[key].dir_items.size() && !locks[key].dir_items[listed].name[0])
+				{
+					listed++;
+					disk_key++;
+				}
+
 				if (listed >= locks[key].dir_items.size())
 				{
 					locks[key].dir_items.clear();
@@ -457,35 +485,40 @@ static int process_request(void *reqres_buffer)
 					break;
 				}
 
+				// entry metadata comes from the directory cache, no stat per entry
+				const dircache_item_t *item = &locks[key].dir_items[listed];
 				strcat(name, "/");
-				strcat(name, locks[key].dir_items[listed].d_name);
-				memcpy(fn, locks[key].dir_items[listed].d_name, sizeof(fn));
+				strcat(name, item->name);
+				memcpy(fn, item->name, sizeof(fn));
+
+				type = S_ISDIR(item->mode) ? ST_USERDIR : ST_FILE;
+				time = item->mtime;
+				if (type == ST_FILE) size = (item->size > UINT32_MAX) ? UINT32_MAX : (uint32_t)item->size;
 				ret = 0;
 			}
 
 			dbg_print("    name: %s\n", name);
 			dbg_print("    fn: %s\n", fn);
 
-			int type = 0;
-			if (FileExists(name, 0)) type = ST_FILE;
-			else if (PathIsDir(name, 0)) type = ST_USERDIR;
-			else
+			if (rtype == ACTION_EXAMINE_OBJECT)
 			{
-				ret = ERROR_OBJECT_NOT_FOUND;
-				break;
-			}
-
-			time_t time = 0;
-			uint32_t size = 0;
+				if (FileExists(name, 0)) type = ST_FILE;
+				else if (PathIsDir(name, 0)) type = ST_USERDIR;
+				else
+				{
+					ret = ERROR_OBJECT_NOT_FOUND;
+					break;
+				}
 
-			struct stat64 *st = getPathStat(name);
-			if (st)
-			{
-				time = st->st_mtime;
-				if (type == ST_FILE)
+				struct stat64 *st = getPathStat(name);
+				if (st)
 				{
-					if (st->st_size > UINT32_MAX) size = UINT32_MAX;
-					else size = (uint32_t)st->st_size;
+					time = st->st_mtime;
+					if (type == ST_FILE)
+					{
+						if (st->st_size > UINT32_MAX) size = UINT32_MAX;
+						else size = (uint32_t)st->st_size;
+					}
 				}
 			}
 
@@ -620,9 +653,9 @@ static int process_request(void *reqres_buffer)
 				break;
 			}
 
-			DISKLED_ON;
+			req_diskled = 1;
 			uint32_t length = SWAP_INT(req->length);
-			length = FileReadAdv(&open_file_handles[key], shmem + DATA_BUFFER, length);
+			length = share_ra_read(&open_file_handles[key], shmem + DATA_BUFFER, length);
 
 			res->actual = SWAP_INT(length);
 			ret = 0;
@@ -643,8 +676,9 @@ static int process_request(void *reqres_buffer)
 				break;
 			}
 
-			DISKLED_ON;
+			req_diskled = 1;
 			uint32_t length = SWAP_INT(req->length);
+			share_ra_drop(&open_file_handles[key]);
 			length = FileWriteAdv(&open_file_handles[key], shmem + DATA_BUFFER, length);
 
 			res->actual = SWAP_INT(length);
@@ -700,6 +734,7 @@ static int process_request(void *reqres_buffer)
 
 			if (open_file_handles.find(key) != open_file_handles.end())
 			{
+				share_ra_drop(&open_file_handles[key]);
 				FileClose(&open_file_handles[key]);
 				open_file_handles.erase(key);
 			}
@@ -722,16 +757,18 @@ static int process_request(void *reqres_buffer)
 					break;
 				}
 
-				DISKLED_ON;
+				req_diskled = 1;
 				if (PathIsDir(name, 0))
 				{
 					ret = DirDelete(name) ? 0 : ERROR_DIRECTORY_NOT_EMPTY;
+					if (!ret) forget_dir_item(name);
 					break;
 				}
 
 				if (FileExists(name, 0))
 				{
 					ret = FileDelete(name) ? 0 : ERROR_OBJECT_NOT_FOUND;
+					if (!ret) forget_dir_item(name);
 					break;
 				}
 			}
@@ -763,6 +800,7 @@ static int process_request(void *reqres_buffer)
 			}
 
 			strcpy(buf, cp1);
+			std::string src = cp1;
 			key = SWAP_INT(req->target_dir);
 			char *cp2 = find_path(key, req->name + req->name_len);
 			if (!cp2[0])
@@ -787,13 +825,14 @@ static int process_request(void *reqres_buffer)
 				break;
 			}
 
-			DISKLED_ON;
+			req_diskled = 1;
 			if (rename(buf, fp2))
 			{
 				ret = ERROR_OBJECT_NOT_FOUND;
 				break;
 			}
 
+			forget_dir_item(src.c_str());
 			ret = 0;
 		}
 		break;
@@ -805,7 +844,7 @@ static int process_request(void *reqres_buffer)
 			CreateDirResponse *res = (CreateDirResponse*)reqres_buffer;
 			sz_res = sizeof(CreateDirResponse);
 
-			DISKLED_ON;
+			req_diskled = 1;
 			char *name = find_path(SWAP_INT(req->key), req->name + 1);
 			if (!FileCreatePath(name))
 			{
@@ -906,6 +945,16 @@ void minimig_share_poll()
 	else if(shmem != (uint8_t *)-1)
 	{
 		static uint32_t old_req_id = 0;
+
+		// request is processed on the offload thread, acknowledge once it's done
+		if (req_async.busy)
+		{
+			if (!share_async_done(&req_async)) return;
+			if (req_diskled) DISKLED_ON;
+			req_diskled = 0;
+			*(uint16_t*)(shmem + REQUEST_FLG + 2) = (uint16_t)old_req_id;
+		}
+
 		uint32_t req_id = *(uint32_t*)(shmem + REQUEST_FLG);
 
 		if ((uint16_t)old_req_id != (uint16_t)req_id)
@@ -914,8 +963,7 @@ void minimig_share_poll()
 			old_req_id = req_id;
 			if (((req_id>>16) & 0xFFFF) == 0x5AA5 && ((req_id - 77) & 0xFF) == ((req_id >> 8) & 0xFF))
 			{
-				process_request(shmem + REQUEST_BUFFER);
-				*(uint16_t*)(shmem + REQUEST_FLG + 2) = (uint16_t)req_id;
+				share_async_run(&req_async, [] { process_request(shmem + REQUEST_BUFFER); });
 			}
 		}
 	}
@@ -923,6 +971,10 @@ void minimig_share_poll()
 
 void minimig_share_reset()
 {
+	share_async_sync(&req_async);
+	share_ra_drop();
+	req_diskled = 0;
+
 	open_file_handles.clear();
 	locks.clear();
 	next_fp = 1;
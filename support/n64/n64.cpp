@@ -8,6 +8,9 @@
 #include "../../menu.h"
 #include "../../shmem.h"
 #include "../../lib/md5/md5.h"
+#include "../../romhash.h"
+#include "../../file_tx.h"
+#include "../../dbindex.h"
 
 #include "miniz.h"
 #include "n64.h"
@@ -698,65 +701,80 @@ static size_t cart_id_is_match(const char* line, const char* cart_id) {
 	return CARTID_LENGTH;
 }
 
-static uint8_t detect_rom_settings_in_db(const char* lookup_hash, const char* db_file_name) {
-	fileTextReader reader = {};
+struct db_match_t {
+	const char* lookup;
+	uint8_t detected;
+};
 
-	snprintf(full_path, sizeof(full_path), "%s/%s", HomeDir(), db_file_name);
+static bool md5_db_match(const char* line, void* user) {
+	auto match = (db_match_t*)user;
+	const char* lookup_hash = match->lookup;
 
-	if (!FileOpenTextReader(&reader, full_path)) {
-		printf("Failed to open N64 data file \"%s\".\n", db_file_name);
-		return 0;
+	// Index lookup only returns lines starting with our hash
+	if (!md5_matches(line, lookup_hash)) return false;
+
+	const char* s = line + (MD5_LENGTH * 2);
+	char* tags = new char[strlen(s) + 1];
+	if (sscanf(s, "%*[ \t]%[^#;]", tags) <= 0) {
+		printf("Found ROM entry for MD5 %s, but the tag was malformed! (%s)\n", lookup_hash, s);
+		match->detected = 2;
+		return true;
 	}
 
-	while (const char* line = FileReadLine(&reader)) {
-		// Skip the line if it doesn't start with our hash
-		if (!md5_matches(line, lookup_hash)) continue;
+	printf("Found ROM entry for MD5 %s: [%s]\n", lookup_hash, tags);
 
-		const char* s = line + (MD5_LENGTH * 2);
-		char* tags = new char[strlen(s) + 1];
-		if (sscanf(s, "%*[ \t]%[^#;]", tags) <= 0) {
-			printf("Found ROM entry for MD5 %s, but the tag was malformed! (%s)\n", lookup_hash, s);
-			return 2;
-		}
+	// 2 = System region and/or CIC wasn't in DB, will need further detection
+	match->detected = parse_and_apply_db_tags(tags) ? 3 : 2;
+	return true;
+}
+
+static bool cartid_db_match(const char* line, void* user) {
+	auto match = (db_match_t*)user;
+	const char* cart_id = match->lookup;
 
-		printf("Found ROM entry for MD5 %s: [%s]\n", lookup_hash, tags);
+	// Skip lines that doesn't start with our ID
+	size_t i;
+	if (!(i = cart_id_is_match(line, cart_id))) return false;
 
-		// 2 = System region and/or CIC wasn't in DB, will need further detection
-		return parse_and_apply_db_tags(tags) ? 3 : 2;
+	auto s = line + strlen(CARTID_PREFIX) + i;
+	auto tags = new char[strlen(s) + 1];
+	if (sscanf(s, "%*[ \t]%[^#;]", tags) <= 0) {
+		printf("Found ROM entry for ID [%s], but the tag was malformed! \"%s\".\n", cart_id, s);
+		match->detected = 2;
+		return true;
 	}
 
-	return 0;
+	printf("Found ROM entry for ID [%s]: \"%s\".\n", cart_id, tags);
+
+	// 2 = System region and/or CIC wasn't in DB, will need further detection
+	match->detected = parse_and_apply_db_tags(tags) ? 3 : 2;
+	return true;
 }
 
-static uint8_t detect_rom_settings_in_db_with_cartid(const char* cart_id, const char* db_file_name) {
-	fileTextReader reader = {};
+static uint8_t detect_rom_settings_in_db(const char* lookup_hash, const char* db_file_name) {
+	db_match_t match = { lookup_hash, 0 };
 
 	snprintf(full_path, sizeof(full_path), "%s/%s", HomeDir(), db_file_name);
 
-	if (!FileOpenTextReader(&reader, full_path)) {
+	if (dbindex_find(full_path, DBI_N64, DBK_MD5, lookup_hash, md5_db_match, &match) < 0) {
 		printf("Failed to open N64 data file \"%s\".\n", db_file_name);
 		return 0;
 	}
 
-	while (const char* line = FileReadLine(&reader)) {
-		// Skip lines that doesn't start with our ID
-		size_t i;
-		if (!(i = cart_id_is_match(line, cart_id))) continue;
+	return match.detected;
+}
 
-		auto s = line + strlen(CARTID_PREFIX) + i;
-		auto tags = new char[strlen(s) + 1];
-		if (sscanf(s, "%*[ \t]%[^#;]", tags) <= 0) {
-			printf("Found ROM entry for ID [%s], but the tag was malformed! \"%s\".\n", cart_id, s);
-			return 2;
-		}
+static uint8_t detect_rom_settings_in_db_with_cartid(const char* cart_id, const char* db_file_name) {
+	db_match_t match = { cart_id, 0 };
 
-		printf("Found ROM entry for ID [%s]: \"%s\".\n", cart_id, tags);
+	snprintf(full_path, sizeof(full_path), "%s/%s", HomeDir(), db_file_name);
 
-		// 2 = System region and/or CIC wasn't in DB, will need further detection
-		return parse_and_apply_db_tags(tags) ? 3 : 2;
+	if (dbindex_find(full_path, DBI_N64, DBK_CARTID, cart_id, cartid_db_match, &match) < 0) {
+		printf("Failed to open N64 data file \"%s\".\n", db_file_name);
+		return 0;
 	}
 
-	return 0;
+	return match.detected;
 }
 
 static const char* DB_FILE_NAMES[] = {
@@ -1574,7 +1592,6 @@ int n64_rom_tx(const char* name, const unsigned char idx, const uint32_t load_ad
 	char md5_hex[MD5_LENGTH * 2 + 1];
 	uint64_t bootcode_sums[2] = { };
 	uint8_t controller_settings[4] = { };
-	bool is_first_chunk = true;
 	char cart_id[CARTID_LENGTH + 1] = { };
 	char internal_name[20 + 1];
 
@@ -1583,47 +1600,42 @@ int n64_rom_tx(const char* name, const unsigned char idx, const uint32_t load_ad
 	// CRC32 is used for cheat look-up
 	file_crc = 0;
 
+	if (data_size < 4096) {
+		FileClose(&f);
+		*current_rom_path = '\0';
+		printf("Failed to load ROM: must be at least 4096 bytes.\n");
+		return 0;
+	}
+
 	void* mem = load_addr ? (uint8_t*)shmem_map(fpga_mem(load_addr), data_size) : nullptr;
-	uint8_t* write_ptr = (uint8_t*)mem;
 
-	MD5Context ctx;
-	MD5Init(&ctx);
+	// Full file MD5 and CRC32 are computed on the offload thread, or skipped if already cached.
+	// Cheat files from gamehacking.org use byte swapped CRC32 for some reason...
+	const int hash_flags = HASH_MD5 | HASH_CRC32 | HASH_CRC_SWAP16;
+	romhash_t rom_hash;
+	const bool hash_cached = romhash_cache_get(name, hash_flags, 0, data_size, &rom_hash);
+	if (!hash_cached) romhash_begin(hash_flags);
 
 	// prepare transmission of new file
 	user_io_set_download(1, load_addr ? data_size : 0);
 	ProgressMessage();
 
-	while (data_left) {
-		size_t chunk = (data_left > sizeof(buf)) ? sizeof(buf) : data_left;
-
-		FileReadAdv(&f, buf, chunk);
-
-		// Perform sanity checks and detect ROM endianness
-		if (is_first_chunk) {
-			if (chunk < 4096) {
-				// Signal end of transmission
-				user_io_set_download(0);
-				*current_rom_path = '\0';
-				printf("Failed to load ROM: must be at least 4096 bytes.\n");
-
-				return 0;
-			}
-
+	// Endianness, hashing and header detection all run on the cached chunk
+	// right before it's copied to DDR (or sent over SPI).
+	auto process_chunk = [&](uint8_t *buf, uint32_t pos, uint32_t chunk) {
+		if (!pos) {
 			rom_endianness = detect_rom_endianness(buf);
 		}
 
 		// Normalize data to big-endian format, if needed
 		normalize_data(buf, chunk, rom_endianness);
-		MD5Update(&ctx, buf, chunk);
-
-		if (is_first_chunk) {
-			/* Try to detect ROM settings based on header MD5 hash.
-			   For calculating the MD5 hash of the header, we need to make a
-			   copy of the context before calling MD5Final, otherwise the file
-			   hash will be incorrect later on. */
+		if (!hash_cached) romhash_update(buf, chunk);
 
+		if (!pos) {
+			// Try to detect ROM settings based on header MD5 hash.
 			MD5Context ctx_header;
-			memcpy(&ctx_header, &ctx, sizeof(struct MD5Context));
+			MD5Init(&ctx_header);
+			MD5Update(&ctx_header, buf, 4096);
 			MD5Final(md5, &ctx_header);
 			md5_to_hex(md5, md5_hex);
 			printf("Header MD5 hash: %s\n", md5_hex);
@@ -1661,27 +1673,35 @@ int n64_rom_tx(const char* name, const unsigned char idx, const uint32_t load_ad
 				memset(cart_id, '\0', CARTID_LENGTH);
 			}
 		}
+	};
 
+	uint32_t sent;
+	if (mem) {
 		// Copy to DDR memory for fast ROM loading
-		if (mem) {
-			memcpy(write_ptr, buf, chunk);
-			write_ptr += chunk;
-		}
-		else {
-			// Fallback to normal (slow) loading
-			user_io_file_tx_data(buf, chunk);
-		}
+		sent = file_tx_ddr(&f, (uint8_t*)mem, data_size, process_chunk, 1);
+	}
+	else {
+		// Fallback to normal (slow) loading
+		sent = file_tx_send(&f, data_size, process_chunk, 1);
+	}
 
-		ProgressMessage("Loading", f.name, data_size - data_left, data_size);
-		data_left -= chunk;
-		is_first_chunk = false;
+	if (!hash_cached) romhash_end(&rom_hash);
 
-		// CRC32 is used for cheat look-up. Cheat files from gamehacking.org use byte swapped CRC32 for some reason...
-		normalize_data(buf, chunk, ByteOrder::BYTE_SWAPPED);
-		file_crc = crc32(file_crc, buf, chunk);
+	// short read: the hash is of truncated data and must not be cached
+	if (sent != data_size) {
+		if (mem) shmem_unmap(mem, data_size);
+		FileClose(&f);
+		*current_rom_path = '\0';
+		user_io_set_download(0);
+		ProgressMessage();
+		printf("Failed to load ROM: read %u of %u bytes.\n", sent, data_size);
+		return 0;
 	}
 
-	MD5Final(md5, &ctx);
+	if (!hash_cached) romhash_cache_put(name, hash_flags, 0, data_size, &rom_hash);
+
+	file_crc = rom_hash.crc;
+	memcpy(md5, rom_hash.md5, MD5_LENGTH);
 	md5_to_hex(md5, md5_hex);
 	printf("File MD5: %s\n", md5_hex);
 
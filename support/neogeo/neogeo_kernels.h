@@ -0,0 +1,179 @@
+#ifndef NEOGEO_KERNELS_H
+#define NEOGEO_KERNELS_H
+
+// Graphics ROM conversions used while loading. NEON versions handle whole blocks,
+// the scalar index formulas handle the tail and non-NEON builds.
+// tests/neogeo_kernels_test.cpp checks them against the plain formulas, the NEON
+// versions only when built with make test_arm.
+
+#include <inttypes.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+static inline void spr_convert(uint16_t* buf_in, uint16_t* buf_out, uint32_t size)
+{
+	/*
+	In C ROMs, a word provides two bitplanes for an 8-pixel wide line
+	They're used in pairs to provide 32 bits at once (all four bitplanes)
+	For one sprite tile, bytes are used like this: ([...] represents one 8-pixel wide line)
+	Even ROM					Odd ROM
+	[  40 41  ][  00 01  ]		[  42 43  ][  02 03  ]
+	[  44 45  ][  04 05  ]  	[  46 47  ][  06 07  ]
+	[  48 49  ][  08 09  ]  	[  4A 4B  ][  0A 0B  ]
+	[  4C 4D  ][  0C 0D  ]  	[  4E 4F  ][  0E 0F  ]
+	[  50 51  ][  10 11  ]  	[  52 53  ][  12 13  ]
+	...							...
+	The data read for a given tile line (16 pixels) is always the same, only the rendering order of the pixels can change
+	To take advantage of the SDRAM burst read feature, the data can be loaded so that all 16 pixels of a tile
+	line can be read sequentially: () are 16-bit words, [] is the 4-word burst read
+	[(40 41) (00 01) (42 43) (02 03)]
+	[(44 45) (04 05) (46 47) (06 07)]...
+	Word interleaving is done on the FPGA side to mix the two C ROMs data (even/odd)
+
+	In:  FEDCBA9876 54321 0
+	Out: FEDCBA9876 15432 0
+	*/
+
+	uint32_t i = 0;
+
+#ifdef __ARM_NEON
+	// Each 32 word block is an interleave of its upper and lower halves.
+	for (; i + 32 <= size; i += 32)
+	{
+		uint16x8x2_t w;
+		w.val[0] = vld1q_u16(buf_in + i + 16);
+		w.val[1] = vld1q_u16(buf_in + i);
+		vst2q_u16(buf_out + i, w);
+
+		w.val[0] = vld1q_u16(buf_in + i + 24);
+		w.val[1] = vld1q_u16(buf_in + i + 8);
+		vst2q_u16(buf_out + i + 16, w);
+	}
+#endif
+
+	for (; i < size; i++) buf_out[i] = buf_in[(i & ~0x1F) | ((i >> 1) & 0xF) | (((i & 1) ^ 1) << 4)];
+
+	/*
+	0 <- 20
+	1 <- 21
+	2 <- 00
+	3 <- 01
+	4 <- 22
+	5 <- 23
+	6 <- 02
+	7 <- 03
+	...
+
+	00 -> 02
+	01 -> 03
+	02 -> 06
+	03 -> 07
+	...
+	*/
+}
+
+// Strided store of an already converted buffer. Both C ROMs of a pair share the same
+// memory window, so only every second word belongs to the current file.
+static inline void spr_copy_skp(const uint16_t* buf_in, uint16_t* buf_out, uint32_t size)
+{
+	for (uint32_t i = 0; i < size; i++) buf_out[i << 1] = buf_in[i];
+}
+
+static inline void spr_convert_dbl(uint16_t* buf_in, uint16_t* buf_out, uint32_t size)
+{
+	uint32_t i = 0;
+
+#ifdef __ARM_NEON
+	// Per 64 word block: out32[2k] = swap16(in32[16+k]), out32[2k+1] = swap16(in32[k])
+	for (; i + 64 <= size; i += 64)
+	{
+		const uint32_t *in32 = (const uint32_t*)(buf_in + i);
+		uint32_t *out32 = (uint32_t*)(buf_out + i);
+
+		for (int k = 0; k < 16; k += 4)
+		{
+			uint32x4x2_t w;
+			w.val[0] = vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(vld1q_u32(in32 + 16 + k))));
+			w.val[1] = vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(vld1q_u32(in32 + k))));
+			vst2q_u32(out32 + k * 2, w);
+		}
+	}
+#endif
+
+	for (; i < size; i++) buf_out[i] = buf_in[(i & ~0x3F) | ((i ^ 1) & 1) | ((i >> 1) & 0x1E) | (((i & 2) ^ 2) << 4)];
+}
+
+static inline void fix_convert(uint8_t* buf_in, uint8_t* buf_out, uint32_t size)
+{
+	/*
+	In S ROMs, a byte provides two pixels
+	For one fix tile, bytes are used like this: ([...] represents a pair of pixels)
+	[10][18][00][08]
+	[11][19][01][09]
+	[12][1A][02][0A]
+	[13][1B][03][0B]
+	[14][1C][04][0C]
+	[15][1D][05][0D]
+	[16][1E][06][0E]
+	[17][1F][07][0F]
+	The data read for a given tile line (8 pixels) is always the same
+	To take advantage of the SDRAM burst read feature, the data can be loaded so that all 8 pixels of a tile
+	line can be read sequentially: () are 16-bit words, [] is the 2-word burst read
+	[(10 18) (00 08)]
+	[(11 19) (01 09)]...
+
+	In:  FEDCBA9876543210
+	Out: FEDCBA9876510432
+	*/
+	uint32_t i = 0;
+
+#ifdef __ARM_NEON
+	static const uint8_t fix_tbl[32] = {
+		16, 24, 0, 8, 17, 25, 1, 9, 18, 26, 2, 10, 19, 27, 3, 11,
+		20, 28, 4, 12, 21, 29, 5, 13, 22, 30, 6, 14, 23, 31, 7, 15
+	};
+
+	const uint8x8_t t0 = vld1_u8(fix_tbl);
+	const uint8x8_t t1 = vld1_u8(fix_tbl + 8);
+	const uint8x8_t t2 = vld1_u8(fix_tbl + 16);
+	const uint8x8_t t3 = vld1_u8(fix_tbl + 24);
+
+	for (; i + 32 <= size; i += 32)
+	{
+		uint8x8x4_t tile;
+		tile.val[0] = vld1_u8(buf_in + i);
+		tile.val[1] = vld1_u8(buf_in + i + 8);
+		tile.val[2] = vld1_u8(buf_in + i + 16);
+		tile.val[3] = vld1_u8(buf_in + i + 24);
+
+		vst1_u8(buf_out + i, vtbl4_u8(tile, t0));
+		vst1_u8(buf_out + i + 8, vtbl4_u8(tile, t1));
+		vst1_u8(buf_out + i + 16, vtbl4_u8(tile, t2));
+		vst1_u8(buf_out + i + 24, vtbl4_u8(tile, t3));
+	}
+#endif
+
+	for (; i < size; i++) buf_out[i] = buf_in[(i & ~0x1F) | ((i >> 2) & 7) | ((i & 1) << 3) | (((i & 2) << 3) ^ 0x10)];
+}
+
+static inline void spr_bswap(uint32_t* buf, uint32_t size)
+{
+	uint32_t i = 0;
+
+#ifdef __ARM_NEON
+	static const uint8_t bswap_tbl[8] = { 0, 2, 1, 3, 4, 6, 5, 7 };
+	const uint8x8_t t = vld1_u8(bswap_tbl);
+
+	for (; i + 4 <= size; i += 4)
+	{
+		uint8_t *p = (uint8_t*)(buf + i);
+		vst1_u8(p, vtbl1_u8(vld1_u8(p), t));
+		vst1_u8(p + 8, vtbl1_u8(vld1_u8(p + 8), t));
+	}
+#endif
+
+	for (; i < size; i++) buf[i] = (buf[i] & 0xFF0000FF) | ((buf[i] & 0xFF00) << 8) | ((buf[i] & 0xFF0000) >> 8);
+}
+
+#endif
@@ -5,14 +5,17 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <time.h>   // clock_gettime, CLOCK_REALTIME
+#include <semaphore.h>
 #include "neogeo_loader.h"
 #include "neogeocd.h"
+#include "neogeo_kernels.h"
 #include "../../sxmlc.h"
 #include "../../user_io.h"
 #include "../../fpga_io.h"
 #include "../../osd.h"
 #include "../../menu.h"
 #include "../../shmem.h"
+#include "../../offload.h"
 
 struct NeoFile
 {
@@ -28,86 +31,6 @@ struct NeoFile
 	uint8_t Filler2[4096 - 512];	//fill to 4096
 };
 
-static inline void spr_convert(uint16_t* buf_in, uint16_t* buf_out, uint32_t size)
-{
-	/*
-	In C ROMs, a word provides two bitplanes for an 8-pixel wide line
-	They're used in pairs to provide 32 bits at once (all four bitplanes)
-	For one sprite tile, bytes are used like this: ([...] represents one 8-pixel wide line)
-	Even ROM					Odd ROM
-	[  40 41  ][  00 01  ]		[  42 43  ][  02 03  ]
-	[  44 45  ][  04 05  ]  	[  46 47  ][  06 07  ]
-	[  48 49  ][  08 09  ]  	[  4A 4B  ][  0A 0B  ]
-	[  4C 4D  ][  0C 0D  ]  	[  4E 4F  ][  0E 0F  ]
-	[  50 51  ][  10 11  ]  	[  52 53  ][  12 13  ]
-	...							...
-	The data read for a given tile line (16 pixels) is always the same, only the rendering order of the pixels can change
-	To take advantage of the SDRAM burst read feature, the data can be loaded so that all 16 pixels of a tile
-	line can be read sequentially: () are 16-bit words, [] is the 4-word burst read
-	[(40 41) (00 01) (42 43) (02 03)]
-	[(44 45) (04 05) (46 47) (06 07)]...
-	Word interleaving is done on the FPGA side to mix the two C ROMs data (even/odd)
-
-	In:  FEDCBA9876 54321 0
-	Out: FEDCBA9876 15432 0
-	*/
-
-	for (uint32_t i = 0; i < size; i++) buf_out[i] = buf_in[(i & ~0x1F) | ((i >> 1) & 0xF) | (((i & 1) ^ 1) << 4)];
-
-	/*
-	0 <- 20
-	1 <- 21
-	2 <- 00
-	3 <- 01
-	4 <- 22
-	5 <- 23
-	6 <- 02
-	7 <- 03
-	...
-
-	00 -> 02
-	01 -> 03
-	02 -> 06
-	03 -> 07
-	...
-	*/
-}
-
-static inline void spr_convert_skp(uint16_t* buf_in, uint16_t* buf_out, uint32_t size)
-{
-	for (uint32_t i = 0; i < size; i++) buf_out[i << 1] = buf_in[(i & ~0x1F) | ((i >> 1) & 0xF) | (((i & 1) ^ 1) << 4)];
-}
-
-static inline void spr_convert_dbl(uint16_t* buf_in, uint16_t* buf_out, uint32_t size)
-{
-	for (uint32_t i = 0; i < size; i++) buf_out[i] = buf_in[(i & ~0x3F) | ((i ^ 1) & 1) | ((i >> 1) & 0x1E) | (((i & 2) ^ 2) << 4)];
-}
-
-static void fix_convert(uint8_t* buf_in, uint8_t* buf_out, uint32_t size)
-{
-	/*
-	In S ROMs, a byte provides two pixels
-	For one fix tile, bytes are used like this: ([...] represents a pair of pixels)
-	[10][18][00][08]
-	[11][19][01][09]
-	[12][1A][02][0A]
-	[13][1B][03][0B]
-	[14][1C][04][0C]
-	[15][1D][05][0D]
-	[16][1E][06][0E]
-	[17][1F][07][0F]
-	The data read for a given tile line (8 pixels) is always the same
-	To take advantage of the SDRAM burst read feature, the data can be loaded so that all 8 pixels of a tile
-	line can be read sequentially: () are 16-bit words, [] is the 2-word burst read
-	[(10 18) (00 08)]
-	[(11 19) (01 09)]...
-
-	In:  FEDCBA9876543210
-	Out: FEDCBA9876510432
-	*/
-	for (uint32_t i = 0; i < size; i++) buf_out[i] = buf_in[(i & ~0x1F) | ((i >> 2) & 7) | ((i & 1) << 3) | (((i & 2) << 3) ^ 0x10)];
-}
-
 static const char *get_name(const char *path, const char *name)
 {
 	static char buf[1024];
@@ -213,6 +136,65 @@ static void make_path(const char *root, const char *name, char *path)
 	strcat(path, name);
 }
 
+/*
+	ROM loading is pipelined over both cores:
+	 - the offload thread (core #0) reads the next chunk from storage into one of two read buffers,
+	 - the main thread converts the current chunk into loadbuf (cached) and burst-copies it into the
+	   mapped FPGA memory window.
+	Reads are queued to the offload thread in order, so the file position stays sequential.
+*/
+
+struct load_pipe_t
+{
+	fileTYPE *f;
+	uint8_t *buf[2];
+	uint32_t len[2];
+	sem_t done[2];
+};
+
+static int pipe_open(load_pipe_t *p, fileTYPE *f)
+{
+	p->f = f;
+	p->buf[0] = (uint8_t*)malloc(LOADBUF_SZ);
+	p->buf[1] = (uint8_t*)malloc(LOADBUF_SZ);
+	if (!p->buf[0] || !p->buf[1])
+	{
+		printf("pipe_open: cannot allocate read buffers!\n");
+		free(p->buf[0]);
+		free(p->buf[1]);
+		return 0;
+	}
+
+	sem_init(&p->done[0], 0, 0);
+	sem_init(&p->done[1], 0, 0);
+	return 1;
+}
+
+static void pipe_close(load_pipe_t *p)
+{
+	sem_destroy(&p->done[0]);
+	sem_destroy(&p->done[1]);
+	free(p->buf[0]);
+	free(p->buf[1]);
+}
+
+static void pipe_read(load_pipe_t *p, int slot, uint32_t len)
+{
+	offload_add_work([p, slot, len]
+	{
+		int res = len ? FileReadAdv(p->f, p->buf[slot], len, -1) : 0;
+		p->len[slot] = (res < 0) ? 0 : res;
+		sem_post(&p->done[slot]);
+	});
+}
+
+static uint8_t *pipe_wait(load_pipe_t *p, int slot, uint32_t *len = 0)
+{
+	sem_wait(&p->done[slot]);
+	if (len) *len = p->len[slot];
+	return p->buf[slot];
+}
+
 extern uint8_t loadbuf[];
 static uint32_t load_crom_to_mem(const char* path, const char* name, uint8_t index, uint32_t offset, uint32_t size)
 {
@@ -230,6 +212,13 @@ static uint32_t load_crom_to_mem(const char* path, const char* name, uint8_t ind
 
 	size *= 2;
 
+	load_pipe_t pipe;
+	if (!pipe_open(&pipe, &f))
+	{
+		FileClose(&f);
+		return 0;
+	}
+
 	FileSeek(&f, offset, SEEK_SET);
 	printf("CROM %s (offset %u, size %u) with index %u\n", name, offset, size, index);
 	const char *dispname = get_name(path, name);
@@ -238,6 +227,10 @@ static uint32_t load_crom_to_mem(const char* path, const char* name, uint8_t ind
 
 	uint32_t remain = size;
 	uint32_t map_addr = 0x38000000 + (((index - 64) >> 1) * 1024 * 1024);
+	int slot = 0;
+	int ok = 1;
+
+	pipe_read(&pipe, slot, ((remain > LOADBUF_SZ) ? LOADBUF_SZ : remain) / 2);
 
 	ProgressMessage();
 	while (remain)
@@ -245,33 +238,39 @@ static uint32_t load_crom_to_mem(const char* path, const char* name, uint8_t ind
 		uint32_t partsz = remain;
 		if (partsz > LOADBUF_SZ) partsz = LOADBUF_SZ;
 
+		uint32_t next = remain - partsz;
+		if (next) pipe_read(&pipe, slot ^ 1, ((next > LOADBUF_SZ) ? LOADBUF_SZ : next) / 2);
+
+		// a short or failed read must not upload the previous chunk again
+		uint32_t len;
+		uint8_t *buf = pipe_wait(&pipe, slot, &len);
+		if (len < partsz / 2) memset(buf + len, 0, partsz / 2 - len);
+
 		//printf("partsz=%d, map_addr=0x%X\n", partsz, map_addr);
-		void *base = shmem_map(map_addr, partsz);
+		void *base = ok ? shmem_map(map_addr, partsz) : 0;
 		if (!base)
 		{
-			FileClose(&f);
-			return 0;
+			// keep draining queued reads before the buffers are released
+			ok = 0;
+		}
+		else
+		{
+			spr_convert((uint16_t*)buf, (uint16_t*)loadbuf, partsz / 4);
+			spr_copy_skp((uint16_t*)loadbuf, ((uint16_t*)base) + ((index ^ 1) & 1), partsz / 4);
+			shmem_unmap(base, partsz);
+			ProgressMessage("Loading", dispname, size - (remain - partsz), size);
 		}
 
-		FileReadAdv(&f, loadbuf, partsz/2);
-		spr_convert_skp((uint16_t*)loadbuf, ((uint16_t*)base) + ((index ^ 1) & 1), partsz / 4);
-
-		ProgressMessage("Loading", dispname, size - (remain - partsz), size);
-
-		shmem_unmap(base, partsz);
 		remain -= partsz;
 		map_addr += partsz;
+		slot ^= 1;
 	}
 
+	pipe_close(&pipe);
 	FileClose(&f);
 	ProgressMessage();
 
-	return map_addr - 0x38000000;
-}
-
-static inline void spr_bswap(uint32_t* buf, uint32_t size)
-{
-	for (uint32_t i = 0; i < size; i++) buf[i] = (buf[i] & 0xFF0000FF) | ((buf[i] & 0xFF00) << 8) | ((buf[i] & 0xFF0000) >> 8);
+	return ok ? map_addr - 0x38000000 : 0;
 }
 
 static uint32_t load_rom_to_mem(const char* path, const char* name, uint8_t neo_file_type, uint8_t index, uint32_t offset, uint32_t size, uint32_t expand, int swap, uint32_t addr)
@@ -288,6 +287,13 @@ static uint32_t load_rom_to_mem(const char* path, const char* name, uint8_t neo_
 		return 0;
 	}
 
+	load_pipe_t pipe;
+	if (!pipe_open(&pipe, &f))
+	{
+		FileClose(&f);
+		return 0;
+	}
+
 	FileSeek(&f, offset, SEEK_SET);
 	printf("ROM %s (offset %u, size %u, exp %u, type %u, addr %u) with index %u\n", name, offset, size, expand, neo_file_type, addr, index);
 	const char *dispname = get_name(path, name);
@@ -298,6 +304,11 @@ static uint32_t load_rom_to_mem(const char* path, const char* name, uint8_t neo_
 	uint32_t remain = size;
 
 	uint32_t map_addr = 0x30000000 + (addr ? (addr + 0x8000000) : ((index >= 16) && (index < 64)) ? (index - 16) * 0x80000 : (index == 9) ? 0x2000000 : 0x8000000);
+	uint8_t fill = ((index >= 16) && (index < 64)) ? 8 : 0;
+	int slot = 0;
+	int ok = 1;
+
+	pipe_read(&pipe, slot, (remainf > LOADBUF_SZ) ? LOADBUF_SZ : remainf);
 
 	ProgressMessage();
 	while (remain)
@@ -308,44 +319,54 @@ static uint32_t load_rom_to_mem(const char* path, const char* name, uint8_t neo_
 		uint32_t partszf = remainf;
 		if (partszf > LOADBUF_SZ) partszf = LOADBUF_SZ;
 
+		if (remain > partsz) pipe_read(&pipe, slot ^ 1, partszf);
+
+		// short read at the end of file is padded below
+		uint8_t *buf = pipe_wait(&pipe, slot, &partszf);
+		if (partszf > partsz) partszf = partsz;
+
 		//printf("partsz=%d, map_addr=0x%X\n", partsz, map_addr);
-		void *base = shmem_map(map_addr, partsz);
+		void *base = ok ? shmem_map(map_addr, partsz) : 0;
 		if (!base)
 		{
-			FileClose(&f);
-			return 0;
-		}
-
-		if (neo_file_type == NEO_FILE_FIX)
-		{
-			memset(loadbuf, 0, partsz);
-			if (partszf) FileReadAdv(&f, loadbuf, partszf);
-			fix_convert(loadbuf, (uint8_t*)base, partsz);
-		}
-		else if (neo_file_type == NEO_FILE_SPR)
-		{
-			memset(loadbuf, 0, partsz);
-			if (partszf) FileReadAdv(&f, loadbuf, partszf);
-			if (swap) spr_bswap((uint32_t*)loadbuf, partsz / 4);
-			spr_convert_dbl((uint16_t*)loadbuf, (uint16_t*)base, partsz / 2);
+			// keep draining queued reads before the buffers are released
+			ok = 0;
 		}
 		else
 		{
-			memset(base, ((index>=16) && (index<64)) ? 8 : 0, partsz);
-			if (partszf) FileReadAdv(&f, base, partszf);
-		}
+			if (neo_file_type == NEO_FILE_FIX)
+			{
+				memset(buf + partszf, 0, partsz - partszf);
+				fix_convert(buf, loadbuf, partsz);
+				memcpy(base, loadbuf, partsz);
+			}
+			else if (neo_file_type == NEO_FILE_SPR)
+			{
+				memset(buf + partszf, 0, partsz - partszf);
+				if (swap) spr_bswap((uint32_t*)buf, partsz / 4);
+				spr_convert_dbl((uint16_t*)buf, (uint16_t*)loadbuf, partsz / 2);
+				memcpy(base, loadbuf, partsz);
+			}
+			else
+			{
+				memcpy(base, buf, partszf);
+				memset((uint8_t*)base + partszf, fill, partsz - partszf);
+			}
 
-		ProgressMessage("Loading", dispname, size - (remain - partsz), size);
+			shmem_unmap(base, partsz);
+			ProgressMessage("Loading", dispname, size - (remain - partsz), size);
+		}
 
-		shmem_unmap(base, partsz);
 		remain -= partsz;
 		map_addr += partsz;
+		slot ^= 1;
 	}
 
+	pipe_close(&pipe);
 	FileClose(&f);
 	ProgressMessage();
 
-	return size;
+	return ok ? size : 0;
 }
 
 static uint32_t crom_sz_max = 0;
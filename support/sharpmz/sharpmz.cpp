@@ -41,6 +41,7 @@
 #include "../../menu.h"
 #include "../../debug.h"
 #include "../../user_io.h"
+#include "../tape/tape.h"
 
 // Names of the supported machines.
 //
@@ -2005,6 +2006,12 @@ short sharpmz_read_tape_header(const char *tapeFile)
     return(0);
 }
 
+// Writes a block of tape data into the open transmission session.
+static void sharpmz_tape_send(const uint8_t *buf, uint32_t len)
+{
+    spi_write(buf, len, 0);
+}
+
 // Method to load a tape (MZF) file directly into RAM.
 // This involves reading the tape header, extracting the size and destination and loading
 // the header and program into emulator ram.
@@ -2027,18 +2034,34 @@ short sharpmz_load_tape_to_ram(const char *tapeFile, unsigned char dstCMT)
     //
     if (!FileOpen(&file, tapeFile)) return(1);
 
+    // Read the whole tape image into memory, it is sent from there in large blocks.
+    //
+    tape_image_t tape;
+    DISKLED_ON;
+    int loaded = tape_load(&file, &tape);
+    DISKLED_OFF;
+    FileClose(&file);
+    if(!loaded) return(1);
+
     // Read in the tape header, this indicates crucial data such as data type, size, exec address, load address etc.
     //
-    actualReadSize = sharpmz_file_read(&file, &tapeHeader, 128);
+    actualReadSize = tape.size < 128 ? tape.size : 128;
     if(actualReadSize != 128)
     {
         sharpmz_debugf("Only read:%d bytes of header, aborting.\n", actualReadSize);
+        tape_free(&tape);
         return(2);
     }
+    memcpy(&tapeHeader, tape.data, 128);
 
     // Some sanity checks.
     //
-    if(tapeHeader.dataType == 0 || tapeHeader.dataType > 5) return(4);
+    if(tapeHeader.dataType == 0 || tapeHeader.dataType > 5 || tape.size - 128 < tapeHeader.fileSize)
+    {
+        sharpmz_debugf("Bad tape or corruption, size:%d, sizeHeader:%d", tape.size - 128, tapeHeader.fileSize);
+        tape_free(&tape);
+        return(4);
+    }
   #if defined __SHARPMZ_DEBUG__
     for(int i=0; i < 17; i++)
     {
@@ -2078,7 +2101,10 @@ short sharpmz_load_tape_to_ram(const char *tapeFile, unsigned char dstCMT)
     // Check the data type, only load machine code directly to RAM.
     //
     if(dstCMT == 0 && tapeHeader.dataType != SHARPMZ_CMT_MC)
+    {
+        tape_free(&tape);
         return(3);
+    }
 
     // Reset Emulator if loading direct to RAM. This clears out memory, resets monitor and places it in a known state.
     //
@@ -2102,24 +2128,8 @@ short sharpmz_load_tape_to_ram(const char *tapeFile, unsigned char dstCMT)
         spi8(0x00);
     }
 
-    for (unsigned short i = 0; i < tapeHeader.fileSize && actualReadSize > 0; i += actualReadSize)
-    {
-        DISKLED_ON;
-        actualReadSize = sharpmz_file_read(&file, sector_buffer, 512);
-        DISKLED_OFF;
-
-        sharpmz_debugf("Bytes to read, actual:%d, index:%d, sizeHeader:%d", actualReadSize, i, tapeHeader.fileSize);
-
-        if(actualReadSize > 0)
-        {
-            // Write the sector (or part) to the fpga memory.
-            spi_write(sector_buffer, actualReadSize, 0);
-        } else
-        {
-            sharpmz_debugf("Bad tape or corruption, should never be 0, actual:%d, index:%d, sizeHeader:%d", actualReadSize, i, tapeHeader.fileSize);
-            return(4);
-        }
-    }
+    tape_stream(tapeHeader.fileSize, 0, tape.data + 128, sharpmz_tape_send, 0);
+    tape_free(&tape);
     DisableFpga();
 
     // signal end of transmission
@@ -2164,9 +2174,6 @@ short sharpmz_load_tape_to_ram(const char *tapeFile, unsigned char dstCMT)
     }
 #endif
 
-    // Tidy up.
-    FileClose(&file);
-
 #ifdef __SHARPMZ_DEBUG_EXTRA__
     // Dump out the memory if needed (generally for debug purposes).
     if(dstCMT == 0)                                       // Load to emulators RAM
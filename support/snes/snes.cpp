@@ -351,34 +351,47 @@ uint8_t* snes_get_header(fileTYPE *f)
 	return hdr;
 }
 
-void snes_patch_bs_header(fileTYPE *f, uint8_t *buf)
+static void patch_bs_header(uint8_t *buf, uint32_t base, uint32_t rom_size)
 {
-	if ((f->offset == 0x008000 && (buf[0xFD8] == 0x20 || buf[0xFD8] == 0x30)) ||
-		(f->offset == 0x010000 && (buf[0xFD8] == 0x21 || buf[0xFD8] == 0x31)))
+	if (buf[0xFD0] == 0xF0 || (buf[0xFD1] == 0xFF && buf[0xFD2] == 0xFF && buf[0xFD3] == 0xFF))
 	{
-		if (buf[0xFD0] == 0xF0 || (buf[0xFD1] == 0xFF && buf[0xFD2] == 0xFF && buf[0xFD3] == 0xFF))
-		{
-			printf("SNES: Patch bad BS header: offset %04X, bad value %02X %02X %02X %02X\n", 0x7FD0 | (f->offset == 0x008000 ? 0x0000 : 0x8000), buf[0xFD0], buf[0xFD1], buf[0xFD2], buf[0xFD3]);
-			buf[0xFD3] = 0x00;
-			buf[0xFD2] = 0x00;
-			buf[0xFD1] = 0x00;
-			buf[0xFD0] = f->size <= 256 * 1024 ? 0x03 :
-						 f->size <= 512 * 1024 ? 0x0F :
-						 0xFF;
-		}
+		printf("SNES: Patch bad BS header: offset %04X, bad value %02X %02X %02X %02X\n", base | 0xFD0, buf[0xFD0], buf[0xFD1], buf[0xFD2], buf[0xFD3]);
+		buf[0xFD3] = 0x00;
+		buf[0xFD2] = 0x00;
+		buf[0xFD1] = 0x00;
+		buf[0xFD0] = rom_size <= 256 * 1024 ? 0x03 :
+					 rom_size <= 512 * 1024 ? 0x0F :
+					 0xFF;
+	}
 
-		if (buf[0xFD5] >= 0x80)
-		{
-			printf("SNES: Patch bad BS header: offset %04X, bad value %02X %02X\n", 0x7FD4 | (f->offset == 0x008000 ? 0x0000 : 0x8000), buf[0xFD4], buf[0xFD5]);
-			buf[0xFD5] = 0xFF;
-			buf[0xFD4] = 0xFF;
-		}
+	if (buf[0xFD5] >= 0x80)
+	{
+		printf("SNES: Patch bad BS header: offset %04X, bad value %02X %02X\n", base | 0xFD4, buf[0xFD4], buf[0xFD5]);
+		buf[0xFD5] = 0xFF;
+		buf[0xFD4] = 0xFF;
+	}
 
-		if (buf[0xFDA] != 0x33)
-		{
-			printf("SNES: Patch bad BS header: offset %04X, bad value %02X\n", 0x7FDA | (f->offset == 0x008000 ? 0x0000 : 0x8000), buf[0xFDA]);
-			buf[0xFDA] = 0x33;
-		}
+	if (buf[0xFDA] != 0x33)
+	{
+		printf("SNES: Patch bad BS header: offset %04X, bad value %02X\n", base | 0xFDA, buf[0xFDA]);
+		buf[0xFDA] = 0x33;
+	}
+}
+
+// buf holds len bytes of ROM data starting at ROM offset pos.
+void snes_patch_bs_header(uint8_t *buf, uint32_t pos, uint32_t len, uint32_t rom_size)
+{
+	static const struct { uint32_t base; uint8_t id[2]; } hdr[] = {
+		{ 0x7000, { 0x20, 0x30 } }, // LoROM
+		{ 0xF000, { 0x21, 0x31 } }, // HiROM
+	};
+
+	for (const auto &h : hdr)
+	{
+		if (h.base < pos || h.base + 0x1000 > pos + len) continue;
+
+		uint8_t *p = buf + (h.base - pos);
+		if (p[0xFD8] == h.id[0] || p[0xFD8] == h.id[1]) patch_bs_header(p, h.base, rom_size);
 	}
 }
 
@@ -7,7 +7,7 @@
 #define SNES_FILE_BS		3
 
 uint8_t* snes_get_header(fileTYPE *f);
-void snes_patch_bs_header(fileTYPE *f, uint8_t *buf);
+void snes_patch_bs_header(uint8_t *buf, uint32_t pos, uint32_t len, uint32_t rom_size);
 void snes_msu_init(const char* name);
 void snes_poll(void);
 
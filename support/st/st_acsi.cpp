@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <semaphore.h>
+
+#include "../../offload.h"
+#include "../../profiling.h"
+#include "st_acsi.h"
+
+// Two buffers: one is sent to the ST while the next sectors are read into
+// the other on the offload thread. The last one doubles as read-ahead for
+// the following command.
+struct acsi_buf_t
+{
+	int      target;
+	uint32_t lba;
+	uint32_t count; // 0 if empty
+	int      pending;
+	int      ok;
+	sem_t    done;
+	uint8_t  data[ACSI_CHUNK * 512];
+};
+
+static acsi_buf_t acsi_buf[2];
+
+static void acsi_buf_wait(acsi_buf_t *b)
+{
+	if (b->pending)
+	{
+		sem_wait(&b->done);
+		b->pending = 0;
+	}
+}
+
+static void acsi_buf_load(acsi_buf_t *b, int target, int fd, uint32_t lba, uint32_t count, int async)
+{
+	static int init = 0;
+	if (!init)
+	{
+		init = 1;
+		for (auto &buf : acsi_buf) sem_init(&buf.done, 0, 0);
+	}
+
+	acsi_buf_wait(b);
+	b->target = target;
+	b->lba = lba;
+	b->count = count;
+
+	auto load = [b, fd]
+	{
+		ssize_t len = b->count * 512;
+		b->ok = pread(fd, b->data, len, (off_t)b->lba * 512) == len;
+	};
+
+	if (!async) load();
+	else
+	{
+		b->pending = 1;
+		offload_add_work([b, load]
+		{
+			load();
+			sem_post(&b->done);
+		});
+	}
+}
+
+void acsi_buf_drop(int target, uint32_t lba, uint32_t count)
+{
+	for (auto &b : acsi_buf)
+	{
+		if (!b.count || b.target != target) continue;
+		if (count && (lba >= b.lba + b.count || lba + count <= b.lba)) continue;
+		acsi_buf_wait(&b);
+		b.count = 0;
+	}
+}
+
+uint8_t *acsi_read(int target, int fd, uint32_t lba, uint32_t count, uint32_t blocks, int more)
+{
+	static uint32_t last_end[2] = {};
+
+	int cur = -1;
+	for (int i = 0; i < 2; i++)
+	{
+		acsi_buf_t *b = &acsi_buf[i];
+		if (b->count && b->target == target && lba >= b->lba && lba + count <= b->lba + b->count)
+		{
+			acsi_buf_wait(b);
+			if (b->ok) cur = i;
+			break;
+		}
+	}
+
+	int sequential = (lba == last_end[target]);
+	last_end[target] = lba + count;
+
+	if (cur < 0)
+	{
+		// don't stall on a read-ahead that wasn't needed
+		cur = acsi_buf[0].pending ? 1 : 0;
+		acsi_buf_load(&acsi_buf[cur], target, fd, lba, count, 0);
+		if (!acsi_buf[cur].ok)
+		{
+			acsi_buf[cur].count = 0;
+			return 0;
+		}
+	}
+	else
+	{
+		PROFILE_COUNTER("acsi_readahead_hit", 1);
+		sequential = 1;
+	}
+
+	acsi_buf_t *b = &acsi_buf[cur];
+	acsi_buf_t *next = &acsi_buf[cur ^ 1];
+	uint32_t next_lba = b->lba + b->count;
+	if ((sequential || more) && next_lba < blocks && !(next->count && next->target == target && next->lba == next_lba))
+	{
+		uint32_t next_count = blocks - next_lba;
+		if (next_count > ACSI_CHUNK) next_count = ACSI_CHUNK;
+		acsi_buf_load(next, target, fd, next_lba, next_count, 1);
+	}
+
+	return b->data + (lba - b->lba) * 512;
+}
@@ -0,0 +1,15 @@
+#ifndef ST_ACSI_H
+#define ST_ACSI_H
+
+#include <stdint.h>
+
+#define ACSI_CHUNK 256 // sectors per file operation
+
+// Returns the buffer holding lba..lba+count of the image open as fd, or 0 if it can't be read.
+// The following sectors are read ahead on the offload thread if more are requested or reads turn sequential.
+uint8_t *acsi_read(int target, int fd, uint32_t lba, uint32_t count, uint32_t blocks, int more);
+
+// Drops buffered sectors of target overlapping lba..lba+count (all of them if count is 0).
+void acsi_buf_drop(int target, uint32_t lba, uint32_t count);
+
+#endif
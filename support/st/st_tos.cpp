@@ -9,6 +9,7 @@
 #include "../../user_io.h"
 #include "../../fpga_io.h"
 #include "st_tos.h"
+#include "st_acsi.h"
 
 #define ST_WRITE_MEMORY 0x08
 #define ST_READ_MEMORY  0x09
@@ -117,8 +118,7 @@ static void memory_read(uint8_t *data, uint32_t words)
 	spi8(ST_READ_MEMORY);
 
 	// transmitted bytes must be multiple of 2 (-> words)
-	uint16_t *buf = (uint16_t*)data;
-	while (words--) *buf++ = spi_w(0);
+	fpga_spi_block_read((uint16_t*)data, words);
 
 	DisableIO();
 }
@@ -127,10 +127,7 @@ static void memory_write(uint8_t *data, uint32_t words)
 {
 	EnableIO();
 	spi8(ST_WRITE_MEMORY);
-
-	uint16_t *buf = (uint16_t*)data;
-	while (words--) spi_w(*buf++);
-
+	fpga_spi_block_write((const uint16_t*)data, words);
 	DisableIO();
 }
 
@@ -151,7 +148,7 @@ static void dma_nak()
 
 static void handle_acsi(unsigned char *buffer)
 {
-	static uint8_t buf[65536];
+	static uint8_t buf[ACSI_CHUNK * 512];
 
 	static uint8_t asc[2] = { 0,0 };
 	uint8_t target = buffer[10] >> 5;
@@ -241,21 +238,22 @@ static void handle_acsi(unsigned char *buffer)
 				if (lba + length <= blocks)
 				{
 					DISKLED_ON;
-					FileSeekLBA(&hdd_image[target], lba);
+					uint8_t *data = 0;
 					while (length)
 					{
 						uint32_t len = length;
-						if (len > 128) len = 128;
-						length -= len;
+						if (len > ACSI_CHUNK) len = ACSI_CHUNK;
+						data = acsi_read(target, fileno(hdd_image[target].filp), lba, len, blocks, length > len);
+						if (!data) break;
 
-						len *= 512;
-						FileReadAdv(&hdd_image[target], buf, len);
-						memory_write(buf, len / 2);
+						memory_write(data, len * 256);
+						lba += len;
+						length -= len;
 					}
 					DISKLED_OFF;
 
-					dma_ack(0x00);
-					asc[target] = 0x00;
+					dma_ack(data ? 0x00 : 0x02);
+					asc[target] = data ? 0x00 : 0x11;
 				}
 				else
 				{
@@ -291,11 +289,12 @@ static void handle_acsi(unsigned char *buffer)
 				if (lba + length <= blocks)
 				{
 					DISKLED_ON;
+					acsi_buf_drop(target, lba, length);
 					FileSeekLBA(&hdd_image[target], lba);
 					while (length)
 					{
 						uint32_t len = length;
-						if (len > 128) len = 128;
+						if (len > ACSI_CHUNK) len = ACSI_CHUNK;
 						length -= len;
 
 						len *= 512;
@@ -506,6 +505,7 @@ static void tos_select_hdd_image(int i, const char *name)
 	tos_debugf("Select ACSI%c image %s", '0' + i, name);
 
 	strcpy(config.acsi_img[i], name);
+	acsi_buf_drop(i, 0, 0);
 	if (!strlen(name))
 	{
 		FileClose(&hdd_image[i]);
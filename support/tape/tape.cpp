@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <semaphore.h>
+
+#include "tape.h"
+#include "../../menu.h"
+#include "../../offload.h"
+#include "../../profiling.h"
+#include "../uef/zlib.h"
+
+#define TAPE_MAX_SIZE (64 * 1024 * 1024)
+#define TAPE_SLOTS    4
+#define TAPE_SLOT_SZ  (16 * 1024)
+#define TAPE_READ_SZ  (64 * 1024)
+
+static int tape_inflate(fileTYPE *f, tape_image_t *img)
+{
+	z_stream strm = {};
+	if (inflateInit2(&strm, MAX_WBITS | 16) != Z_OK) return 0;
+
+	uint32_t cap = (f->size < TAPE_MAX_SIZE / 4) ? (uint32_t)f->size * 4 : TAPE_MAX_SIZE;
+	if (cap < TAPE_READ_SZ) cap = TAPE_READ_SZ;
+	img->data = (uint8_t*)malloc(cap);
+	img->size = 0;
+
+	static uint8_t in[TAPE_READ_SZ];
+	int ret = img->data ? Z_OK : Z_MEM_ERROR;
+	while (ret == Z_OK)
+	{
+		int len = FileReadAdv(f, in, sizeof(in));
+		if (len <= 0)
+		{
+			ret = Z_DATA_ERROR;
+			break;
+		}
+
+		strm.next_in = in;
+		strm.avail_in = len;
+		while (ret == Z_OK && (strm.avail_in || img->size == cap))
+		{
+			if (img->size == cap)
+			{
+				if (cap >= TAPE_MAX_SIZE)
+				{
+					ret = Z_MEM_ERROR;
+					break;
+				}
+
+				cap *= 2;
+				uint8_t *data = (uint8_t*)realloc(img->data, cap);
+				if (!data)
+				{
+					ret = Z_MEM_ERROR;
+					break;
+				}
+				img->data = data;
+			}
+
+			strm.next_out = img->data + img->size;
+			strm.avail_out = cap - img->size;
+			ret = inflate(&strm, Z_NO_FLUSH);
+			img->size = cap - strm.avail_out;
+			if (ret == Z_BUF_ERROR) ret = Z_OK;
+		}
+	}
+
+	inflateEnd(&strm);
+	if (ret != Z_STREAM_END)
+	{
+		printf("tape: inflate failed (%d).\n", ret);
+		tape_free(img);
+		return 0;
+	}
+
+	return 1;
+}
+
+int tape_load(fileTYPE *f, tape_image_t *img)
+{
+	PROFILE_FUNCTION();
+
+	memset(img, 0, sizeof(tape_image_t));
+
+	uint8_t magic[2];
+	if (!FileSeek(f, 0, SEEK_SET) || FileReadAdv(f, magic, 2) != 2 || !FileSeek(f, 0, SEEK_SET))
+	{
+		printf("tape: cannot read %s\n", f->name);
+		return 0;
+	}
+
+	// 1f 8b is the gzip magic number
+	if (magic[0] == 0x1f && magic[1] == 0x8b) return tape_inflate(f, img);
+
+	if (f->size > TAPE_MAX_SIZE) return 0;
+
+	img->data = (uint8_t*)malloc(f->size ? f->size : 1);
+	if (!img->data) return 0;
+
+	img->size = FileReadAdv(f, img->data, f->size);
+	if (img->size != f->size)
+	{
+		tape_free(img);
+		return 0;
+	}
+
+	return 1;
+}
+
+void tape_free(tape_image_t *img)
+{
+	free(img->data);
+	img->data = 0;
+	img->size = 0;
+}
+
+static uint8_t *slot_buf[TAPE_SLOTS] = {};
+static sem_t slot_ready[TAPE_SLOTS];
+
+static void render_slot(int slot, uint32_t len, tape_render_t render, void *ctx)
+{
+	offload_add_work([slot, len, render, ctx]
+	{
+		render(ctx, slot_buf[slot], len);
+		sem_post(&slot_ready[slot]);
+	});
+}
+
+static void progress(const char *name, uint32_t pos, uint32_t size)
+{
+	if (name) ProgressMessage("Loading", name, pos, size);
+}
+
+void tape_stream(uint32_t size, tape_render_t render, void *ctx, tape_send_t send, const char *progress_name)
+{
+	PROFILE_FUNCTION();
+
+	if (!render)
+	{
+		const uint8_t *src = (const uint8_t*)ctx;
+		for (uint32_t pos = 0; pos < size; pos += TAPE_SLOT_SZ)
+		{
+			progress(progress_name, pos, size);
+			send(src + pos, (size - pos < TAPE_SLOT_SZ) ? size - pos : TAPE_SLOT_SZ);
+		}
+		return;
+	}
+
+	int slots = 0;
+	while (slots < TAPE_SLOTS && (slot_buf[slots] = (uint8_t*)malloc(TAPE_SLOT_SZ))) slots++;
+
+	if (slots < 2)
+	{
+		printf("tape: not enough memory, rendering inline.\n");
+		static uint8_t tmp[4096];
+		for (uint32_t pos = 0; pos < size; pos += sizeof(tmp))
+		{
+			uint32_t len = (size - pos < sizeof(tmp)) ? size - pos : sizeof(tmp);
+			render(ctx, tmp, len);
+			progress(progress_name, pos, size);
+			send(tmp, len);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < slots; i++) sem_init(&slot_ready[i], 0, 0);
+
+		uint32_t queued = 0;
+		for (int i = 0; i < slots && queued < size; i++)
+		{
+			uint32_t len = (size - queued < TAPE_SLOT_SZ) ? size - queued : TAPE_SLOT_SZ;
+			render_slot(i, len, render, ctx);
+			queued += len;
+		}
+
+		int cur = 0;
+		for (uint32_t pos = 0; pos < size; cur = (cur + 1) % slots)
+		{
+			uint32_t len = (size - pos < TAPE_SLOT_SZ) ? size - pos : TAPE_SLOT_SZ;
+			sem_wait(&slot_ready[cur]);
+			progress(progress_name, pos, size);
+			send(slot_buf[cur], len);
+			pos += len;
+
+			if (queued < size)
+			{
+				len = (size - queued < TAPE_SLOT_SZ) ? size - queued : TAPE_SLOT_SZ;
+				render_slot(cur, len, render, ctx);
+				queued += len;
+			}
+		}
+
+		for (int i = 0; i < slots; i++) sem_destroy(&slot_ready[i]);
+	}
+
+	for (int i = 0; i < slots; i++)
+	{
+		free(slot_buf[i]);
+		slot_buf[i] = 0;
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef TAPE_H
+#define TAPE_H
+
+#include <inttypes.h>
+#include "../../file_io.h"
+
+// Complete tape image held in RAM. gzip images are inflated while reading.
+struct tape_image_t
+{
+	uint8_t *data;
+	uint32_t size;
+};
+
+int  tape_load(fileTYPE *f, tape_image_t *img);
+void tape_free(tape_image_t *img);
+
+// Produces the next len bytes of the stream. Called in stream order.
+typedef void (*tape_render_t)(void *ctx, uint8_t *buf, uint32_t len);
+typedef void (*tape_send_t)(const uint8_t *buf, uint32_t len);
+
+// Sends size bytes to the core. Blocks are rendered ahead on the offload
+// thread into a ring of buffers while earlier blocks are being sent.
+// If render is 0, ctx points to size bytes which are sent as they are.
+// progress_name enables the OSD progress bar.
+void tape_stream(uint32_t size, tape_render_t render, void *ctx, tape_send_t send, const char *progress_name);
+
+#endif
@@ -25,14 +25,10 @@
 #include <string.h>
 #include <inttypes.h>
 #include <stdbool.h>
-#include <fcntl.h>
-#include <time.h>
-#include <assert.h>
 
 #include "../../file_io.h"
 #include "../../user_io.h"
-#include "../../menu.h"
-#include "zlib.h"
+#include "../tape/tape.h"
 
 #define UEF_ChunkHeaderSize (sizeof(uint16_t) + sizeof(uint32_t))
 #define UEF_infoID      0x0000
@@ -47,465 +43,219 @@
 #define UEF_stopBit     1
 #define UEF_Baud        (1000000.0/(16.0*52.0))
 
+// Chunks that produce bits, indexed once so the stream can be rendered
+// sequentially straight from the image in memory.
 typedef struct {
-    // UEF header
-    uint16_t    id;
-    uint32_t    length;
-    // chunk data
-    uint32_t    file_offset;
-    uint32_t    bit_offset_start;
-    uint32_t    bit_offset_end;
-    uint32_t    pre_carrier;
-} __attribute__((packed)) ChunkInfo;
+    uint16_t       id;
+    const uint8_t* data;
+    uint32_t       length;
+    uint32_t       bit_len;
+    uint32_t       pre_carrier;
+} ChunkInfo;
 
-// TODO - allocate this as part of the desc structure
-static ChunkInfo s_ChunkData = { 0,0,0,0,0,0 };
-
-
-
-static uint16_t ReadChunkHeader(FILE* f, ChunkInfo* chunk)
+typedef struct {
+    ChunkInfo* chunks;
+    uint32_t   count;
+    uint32_t   numbits;
+    // render position
+    uint32_t   cur;
+    uint32_t   bit_pos;
+} UEF_stream;
+
+static uint16_t get16(const uint8_t* p)
 {
-    chunk->id = -1;
-    chunk->length = 0;
-
-    if (fread(chunk, 1, UEF_ChunkHeaderSize, f) != UEF_ChunkHeaderSize) {
-        return (-1);
-    }
+    return p[0] | (p[1] << 8);
+}
 
-    //fprintf(stderr, "ReadChunkHeader: chunk->id %d chunk->length %d\n", chunk->id,chunk->length);
-    return chunk->id;
+static uint32_t get32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
-static ChunkInfo* GetChunkAtPosFile(FILE *f, uint32_t* p_bit_pos)
+static void LogChunk(uint16_t id, const uint8_t* data, uint32_t length)
 {
-    uint32_t bit_pos = *p_bit_pos;
-    uint8_t length_check = (bit_pos == 0xffffffff);
-    ChunkInfo* chunk = &s_ChunkData;
+    if (UEF_infoID == id) {
+        fprintf(stderr, "Drv02:UEF Info : '%.*s'\n", (int)length, (const char*)data);
 
-    //fprintf(stderr, "Find pos : %d\n", bit_pos);
+    } else if (UEF_freqChgID == id && length >= sizeof(float)) {
+        float freq;
+        memcpy(&freq, data, sizeof(freq));
+        fprintf(stderr, "Drv02:Ignoring base frequency change : %d\n", (int)freq);
 
-    if (chunk->bit_offset_start <= bit_pos && bit_pos < chunk->bit_offset_end) {
-        bit_pos -= chunk->bit_offset_start;
-        *p_bit_pos = bit_pos;
-        return chunk;
-    }
+    } else if (UEF_floatGapID == id && length >= sizeof(float)) {
+        float gap;
+        memcpy(&gap, data, sizeof(gap));
+        fprintf(stderr, "Drv02:Ignoring floating point gap : %d ms\n", (int)(gap * 1000.f));
 
-    uint32_t chunk_start = 0;
-    uint32_t chunk_bitlen = 0;
-
-    if (chunk->bit_offset_end != 0 && bit_pos >= chunk->bit_offset_end) {
-        fseek(f, chunk->file_offset + chunk->length, SEEK_SET);
-        chunk_start = chunk->bit_offset_end;
-        bit_pos -= chunk_start;
+    } else if (UEF_securityID == id) {
+        fprintf(stderr, "Drv02:UEF security block ignored\n");
 
     } else {
-        fseek(f, 12, SEEK_SET);     // sizeof(UEF_header)
+        fprintf(stderr, "Drv02:Unknown UEF block ID %04x\n", id);
     }
+}
 
-    chunk->bit_offset_end = 0;
-
-    while (!feof(f)) {
-        uint16_t id = ReadChunkHeader(f, chunk);
-
-        if (id == (uint16_t) - 1) {
-            break;
-        }
-
-        //fprintf(stderr, "Parse ChunkID : %04x - Length : %4d bytes (%04x) - Offset = %d\n", chunk->id, chunk->length, chunk->length, (uint32_t)ftell(f));
-        chunk->file_offset = ftell(f);
+static uint32_t IndexChunks(const uint8_t* data, uint32_t size, UEF_stream* s)
+{
+    uint32_t pos = 12;  // sizeof(UEF_header)
+    uint32_t max = 0;
 
-        if (UEF_tapeID == id || UEF_gapID == id || UEF_highToneID == id || UEF_highDummyID == id) {
+    s->chunks = 0;
+    s->count = 0;
+    s->numbits = 0;
 
-            if (id == UEF_tapeID) {
-                chunk_bitlen = chunk->length * 10;
+    while (pos + UEF_ChunkHeaderSize <= size) {
+        uint16_t id = get16(data + pos);
+        uint32_t length = get32(data + pos + 2);
+        pos += UEF_ChunkHeaderSize;
 
-            } else if (id == UEF_gapID || id == UEF_highToneID) {
-                uint16_t ms;
+        if (length > size - pos) {
+            length = size - pos;
+        }
 
-                if (fread(&ms, 1, sizeof(ms), f) != sizeof(ms)) {
-                    break;
-                }
+        ChunkInfo chunk = { id, data + pos, length, 0, 0 };
 
-                chunk_bitlen = ms * (UEF_Baud / 1000.0);
-                fseek(f, -sizeof(ms), SEEK_CUR);
+        if (id == UEF_tapeID) {
+            chunk.bit_len = length * 10;
 
-            } else if (id == UEF_highDummyID) {
-                uint16_t ms;
+        } else if ((id == UEF_gapID || id == UEF_highToneID) && length >= 2) {
+            chunk.bit_len = get16(chunk.data) * (UEF_Baud / 1000.0);
 
-                if (fread(&ms, 1, sizeof(ms), f) != sizeof(ms)) {
-                    break;
-                }
+        } else if (id == UEF_highDummyID && length >= 4) {
+            chunk.pre_carrier = get16(chunk.data) * (UEF_Baud / 1000.0);
+            uint32_t post_carrier = get16(chunk.data + 2) * (UEF_Baud / 1000.0);
+            chunk.bit_len = chunk.pre_carrier + 20 + post_carrier;
 
-                chunk->pre_carrier = ms * (UEF_Baud / 1000.0);
+        } else if (id != UEF_tapeID && id != UEF_gapID && id != UEF_highToneID && id != UEF_highDummyID) {
+            LogChunk(id, chunk.data, length);
+        }
 
-                if (fread(&ms, 1, sizeof(ms), f) != sizeof(ms)) {
-                    break;
-                }
+        pos += length;
 
-                uint32_t post_carrier = ms * (UEF_Baud / 1000.0);
-                chunk_bitlen = chunk->pre_carrier + 20 + post_carrier;
-                fseek(f, -sizeof(ms) * 2, SEEK_CUR);
-            }
+        if (!chunk.bit_len) {
+            continue;
+        }
 
-            if (bit_pos < chunk_bitlen) {
-                chunk->bit_offset_start = chunk_start;
-                chunk->bit_offset_end = chunk_start + chunk_bitlen;
+        if (s->count == max) {
+            max = max ? max * 2 : 256;
+            ChunkInfo* chunks = (ChunkInfo*)realloc(s->chunks, max * sizeof(ChunkInfo));
+            if (!chunks) {
                 break;
             }
-
-            bit_pos -= chunk_bitlen;
-            chunk_start += chunk_bitlen;
-
-        } else if (length_check) {
-
-            if (UEF_infoID == id) {
-                char buffer[64];
-                uint32_t length = chunk->length;
-
-                while (length > 0) {
-                    uint32_t read_len = length;
-
-                    if (read_len > sizeof(buffer) - 1) {
-                        read_len = sizeof(buffer) - 1;
-                    }
-
-                    if (fread(buffer, 1, read_len, f) != read_len) {
-                        break;
-                    }
-
-                    buffer[read_len] = '\0';
-                    fprintf(stderr, "Drv02:UEF Info : '%s'", buffer);
-
-                    length -= read_len;
-                }
-
-            } else if (UEF_freqChgID == id) {
-                float freq;
-
-                if (fread(&freq, 1, sizeof(freq), f) != sizeof(freq)) {
-                    break;
-                }
-
-                fprintf(stderr, "Drv02:Ignoring base frequency change : %d", (int)freq);
-
-            } else if (UEF_floatGapID == id) {
-                float gap;
-
-                if (fread(&gap, 1, sizeof(gap), f) != sizeof(gap)) {
-                    break;
-                }
-
-                fprintf(stderr, "Drv02:Ignoring floating point gap : %d ms", (int)(gap * 1000.f));
-
-            } else if (UEF_securityID == id) {
-
-                fprintf(stderr, "Drv02:UEF security block ignored");
-
-            } else {
-                fprintf(stderr, "Drv02:Unknown UEF block ID %04x", id);
-            }
-
-            fseek(f, chunk->file_offset, SEEK_SET);
+            s->chunks = chunks;
         }
 
-        fseek(f, chunk->length, SEEK_CUR);
+        s->chunks[s->count++] = chunk;
+        s->numbits += chunk.bit_len;
     }
 
-    /*DEBUG(1, "OK!");*/
-
-    *p_bit_pos = bit_pos;
-    return chunk->bit_offset_end ? chunk : 0;
+    s->cur = 0;
+    s->bit_pos = 0;
+    return s->numbits;
 }
 
-static uint8_t GetBitAtPos(FILE *f, uint32_t bit_pos)
+static uint8_t FramedBit(uint8_t byte, uint32_t bit_offset)
 {
-    ChunkInfo* info = GetChunkAtPosFile(f, &bit_pos);
+    if (bit_offset == 0) {
+        return UEF_startBit;
+    }
 
-    if (!info) {
-        return 0;
+    if (bit_offset == 9) {
+        return UEF_stopBit;
     }
 
-    uint16_t id = info->id;
+    return (byte >> (bit_offset - 1)) & 1;
+}
 
-    if (id == UEF_gapID) {
+// Returns the bit at the render position and advances it.
+static uint8_t NextBit(UEF_stream* s)
+{
+    if (s->cur >= s->count) {
         return 0;
-
-    } else if (id == UEF_highToneID) {
-        return 1;
     }
 
-    if (id == UEF_tapeID) {
-
-        uint32_t byte_offset = bit_pos / 10;
-        uint32_t bit_offset = bit_pos - byte_offset * 10;
-
-        if (bit_offset == 0) {
-            return UEF_startBit;
-        }
+    const ChunkInfo* info = &s->chunks[s->cur];
+    uint32_t bit_pos = s->bit_pos;
+    uint8_t bit;
 
-        if (bit_offset == 9) {
-            return UEF_stopBit;
-        }
-
-        uint8_t byte;
-        fseek(f, info->file_offset + byte_offset, SEEK_SET);
-        int ret=fread(&byte, 1, sizeof(byte), f);
-        if (ret<0) fprintf(stderr,"uef: error reading byte\n");
-
-        bit_offset -= 1;        // E (0,7)
-        assert(bit_offset < 8);
-
-        return (byte & (1 << bit_offset)) ? 1 : 0;
-    }
+    if (info->id == UEF_gapID) {
+        bit = 0;
 
-    assert(id == UEF_highDummyID);
+    } else if (info->id == UEF_highToneID) {
+        bit = 1;
 
-    if ((bit_pos < info->pre_carrier) || (bit_pos >= info->pre_carrier + 20)) {
-        return 1;
-    }
+    } else if (info->id == UEF_tapeID) {
+        bit = FramedBit(info->data[bit_pos / 10], bit_pos % 10);
 
-    bit_pos -= info->pre_carrier;
-    bit_pos %= 10;
+    } else if ((bit_pos < info->pre_carrier) || (bit_pos >= info->pre_carrier + 20)) {
+        bit = 1;
 
-    if (bit_pos == 0) {
-        return UEF_startBit;
+    } else {
+        bit = FramedBit('A', (bit_pos - info->pre_carrier) % 10);
     }
 
-    if (bit_pos == 9) {
-        return UEF_stopBit;
+    if (++s->bit_pos >= info->bit_len) {
+        s->bit_pos = 0;
+        s->cur++;
     }
 
-    bit_pos -= 1;       // E (0,7)
-    assert(bit_pos < 8);
-    uint8_t byte = 'A';
-
-    return (byte & (1 << bit_pos)) ? 1 : 0;
+    return bit;
 }
 
-#define BUFLEN      16384
-#define CHUNK 16384
-
-#define kBufferSize 4096
-
-static int uef_copy_file(fileTYPE *source, FILE *dest)
+static void RenderBits(void* ctx, uint8_t* buf, uint32_t len)
 {
-unsigned char in[CHUNK];
-int num_bytes;
-
-
-  do {
-       num_bytes = FileReadAdv(source, in, CHUNK,-1);
-       fprintf(stderr,"fread: %d\n",num_bytes);
-       if (num_bytes<0) {
-           fprintf(stderr,"uef_copy_file: error reading data\n");
-           return -1;
-       }
-       if (fwrite(in, 1, num_bytes, dest) != (size_t)num_bytes || ferror(dest)) {
-           fprintf(stderr,"uef_copy_file: error writing data\n");
-           return -1;
-       }
-   } while (num_bytes!=0);
-
-  return 0;
-}
+    UEF_stream* s = (UEF_stream*)ctx;
 
-/* Decompress from file source to file dest until stream ends or EOF.
-   inf() returns Z_OK on success, Z_MEM_ERROR if memory could not be
-   allocated for processing, Z_DATA_ERROR if the deflate data is
-   invalid or incomplete, Z_VERSION_ERROR if the version of zlib.h and
-   the version of the library linked do not match, or Z_ERRNO if there
-   is an error reading or writing the files. */
-static int uef_inflate_file(fileTYPE *source, FILE *dest)
-{
-
-    int ret;
-    unsigned have;
-    z_stream strm;
-    unsigned char in[CHUNK];
-    unsigned char out[CHUNK];
-
-    /* allocate inflate state */
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = 0;
-    strm.next_in = Z_NULL;
-    ret = inflateInit2(&strm,MAX_WBITS|16); // make sure to add the 16 to get it to accept gz header
-
-    if (ret != Z_OK)
-        return ret;
-
-    /* decompress until deflate stream ends or end of file */
-    do {
-
-        int res = FileReadAdv(source, in, CHUNK,-1);
-        strm.avail_in= res;
-        if (res<0) {
-            (void)inflateEnd(&strm);
-            return Z_ERRNO;
+    for (uint32_t pos = 0; pos < len; ++pos) {
+        uint8_t val = 0;
+        for (uint32_t bit = 0; bit < 8; ++bit) {
+            val = (val << 1) | NextBit(s);
         }
-        if (strm.avail_in == 0)
-            break;
-        strm.next_in = in;
-
-        /* run inflate() on input until output buffer not full */
-        do {
-
-            strm.avail_out = CHUNK;
-            strm.next_out = out;
-
-
-
-            ret = inflate(&strm, Z_NO_FLUSH);
-            assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
-            switch (ret) {
-            case Z_NEED_DICT:
-                ret = Z_DATA_ERROR;     /* and fall through */
-                (void)inflateEnd(&strm);
-                return ret;
-            break;
-            case Z_DATA_ERROR:
-                (void)inflateEnd(&strm);
-                return ret;
-            break;
-            case Z_MEM_ERROR:
-                (void)inflateEnd(&strm);
-                return ret;
-            break;
-            }
-
-            have = CHUNK - strm.avail_out;
-            if (fwrite(out, 1, have, dest) != have || ferror(dest)) {
-                (void)inflateEnd(&strm);
-                return Z_ERRNO;
-            }
-
-        } while (strm.avail_out == 0);
-
-        /* done when inflate() says it's done */
-    } while (ret != Z_STREAM_END);
-
-    /* clean up and return */
-    (void)inflateEnd(&strm);
-    return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+        buf[pos] = val;
+    }
 }
 
 int UEF_FileSend(fileTYPE *inputfile,int use_progress)
 {
-        uint32_t buf_size=kBufferSize;
-        unsigned char fbuf[kBufferSize];
-        int addr=0;
-
         typedef struct {
             char    ueftag[10];
             uint8_t minor_version;
             uint8_t major_version;
         } UEF_header;
-        UEF_header header;
-
-
 
-
-        // the UAE file might be gzipped, if so we need to ungzip it
-        // gzip : 1f 8b
-        if ( FileReadAdv(inputfile, &fbuf,2) !=2)
-        {
-                fprintf(stderr,"error reading 2 bytes of file\n");
+        // the UEF file might be gzipped, it is inflated while being read into memory
+        tape_image_t img;
+        if (!tape_load(inputfile, &img)) {
+                fprintf(stderr,"error reading UEF file\n");
                 return 0;
         }
-        // we need to rewind to the beginning
-        FileSeek(inputfile, 0, SEEK_SET);
-
-        FILE *uncompressed_file= tmpfile();
-
-        // 1f 8b is the gzip magic number
-        if (fbuf[0]==0x1f && fbuf[1]==0x8b) {
-            fprintf(stderr,"UEF is compressed\n");
-            uef_inflate_file(inputfile, uncompressed_file);
-        }
-        else {
-            uef_copy_file(inputfile,uncompressed_file);
-            fprintf(stderr,"UEF is not compressed\n");
-        }
 
-        rewind(uncompressed_file);
+        const UEF_header* header = (const UEF_header*)img.data;
 
-        if (fread(&header, 1, sizeof(UEF_header), uncompressed_file) != sizeof(UEF_header)) {
+        if (img.size < sizeof(UEF_header)) {
             fprintf(stderr,"Couldn't read file header\n");
 
-        } else if (memcmp(header.ueftag, "UEF File!\0", sizeof(header.ueftag)) != 0) {
+        } else if (memcmp(header->ueftag, "UEF File!\0", sizeof(header->ueftag)) != 0) {
             fprintf(stderr,"UEF file header mismatch\n");
-            fprintf(stderr,"File compressed?\n");
 
         } else {
-            fprintf(stderr,"UEF: %s %d %d\n",header.ueftag,header.minor_version,header.major_version);
-
-            // figure out how big the file is
-            fseek(uncompressed_file, 0L, SEEK_END);
-            uint32_t size =ftell(uncompressed_file);
-            fprintf(stderr,"size: %d\n",size);
-            rewind(uncompressed_file);
-//FILE *outfile = fopen("tape.raw","wb");
-
-
-            //
-            //  Read the header to find out how big the audio file should be
-            //
-            memset(&s_ChunkData, 0x00, sizeof(ChunkInfo));
-            uint32_t numbits = 0xffffffff;
-            GetChunkAtPosFile(uncompressed_file,&numbits);
+            fprintf(stderr,"UEF: %s %d %d\n",header->ueftag,header->minor_version,header->major_version);
+            fprintf(stderr,"size: %d\n",img.size);
 
-            numbits = ~numbits;
+            UEF_stream stream;
+            uint32_t numbits = IndexChunks(img.data, img.size, &stream);
 
             uint32_t bits_per_second = 1225;
+            fprintf(stderr, "Chunks      : %d\n", stream.count);
             fprintf(stderr, "Bit length  : %d\n", numbits);
             fprintf(stderr, "Wave length : %ds\n", numbits / bits_per_second);
             fprintf(stderr, "Byte length : %d\n", (numbits + 7) / 8);
 
-            // size is the output size of the file we are creating (or dynamically sending)
-            size= (numbits + 7) / 8;
-            uint32_t  orig_size=size;
-
-            fprintf(stderr,"output size: %d\n",size);
-
-            // clear the header
-            memset(&s_ChunkData, 0x00, sizeof(ChunkInfo));
-            uint32_t tot_size=0;
-            uint32_t cur_size=0;
-            uint32_t act_size=0;
-
-            while (size) {
-                cur_size= size;
-                if (cur_size>  buf_size) cur_size=buf_size;
-                act_size=cur_size;
-                // artifically clamp size to the end of the bit stream
-                if (addr + act_size >  orig_size)
-                   act_size = orig_size  - addr;
-
-               tot_size+=act_size;
-               // this is a very naive conversion, but it'll have to do for now..
-               for (uint32_t pos = 0; pos < act_size; ++pos) {
-                   uint8_t val = 0;
-                   for (uint32_t bit = 0; bit < 8; ++bit) {
-                      val = val << 1;
-                      val = val | GetBitAtPos(uncompressed_file, ((addr + pos) << 3) + bit);
-                   }
-
-                   fbuf[pos] = val;
-               }
-               if (use_progress) ProgressMessage("Loading", inputfile->name, orig_size-size  , orig_size);
-               user_io_file_tx_data(fbuf, act_size);
-               if (act_size!=cur_size)
-                  fprintf(stderr,"truncated?\n");
-//fwrite(fbuf,1,act_size,outfile);
-               size -= cur_size;
-               addr += cur_size;
-            }
-         fclose(uncompressed_file);
+            // the bit stream is rendered ahead of the transfer in blocks
+            tape_stream((numbits + 7) / 8, RenderBits, &stream, user_io_file_tx_data, use_progress ? inputfile->name : 0);
+            free(stream.chunks);
+        }
 
-//fclose(outfile);
-      }
-  return 0;
+        tape_free(&img);
+        return 0;
 }
-
-
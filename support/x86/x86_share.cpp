@@ -42,10 +42,14 @@
 #include "../../file_io.h"
 #include "../../cfg.h"
 #include "../../shmem.h"
+#include "../../dircache.h"
+#include "../../share_io.h"
+#include "../../profiling.h"
 
 #define SHMEM_ADDR      0x300CE000
 #define SHMEM_SIZE      0x2000
 static uint8_t *shmem = 0;
+static share_async_t req_async = {};
 
 #define REQUEST_FLG     0
 #define REQUEST_BUFFER  4
@@ -96,16 +100,10 @@ enum AL_SUBFUNCTIONS {
 static char basepath[1024] = {};
 static int baselen = 0;
 
-struct dir_item_t
-{
-	dirent64 de;
-	stat64 st;
-};
-
 struct lock
 {
 	uint16_t token;
-	std::vector<dir_item_t> dir_items;
+	std::vector<dircache_item_t> dir_items;
 };
 
 static std::map<short, lock> locks;
@@ -301,68 +299,15 @@ static uint32_t get_attr(char *path, uint16_t *time, uint16_t *date, uint32_t *s
 	return st->st_mode;
 }
 
-static void name83(const char *src, char *dst)
-{
-	int namelen = 0;
-	int extlen = 0;
-
-	const char *p = strrchr(src, '/');
-	if (p) src = p + 1;
-
-	if (!strcmp(src, ".") || !strcmp(src, ".."))
-	{
-		namelen = strlen(src);
-	}
-	else
-	{
-		p = strrchr(src, '.');
-		if (!p) namelen = strlen(src);
-		else
-		{
-			namelen = p - src;
-			extlen = strlen(src) - namelen - 1;
-		}
-	}
-
-
-	char ext[4] = { ' ', ' ', ' ', 0 };
-	if (p) memcpy(ext, p + 1, extlen);
-	for (int i = 0; i < namelen; i++) dst[i] = toupper(src[i]);
-	while (namelen < 8) dst[namelen++] = ' ';
-	for (int i = 0; i < 3; i++) dst[8 + i] = toupper(ext[i]);
-}
-
-static int cmp_name(const char *name, const char *flt)
+static int cmp_name83(const char *testname, const char *flt)
 {
-	int namelen = 0;
-	int extlen = 0;
-
-	const char *ext = strrchr(name, '.');
-	if (!ext)
-	{
-		namelen = strlen(name);
-		ext = name + namelen;
-	}
-	else
-	{
-		namelen = ext - name;
-		ext++;
-		extlen = strlen(ext);
-	}
-
-	if (namelen > 8 || extlen > 3) return 0;
-
-	char testname[16];
 	char fltname[16];
-	name83(name, testname);
-	name83(flt, fltname);
-
-	testname[11] = 0;
+	dircache_name83(flt, fltname);
 	fltname[11] = 0;
 
 	char *cmpname = fltname;
 	char *cmpend = fltname + 8;
-	char *cur = testname;
+	const char *cur = testname;
 
 	while (cmpname < cmpend)
 	{
@@ -405,8 +350,37 @@ static int cmp_name(const char *name, const char *flt)
 	return 1;
 }
 
+static int cmp_name(const char *name, const char *flt)
+{
+	int namelen = 0;
+	int extlen = 0;
+
+	const char *ext = strrchr(name, '.');
+	if (!ext)
+	{
+		namelen = strlen(name);
+		ext = name + namelen;
+	}
+	else
+	{
+		namelen = ext - name;
+		ext++;
+		extlen = strlen(ext);
+	}
+
+	if (namelen > 8 || extlen > 3) return 0;
+
+	char testname[16];
+	dircache_name83(name, testname);
+	testname[11] = 0;
+
+	return cmp_name83(testname, flt);
+}
+
 static int process_request(void *reqres_buffer)
 {
+	PROFILE_FUNCTION();
+
 	static char str[1024];
 	int len = *(unsigned short*)reqres_buffer;
 	char func = ((char*)reqres_buffer)[4];
@@ -544,7 +518,7 @@ static int process_request(void *reqres_buffer)
 		dbg_print("opened handle: %d\n", key);
 
 		*buf++ = 0;
-		name83(path, buf);
+		dircache_name83(path, buf);
 		buf += 11;
 		get_attr(path, (uint16_t*)buf, (uint16_t*)(buf + 2), (uint32_t*)(buf + 4));
 		buf += 8;
@@ -604,7 +578,7 @@ static int process_request(void *reqres_buffer)
 		dbg_print("opened handle: %d\n", key);
 
 		*buf++ = 0;
-		name83(path, buf);
+		dircache_name83(path, buf);
 		buf += 11;
 		get_attr(path, (uint16_t*)buf, (uint16_t*)(buf + 2), (uint32_t*)(buf + 4));
 		buf += 8;
@@ -691,7 +665,7 @@ static int process_request(void *reqres_buffer)
 		dbg_print("opened handle: %d\n", key);
 
 		*buf++ = 0;
-		name83(path, buf);
+		dircache_name83(path, buf);
 		buf += 11;
 		get_attr(path, (uint16_t*)buf, (uint16_t*)(buf + 2), (uint32_t*)(buf + 4)); // 12 14 16
 		buf += 8;
@@ -713,6 +687,7 @@ static int process_request(void *reqres_buffer)
 		key = *(short *)buf;
 		if (open_file_handles.find(key) != open_file_handles.end())
 		{
+			share_ra_drop(&open_file_handles[key]);
 			FileClose(&open_file_handles[key]);
 			open_file_handles.erase(key);
 
@@ -742,7 +717,7 @@ static int process_request(void *reqres_buffer)
 
 		FileSeek(&open_file_handles[key], off, SEEK_SET);
 
-		int read = FileReadAdv(&open_file_handles[key], buf, sz, -1);
+		int read = share_ra_read(&open_file_handles[key], buf, sz, -1);
 		if (read < 0)
 		{
 			res = 5;
@@ -772,6 +747,7 @@ static int process_request(void *reqres_buffer)
 		uint16_t sz = buf[6] | (buf[7] << 8);
 		dbg_print("  write %d bytes at %d\n", sz, off);
 
+		share_ra_drop(&open_file_handles[key]);
 		FileSeek(&open_file_handles[key], off, SEEK_SET);
 
 		int written = 0;
@@ -1013,21 +989,22 @@ static int process_request(void *reqres_buffer)
 		*flt++ = 0;
 		key = add_lock(token);
 
-		const char* full_path = getFullPath(path);
-		DIR *d = opendir(full_path);
-		if (!d)
+		if (!dircache_get(path, locks[key].dir_items, [attr, flt](const dircache_item_t &item)
+			{
+				return (attr != 8) && (item.type == DT_REG || (attr & FAT_DIR)) && item.name83[0] && cmp_name83(item.name83, flt);
+			}))
 		{
 			locks.erase(key);
-			printf("Couldn't open dir: %s\n", full_path);
+			printf("Couldn't open dir: %s\n", getFullPath(path));
 			res = 0x12;
 			break;
 		}
 
 		if (attr == 8)
 		{
-			struct dirent64 de = {};
-			strcpy(de.d_name, "MiSTer");
-			locks[key].dir_items.push_back({ de, {} });
+			dircache_item_t item = {};
+			strcpy(item.name, "MiSTer");
+			locks[key].dir_items.push_back(item);
 
 			*buf++ = 8;
 			memcpyb(buf, "MiSTer     ", 11);
@@ -1044,27 +1021,6 @@ static int process_request(void *reqres_buffer)
 			reslen = 24;
 			break;
 		}
-		else
-		{
-			struct dirent64 de, *de2;
-			while ((de2 = readdir64(d)))
-			{
-				if (de2->d_type == DT_REG || (attr & FAT_DIR))
-				{
-					memcpy(&de, de2, sizeof(dirent64));
-					sprintf(str, "%s/%s", path, de.d_name);
-					stat64 *st = getPathStat(str);
-
-					if (st && cmp_name(de.d_name, flt))
-					{
-						name83(de2->d_name, de.d_name);
-						de.d_name[11] = 0;
-						locks[key].dir_items.push_back({ de, *st });
-					}
-				}
-			}
-			closedir(d);
-		}
 	}
 	// fall through
 
@@ -1095,11 +1051,11 @@ static int process_request(void *reqres_buffer)
 			break;
 		}
 
-		*buf++ = (locks[key].dir_items[idx].de.d_type == DT_DIR) ? FAT_DIR : 0;
-		memcpyb(buf, locks[key].dir_items[idx].de.d_name, 11);
+		*buf++ = (locks[key].dir_items[idx].type == DT_DIR) ? FAT_DIR : 0;
+		memcpyb(buf, locks[key].dir_items[idx].name83, 11);
 		buf += 11;
 
-		tm *t = localtime(&locks[key].dir_items[idx].st.st_mtime);
+		tm *t = localtime(&locks[key].dir_items[idx].mtime);
 		uint16_t time = (t->tm_sec / 2) | (t->tm_min << 5) | (t->tm_hour << 11);
 		uint16_t date = t->tm_mday | ((t->tm_mon + 1) << 5) | ((t->tm_year - 80) << 9);
 
@@ -1108,7 +1064,7 @@ static int process_request(void *reqres_buffer)
 		*buf++ = date;
 		*buf++ = date >> 8;
 
-		memcpyb(buf, &locks[key].dir_items[idx].st.st_size, 4);
+		memcpyb(buf, &locks[key].dir_items[idx].size, 4);
 		buf += 4;
 		*buf++ = key;
 		*buf++ = key >> 8;
@@ -1177,6 +1133,14 @@ void x86_share_poll()
 	else if (shmem != (uint8_t *)-1)
 	{
 		static uint32_t old_req_id = 0;
+
+		// request is processed on the offload thread, acknowledge once it's done
+		if (req_async.busy)
+		{
+			if (!share_async_done(&req_async)) return;
+			*(uint16_t*)(shmem + REQUEST_FLG + 2) = (uint16_t)old_req_id;
+		}
+
 		uint32_t req_id = *(uint32_t*)(shmem + REQUEST_FLG);
 
 		if ((uint16_t)old_req_id != (uint16_t)req_id)
@@ -1186,8 +1150,7 @@ void x86_share_poll()
 
 			if (((req_id >> 16) & 0xFFFF) == 0xA55A && ((req_id + 77) & 0xFF) == ((req_id >> 8) & 0xFF))
 			{
-				process_request(shmem + REQUEST_BUFFER);
-				*(uint16_t*)(shmem + REQUEST_FLG + 2) = (uint16_t)req_id;
+				share_async_run(&req_async, [] { process_request(shmem + REQUEST_BUFFER); });
 			}
 		}
 	}
@@ -1195,6 +1158,9 @@ void x86_share_poll()
 
 void x86_share_reset()
 {
+	share_async_sync(&req_async);
+	share_ra_drop();
+
 	open_file_handles.clear();
 	locks.clear();
 	next_fp = 1;
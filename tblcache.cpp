@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tblcache.h"
+#include "file_io.h"
+#include "profiling.h"
+#include "miniz.h"
+
+#define TBLCACHE_DIR     "tblcache"
+#define TBLCACHE_MAGIC   0x4C424354 // TCBL
+#define TBLCACHE_VERSION 1
+#define TBLCACHE_MAPPED  8
+
+struct tblcache_hdr_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t path_crc;
+	uint32_t variant;
+	uint64_t src_size;
+	int64_t  src_mtime;
+	uint32_t size;
+	uint32_t reserved;
+};
+
+struct tblcache_map_t
+{
+	uint32_t path_crc;
+	uint32_t variant;
+	void *map;
+	size_t map_size;
+};
+
+static tblcache_map_t tbl_maps[TBLCACHE_MAPPED] = {};
+static int tbl_next = 0;
+
+static int make_key(const char *src, uint32_t variant, tblcache_hdr_t *hdr, char *name, int name_size)
+{
+	const char *full = getFullPath(src);
+
+	struct stat64 st;
+	if (stat64(full, &st) < 0 || !S_ISREG(st.st_mode)) return 0;
+
+	memset(hdr, 0, sizeof(tblcache_hdr_t));
+	hdr->magic = TBLCACHE_MAGIC;
+	hdr->version = TBLCACHE_VERSION;
+	hdr->path_crc = crc32(0, (const uint8_t*)full, strlen(full));
+	hdr->variant = variant;
+	hdr->src_size = st.st_size;
+	hdr->src_mtime = st.st_mtime;
+
+	snprintf(name, name_size, TBLCACHE_DIR"/%08X_%08X.bin", hdr->path_crc, variant);
+	return 1;
+}
+
+static int map_valid(const tblcache_map_t *m, const tblcache_hdr_t *key)
+{
+	if (m->map_size < sizeof(tblcache_hdr_t)) return 0;
+	const tblcache_hdr_t *hdr = (const tblcache_hdr_t*)m->map;
+	return hdr->magic == key->magic && hdr->version == key->version && hdr->path_crc == key->path_crc &&
+		hdr->variant == key->variant && hdr->src_size == key->src_size && hdr->src_mtime == key->src_mtime &&
+		m->map_size == sizeof(tblcache_hdr_t) + hdr->size;
+}
+
+static void map_release(tblcache_map_t *m)
+{
+	if (m->map) munmap(m->map, m->map_size);
+	memset(m, 0, sizeof(tblcache_map_t));
+}
+
+const void *tblcache_get(const char *src, uint32_t variant, uint32_t *size)
+{
+	PROFILE_FUNCTION();
+
+	char name[64];
+	tblcache_hdr_t key;
+	if (!make_key(src, variant, &key, name, sizeof(name))) return 0;
+
+	tblcache_map_t *m = 0;
+	for (int i = 0; i < TBLCACHE_MAPPED; i++)
+	{
+		if (tbl_maps[i].map && tbl_maps[i].path_crc == key.path_crc && tbl_maps[i].variant == variant)
+		{
+			m = &tbl_maps[i];
+			break;
+		}
+	}
+
+	if (!m)
+	{
+		m = &tbl_maps[tbl_next];
+		tbl_next = (tbl_next + 1) % TBLCACHE_MAPPED;
+		map_release(m);
+
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/%s", getFullPath(CONFIG_DIR), name);
+
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) return 0;
+
+		struct stat64 st;
+		if (fstat64(fd, &st) < 0 || (size_t)st.st_size < sizeof(tblcache_hdr_t))
+		{
+			close(fd);
+			return 0;
+		}
+
+		void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED) return 0;
+
+		m->path_crc = key.path_crc;
+		m->variant = variant;
+		m->map = map;
+		m->map_size = st.st_size;
+	}
+
+	// source has been modified since the blob was compiled
+	if (!map_valid(m, &key))
+	{
+		map_release(m);
+		return 0;
+	}
+
+	*size = ((const tblcache_hdr_t*)m->map)->size;
+	return (const uint8_t*)m->map + sizeof(tblcache_hdr_t);
+}
+
+void tblcache_put(const char *src, uint32_t variant, const void *data, uint32_t size)
+{
+	char name[64];
+	tblcache_hdr_t key;
+	if (!make_key(src, variant, &key, name, sizeof(name))) return;
+
+	// drop the stale mapping, it gets remapped on next get
+	for (int i = 0; i < TBLCACHE_MAPPED; i++)
+	{
+		if (tbl_maps[i].map && tbl_maps[i].path_crc == key.path_crc && tbl_maps[i].variant == variant) map_release(&tbl_maps[i]);
+	}
+
+	uint8_t *buf = (uint8_t*)malloc(sizeof(tblcache_hdr_t) + size);
+	if (!buf) return;
+
+	key.size = size;
+	memcpy(buf, &key, sizeof(tblcache_hdr_t));
+	if (size) memcpy(buf + sizeof(tblcache_hdr_t), data, size);
+
+	FileSaveConfig(name, buf, sizeof(tblcache_hdr_t) + size);
+	free(buf);
+}
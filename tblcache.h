@@ -0,0 +1,14 @@
+#ifndef TBLCACHE_H
+#define TBLCACHE_H
+
+#include <inttypes.h>
+
+// Compiled tables (filter phases, gamma curves, shadow masks) stored in config/tblcache.
+// A blob is valid while the source text file keeps its size and mtime. Variant separates
+// several blobs compiled from the same source (e.g. per resolution).
+
+// Returned data stays valid until the next tblcache_get() call.
+const void *tblcache_get(const char *src, uint32_t variant, uint32_t *size);
+void tblcache_put(const char *src, uint32_t variant, const void *data, uint32_t size);
+
+#endif
@@ -0,0 +1,93 @@
+// Randomised checks of the table driven GCR codec against the original
+// per byte encoder (bin2gcr) and the VICE derived decoder (gcr2bin),
+// plus lossless encode/decode round trips.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "support/c64/c64_gcr.h"
+
+#define MAX_LEN 1024
+
+// original encoder, 4 bytes are collected into a 40 bit word
+static void ref_encode(const uint8_t *bin, int len, uint8_t *gcrptr)
+{
+	uint64_t gcr = 0;
+	for (int i = 0; i < len; i++)
+	{
+		gcr <<= 5;
+		gcr |= gcr_lut[(bin[i] >> 4) & 0xF];
+		gcr <<= 5;
+		gcr |= gcr_lut[bin[i] & 0xF];
+
+		if ((i & 3) == 3)
+		{
+			*gcrptr++ = (uint8_t)(gcr >> 32);
+			*gcrptr++ = (uint8_t)(gcr >> 24);
+			*gcrptr++ = (uint8_t)(gcr >> 16);
+			*gcrptr++ = (uint8_t)(gcr >> 8);
+			*gcrptr++ = (uint8_t)(gcr);
+		}
+	}
+}
+
+// original decoder from VICE, one 5 byte group
+static void ref_decode(const uint8_t *gcr, uint8_t *bin)
+{
+	uint32_t tmp = *gcr;
+	tmp <<= 13;
+
+	for (int i = 5; i < 13; i += 2, bin++)
+	{
+		gcr++;
+		tmp |= ((uint32_t)(*gcr)) << i;
+		*bin = bin_lut[(tmp >> 16) & 0x1f] << 4;
+		tmp <<= 5;
+		*bin |= bin_lut[(tmp >> 16) & 0x1f];
+		tmp <<= 5;
+	}
+}
+
+int main()
+{
+	static uint8_t bin[MAX_LEN], out[MAX_LEN], ref[MAX_LEN];
+	static uint8_t gcr[MAX_LEN / 4 * 5], gcr_ref[MAX_LEN / 4 * 5];
+	int failed = 0;
+
+	srand(1);
+	gcr_init_lut();
+
+	for (int iter = 0; iter < 20000 && failed < 10; iter++)
+	{
+		int len = ((rand() % (MAX_LEN / 4)) + 1) * 4;
+		for (int i = 0; i < len; i++) bin[i] = rand();
+
+		uint8_t *end = gcr_encode(bin, len, gcr);
+		ref_encode(bin, len, gcr_ref);
+		if (end != gcr + len / 4 * 5 || memcmp(gcr, gcr_ref, len / 4 * 5))
+		{
+			printf("FAIL: encode, len %d\n", len);
+			failed++;
+		}
+
+		gcr_decode(gcr, len, out);
+		if (memcmp(bin, out, len))
+		{
+			printf("FAIL: round trip, len %d\n", len);
+			failed++;
+		}
+
+		// arbitrary GCR, invalid codes included
+		for (int i = 0; i < len / 4 * 5; i++) gcr[i] = rand();
+		gcr_decode(gcr, len, out);
+		for (int i = 0; i < len / 4; i++) ref_decode(gcr + i * 5, ref + i * 4);
+		if (memcmp(out, ref, len))
+		{
+			printf("FAIL: decode, len %d\n", len);
+			failed++;
+		}
+	}
+
+	printf("c64_gcr: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
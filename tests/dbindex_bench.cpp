@@ -0,0 +1,210 @@
+// Builds the index of a generated 10k-line N64 database and times MD5 and
+// cart ID lookups through dbindex_find. All results are checked against a
+// linear scan of the text.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "dbindex.h"
+#include "file_io.h"
+
+#define LINES 10000
+
+// file_io stubs, config/ lives in a temporary directory
+static char tmp_dir[] = "/tmp/dbindex_benchXXXXXX";
+
+fileTextReader::fileTextReader() : size(0), buffer(0), pos(0) {}
+fileTextReader::~fileTextReader() { free(buffer); buffer = 0; }
+
+bool FileOpenTextReader(fileTextReader *reader, const char *path)
+{
+	reader->~fileTextReader();
+	FILE *f = fopen(path, "rb");
+	if (!f) return false;
+	fseek(f, 0, SEEK_END);
+	reader->size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	reader->buffer = (char*)calloc(1, reader->size + 1);
+	reader->pos = reader->buffer;
+	bool ok = fread(reader->buffer, 1, reader->size, f) == reader->size;
+	fclose(f);
+	return ok;
+}
+
+const char *FileReadLine(fileTextReader *reader)
+{
+	const char *end = reader->buffer + reader->size;
+	while (reader->pos < end)
+	{
+		char *st = reader->pos;
+		while (reader->pos < end && *reader->pos && *reader->pos != '\n' && *reader->pos != '\r') reader->pos++;
+		*reader->pos = 0;
+		while (*st == ' ' || *st == '\t' || *st == '\r' || *st == '\n') st++;
+		if (*st == '#' || *st == ';' || !*st) reader->pos++;
+		else return st;
+	}
+	return nullptr;
+}
+
+const char *getFullPath(const char *name)
+{
+	static char path[1024];
+	if (name[0] == '/') snprintf(path, sizeof(path), "%s", name);
+	else snprintf(path, sizeof(path), "%s/%s", tmp_dir, name);
+	return path;
+}
+
+int FileSaveConfig(const char *name, void *pBuffer, int size)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/" CONFIG_DIR, tmp_dir);
+	mkdir(path, 0755);
+	strcat(path, "/dbindex");
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/" CONFIG_DIR "/%s", tmp_dir, name);
+	FILE *f = fopen(path, "wb");
+	if (!f) return 0;
+	int ok = fwrite(pBuffer, 1, size, f) == (size_t)size;
+	fclose(f);
+	return ok;
+}
+
+static double now_ms()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec * 1000.0 + tp.tv_nsec / 1000000.0;
+}
+
+struct result_t
+{
+	const char *key;
+	std::string line;
+	int calls;
+};
+
+static bool first_md5(const char *line, void *user)
+{
+	result_t *r = (result_t*)user;
+	r->calls++;
+	r->line = line;
+	return true;
+}
+
+static bool first_cartid(const char *line, void *user)
+{
+	result_t *r = (result_t*)user;
+	r->calls++;
+	for (int i = 0; i < 4; i++) if (line[3 + i] != '_' && line[3 + i] != r->key[i]) return false;
+	r->line = line;
+	return true;
+}
+
+int main()
+{
+	if (!mkdtemp(tmp_dir)) return 1;
+
+	srand(1);
+	std::vector<std::string> md5s, ids, lines;
+	for (int i = 0; i < LINES; i++)
+	{
+		char line[128];
+		if (i % 5)
+		{
+			char md5[33];
+			for (int j = 0; j < 32; j++) md5[j] = "0123456789abcdef"[rand() & 15];
+			md5[32] = 0;
+			md5s.push_back(md5);
+			snprintf(line, sizeof(line), "%s eeprom4k|ntsc|cic6102 # game %d", md5, i);
+		}
+		else
+		{
+			char id[5];
+			for (int j = 0; j < 4; j++) id[j] = (j == 3 && (rand() & 1)) ? '_' : 'A' + (rand() % 26);
+			id[4] = 0;
+			ids.push_back(id);
+			snprintf(line, sizeof(line), "ID:%s sram256k|pal # game %d", id, i);
+		}
+		lines.push_back(line);
+	}
+
+	std::string db = std::string(tmp_dir) + "/N64-database.txt";
+	FILE *f = fopen(db.c_str(), "w");
+	if (!f) return 1;
+	for (auto &l : lines) fprintf(f, "%s\n", l.c_str());
+	fclose(f);
+
+	int failed = 0;
+
+	double t = now_ms();
+	result_t r = { md5s[0].c_str(), "", 0 };
+	dbindex_find(db.c_str(), DBI_N64, DBK_MD5, md5s[0].c_str(), first_md5, &r);
+	printf("dbindex: index build and first lookup %.2f ms\n", now_ms() - t);
+
+	std::vector<const std::string*> keys;
+	std::vector<std::string> found;
+	for (int i = 0; i < LINES; i++) keys.push_back(&md5s[rand() % md5s.size()]);
+
+	t = now_ms();
+	for (auto key : keys)
+	{
+		r = { key->c_str(), "", 0 };
+		dbindex_find(db.c_str(), DBI_N64, DBK_MD5, key->c_str(), first_md5, &r);
+		found.push_back(r.line);
+	}
+	double t_md5 = now_ms() - t;
+
+	std::map<std::string, std::string> md5_lines;
+	for (auto &l : lines) if (l.compare(0, 3, "ID:")) md5_lines.insert({ l.substr(0, 32), l });
+	for (int i = 0; i < LINES; i++) if (found[i] != md5_lines[*keys[i]]) failed++;
+
+	std::vector<std::string> id_keys;
+	for (int i = 0; i < 1000; i++)
+	{
+		char id[5];
+		for (int j = 0; j < 4; j++) id[j] = 'A' + (rand() % 26);
+		id[4] = 0;
+		if (i & 1) memcpy(id, ids[rand() % ids.size()].c_str(), 3);
+		id_keys.push_back(id);
+	}
+
+	int preads = 0;
+	found.clear();
+	t = now_ms();
+	for (auto &id : id_keys)
+	{
+		r = { id.c_str(), "", 0 };
+		dbindex_find(db.c_str(), DBI_N64, DBK_CARTID, id.c_str(), first_cartid, &r);
+		preads += r.calls;
+		found.push_back(r.line);
+	}
+	double t_id = now_ms() - t;
+
+	for (size_t i = 0; i < id_keys.size(); i++)
+	{
+		std::string expect;
+		for (auto &l : lines)
+		{
+			if (l.compare(0, 3, "ID:")) continue;
+			int j = 0;
+			while (j < 4 && (l[3 + j] == '_' || l[3 + j] == id_keys[i][j])) j++;
+			if (j == 4) { expect = l; break; }
+		}
+		if (found[i] != expect) failed++;
+	}
+
+	printf("dbindex: %d MD5 lookups %.2f ms, 1000 cart ID lookups %.2f ms (%d lines read of %d ID lines)\n",
+		LINES, t_md5, t_id, preads, (int)ids.size());
+
+	std::string cmd = std::string("rm -rf ") + tmp_dir;
+	if (system(cmd.c_str())) {}
+
+	printf("dbindex: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+// Times a shared folder directory listing of 2000 files the old way (readdir and
+// stat per entry, as FINDFIRST/EXAMINE did) against dircache_get, cold and cached.
+// Checks the listing against readdir and that creating/deleting a file shows up.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <set>
+#include <string>
+#include "dircache.h"
+
+#define FILES 2000
+#define PASSES 50
+
+static char tmp_dir[] = "/tmp/dircache_benchXXXXXX";
+
+const char *getFullPath(const char *name)
+{
+	static char path[1024];
+	if (name[0] == '/') snprintf(path, sizeof(path), "%s", name);
+	else snprintf(path, sizeof(path), "%s/%s", tmp_dir, name);
+	return path;
+}
+
+static double now_us()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec * 1000000.0 + tp.tv_nsec / 1000.0;
+}
+
+// listing as the share servers built it before the cache
+static void old_listing(std::vector<std::string> &names)
+{
+	DIR *d = opendir(tmp_dir);
+	if (!d) return;
+
+	struct dirent64 *de;
+	while ((de = readdir64(d)))
+	{
+		char path[1024];
+		struct stat64 st;
+		snprintf(path, sizeof(path), "%s/%s", tmp_dir, de->d_name);
+		if (stat64(path, &st) < 0) continue;
+		names.push_back(de->d_name);
+	}
+
+	closedir(d);
+}
+
+static std::set<std::string> new_listing()
+{
+	std::set<std::string> names;
+	std::vector<dircache_item_t> items;
+	if (dircache_get("", items))
+	{
+		for (auto &item : items) names.insert(item.name);
+	}
+	return names;
+}
+
+static void touch(const char *name)
+{
+	FILE *f = fopen(getFullPath(name), "w");
+	if (f) fclose(f);
+}
+
+int main()
+{
+	if (!mkdtemp(tmp_dir)) return 1;
+
+	for (int i = 0; i < FILES; i++)
+	{
+		char name[64];
+		if (i & 1) snprintf(name, sizeof(name), "FILE%04d.DAT", i);
+		else snprintf(name, sizeof(name), "A longer file name %d.data", i);
+		touch(name);
+	}
+
+	int failed = 0;
+
+	std::vector<std::string> old_names;
+	double t = now_us();
+	for (int i = 0; i < PASSES; i++)
+	{
+		old_names.clear();
+		old_listing(old_names);
+	}
+	double t_old = (now_us() - t) / PASSES;
+	std::set<std::string> ref(old_names.begin(), old_names.end());
+
+	std::vector<dircache_item_t> items;
+	t = now_us();
+	dircache_get("", items);
+	double t_cold = now_us() - t;
+	if (new_listing() != ref) failed++;
+
+	t = now_us();
+	for (int i = 0; i < PASSES; i++)
+	{
+		items.clear();
+		dircache_get("", items);
+	}
+	double t_warm = (now_us() - t) / PASSES;
+	if (new_listing() != ref) failed++;
+
+	// 8.3 filter as used by FINDFIRST, "." and ".." included
+	items.clear();
+	dircache_get("", items, [](const dircache_item_t &item) { return item.name83[0] != 0; });
+	if (items.size() != FILES / 2 + 2) failed++;
+
+	// changes invalidate the cached listing
+	touch("NEW.DAT");
+	if (!new_listing().count("NEW.DAT")) failed++;
+	unlink(getFullPath("NEW.DAT"));
+	if (new_listing().count("NEW.DAT")) failed++;
+
+	printf("dircache: %d files, readdir+stat %.0f us, dircache cold %.0f us, cached %.0f us per listing\n",
+		FILES, t_old, t_cold, t_warm);
+
+	std::string cmd = std::string("rm -rf ") + tmp_dir;
+	if (system(cmd.c_str())) {}
+
+	printf("dircache: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
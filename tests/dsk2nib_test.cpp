@@ -0,0 +1,214 @@
+// Compares the cached Apple II DSK to NIB conversion with the original
+// per read conversion: random disks, write back, close with the prefill
+// still queued and short images. Run with SANITIZE=1 to check the cache
+// lifetime as well.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <functional>
+#include "file_io.h"
+#include "spi.h"
+#include "support/a2/dsk2nib_lib.h"
+
+#define DSK_SIZE  (35 * 4096)
+#define NIB_SIZE  (35 * 6656)
+
+// in-memory image and stubs for file_io, spi and offload
+static std::vector<uint8_t> image;
+static std::vector<std::function<void()>> jobs;
+
+fileTYPE::fileTYPE() { memset((void*)this, 0, sizeof(*this)); }
+fileTYPE::~fileTYPE() {}
+
+int FileSeek(fileTYPE *file, __off64_t offset, int origin)
+{
+	if (origin != SEEK_SET) return 0;
+	file->offset = offset;
+	return 1;
+}
+
+int FileReadAdv(fileTYPE *file, void *pBuffer, int length, int)
+{
+	if (file->offset >= (__off64_t)image.size()) return 0;
+	if (length > (int)(image.size() - file->offset)) length = image.size() - file->offset;
+	memcpy(pBuffer, image.data() + file->offset, length);
+	file->offset += length;
+	return length;
+}
+
+int FileWriteAdv(fileTYPE *file, void *pBuffer, int length, int)
+{
+	if (file->offset + length > (__off64_t)image.size()) image.resize(file->offset + length);
+	memcpy(image.data() + file->offset, pBuffer, length);
+	file->offset += length;
+	return length;
+}
+
+void offload_add_work(std::function<void()> work) { jobs.push_back(work); }
+int user_io_get_width() { return 0; }
+void EnableIO() {}
+void DisableIO() {}
+uint16_t fpga_spi(uint16_t) { return 0; }
+void spi_block_read(uint8_t *addr, int, int sz) { memset(addr, 0, sz); }
+void spi_block_write(const uint8_t *, int, int) {}
+
+static void run_jobs()
+{
+	for (auto &job : jobs) job();
+	jobs.clear();
+}
+
+// original conversion, one NIB track per 512 byte read
+namespace ref
+{
+	static const uint8_t table[0x40] = {
+		0x96, 0x97, 0x9a, 0x9b, 0x9d, 0x9e, 0x9f, 0xa6, 0xa7, 0xab, 0xac, 0xad, 0xae, 0xaf, 0xb2, 0xb3,
+		0xb4, 0xb5, 0xb6, 0xb7, 0xb9, 0xba, 0xbb, 0xbc, 0xbd, 0xbe, 0xbf, 0xcb, 0xcd, 0xce, 0xcf, 0xd3,
+		0xd6, 0xd7, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf, 0xe5, 0xe6, 0xe7, 0xe9, 0xea, 0xeb, 0xec,
+		0xed, 0xee, 0xef, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+	};
+	static const int soft_interleave[16] = { 0, 7, 0xE, 6, 0xD, 5, 0xC, 4, 0xB, 3, 0xA, 2, 9, 1, 8, 0xF };
+	static const int phys_interleave[16] = { 0, 0xD, 0xB, 9, 7, 5, 3, 1, 0xE, 0xC, 0xA, 8, 6, 4, 2, 0xF };
+
+	static void odd_even(uint8_t *a, int i)
+	{
+		a[0] = ((i >> 1) & 0x55) | 0xaa;
+		a[1] = (i & 0x55) | 0xaa;
+	}
+
+	static void sector(const uint8_t *src, int track, int logical, uint8_t *out)
+	{
+		uint8_t *p = out;
+		memset(p, 0xff, 48); p += 48;
+		*p++ = 0xd5; *p++ = 0xaa; *p++ = 0x96;
+		odd_even(p, 254); p += 2;
+		odd_even(p, track); p += 2;
+		odd_even(p, logical); p += 2;
+		odd_even(p, 254 ^ track ^ logical); p += 2;
+		*p++ = 0xde; *p++ = 0xaa; *p++ = 0xeb;
+		memset(p, 0xff, 5); p += 5;
+		*p++ = 0xd5; *p++ = 0xaa; *p++ = 0xad;
+
+		uint8_t primary[256], secondary[86] = {};
+		for (int i = 0; i < 256; i++)
+		{
+			primary[i] = src[i] >> 2;
+			secondary[i % 86] |= (((src[i] & 2) >> 1) | ((src[i] & 1) << 1)) << ((i / 86) * 2);
+		}
+
+		*p++ = table[secondary[0] & 0x3f];
+		for (int i = 1; i < 86; i++) *p++ = table[(secondary[i] ^ secondary[i - 1]) & 0x3f];
+		*p++ = table[(primary[0] ^ secondary[85]) & 0x3f];
+		for (int i = 1; i < 256; i++) *p++ = table[(primary[i] ^ primary[i - 1]) & 0x3f];
+		*p++ = table[primary[255] & 0x3f];
+		*p++ = 0xde; *p++ = 0xaa; *p++ = 0xeb;
+	}
+
+	static void read(uint64_t offset, uint8_t *out)
+	{
+		int track = offset / 6656;
+		int track_offset = offset % 6656;
+		memset(out, 0, 512);
+		if (track >= 35) return;
+
+		uint8_t nib[6656];
+		for (int phys = 0; phys < 16; phys++)
+		{
+			int logical = 0;
+			for (int i = 0; i < 16; i++) if (phys_interleave[i] == phys) logical = i;
+
+			uint8_t dsk[256] = {};
+			size_t pos = (size_t)track * 4096 + soft_interleave[logical] * 256;
+			if (pos < image.size()) memcpy(dsk, image.data() + pos, 256);
+			sector(dsk, track, logical, nib + phys * 416);
+		}
+
+		int len = 6656 - track_offset;
+		memcpy(out, nib + track_offset, (len > 512) ? 512 : len);
+	}
+}
+
+static int failed = 0;
+
+static void compare_disk(fileTYPE *f, const char *step)
+{
+	for (uint64_t lba = 0; lba * 512 < NIB_SIZE + 512; lba++)
+	{
+		uint8_t a[512], b[512];
+		a2_readDsk2Nib(f, lba * 512, a);
+		ref::read(lba * 512, b);
+		if (memcmp(a, b, 512))
+		{
+			printf("FAIL: %s, lba %u\n", step, (uint32_t)lba);
+			failed++;
+			return;
+		}
+	}
+}
+
+static void random_image(uint32_t size)
+{
+	image.resize(size);
+	for (auto &b : image) b = rand();
+}
+
+int main()
+{
+	srand(1);
+	fileTYPE f;
+
+	for (int disk = 0; disk < 4; disk++)
+	{
+		random_image(DSK_SIZE);
+
+		// reads ahead of the prefill encode their own tracks
+		a2_openDSK(&f);
+		compare_disk(&f, "before prefill");
+		run_jobs();
+		compare_disk(&f, "after prefill");
+
+		// write back a track with new data, NIB stream from the reference encoder
+		int track = rand() % 35;
+		std::vector<uint8_t> dsk(image.begin() + track * 4096, image.begin() + (track + 1) * 4096);
+		for (auto &b : dsk) b = rand();
+		uint8_t nib[6656];
+		for (int phys = 0; phys < 16; phys++)
+		{
+			int logical = 0;
+			for (int i = 0; i < 16; i++) if (ref::phys_interleave[i] == phys) logical = i;
+			ref::sector(dsk.data() + ref::soft_interleave[logical] * 256, track, logical, nib + phys * 416);
+		}
+
+		for (uint32_t pos = 0; pos < sizeof(nib); pos += 512)
+		{
+			uint8_t chunk[512] = {};
+			memcpy(chunk, nib + pos, (sizeof(nib) - pos > 512) ? 512 : sizeof(nib) - pos);
+			a2_writeNib2Dsk(&f, (uint64_t)track * 6656 + pos, chunk);
+		}
+
+		if (memcmp(image.data() + track * 4096, dsk.data(), 4096))
+		{
+			printf("FAIL: track %d not written back\n", track);
+			failed++;
+		}
+		compare_disk(&f, "after write");
+
+		// closing with the prefill still queued, the job owns the cache until it runs
+		a2_openDSK(&f);
+		a2_closeDSK(&f);
+		compare_disk(&f, "after close");
+		run_jobs();
+	}
+
+	// short image reads as zeros past its end
+	random_image(DSK_SIZE / 3 & ~255);
+	a2_openDSK(&f);
+	run_jobs();
+	compare_disk(&f, "short image");
+	a2_closeDSK(&f);
+
+	printf("dsk2nib: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
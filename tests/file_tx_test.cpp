@@ -0,0 +1,137 @@
+// Streams files through file_tx_send and file_tx_ddr with the real offload thread:
+// 3MB from a non-zero offset must arrive intact, the hook must see contiguous
+// positions, and short reads must stop cleanly with the byte count sent.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "file_io.h"
+#include "file_tx.h"
+#include "offload.h"
+
+#define TX_SIZE  (3 * 1024 * 1024)
+#define TX_START 12345
+
+// in-memory file, or a real one for the pread path of file_tx_ddr
+static std::vector<uint8_t> image;
+static std::vector<uint8_t> sent;
+
+fileTYPE::fileTYPE() { memset((void*)this, 0, sizeof(*this)); }
+fileTYPE::~fileTYPE() {}
+
+int FileSeek(fileTYPE *file, __off64_t offset, int origin)
+{
+	if (origin != SEEK_SET) return 0;
+	if (file->filp && fseeko(file->filp, offset, SEEK_SET)) return 0;
+	file->offset = offset;
+	return 1;
+}
+
+int FileReadAdv(fileTYPE *file, void *pBuffer, int length, int failres)
+{
+	int ret;
+	if (file->filp)
+	{
+		ret = fread(pBuffer, 1, length, file->filp);
+	}
+	else
+	{
+		if (file->offset >= (__off64_t)image.size()) return failres;
+		ret = ((__off64_t)image.size() - file->offset < length) ? image.size() - file->offset : length;
+		memcpy(pBuffer, image.data() + file->offset, ret);
+	}
+	file->offset += ret;
+	return ret;
+}
+
+void user_io_file_tx_data(const uint8_t *addr, uint32_t len) { sent.insert(sent.end(), addr, addr + len); }
+void ProgressMessage(const char*, const char*, int, int) {}
+
+static int failed = 0;
+
+static void expect(int ok, const char *what)
+{
+	if (!ok)
+	{
+		printf("FAIL: %s\n", what);
+		failed++;
+	}
+}
+
+struct hook_check_t
+{
+	uint32_t next = 0;
+	int gaps = 0;
+
+	file_tx_hook_t hook()
+	{
+		return [this](uint8_t *buf, uint32_t pos, uint32_t len)
+		{
+			if (pos != next) gaps++;
+			next = pos + len;
+			for (uint32_t i = 0; i < len; i++) buf[i] ^= 0xA5;
+		};
+	}
+};
+
+static int same_xor(const uint8_t *a, const uint8_t *b, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++) if (a[i] != (b[i] ^ 0xA5)) return 0;
+	return 1;
+}
+
+int main()
+{
+	offload_start();
+
+	srand(1);
+	image.resize(TX_START + TX_SIZE);
+	for (auto &b : image) b = rand();
+
+	fileTYPE f;
+	f.size = image.size();
+
+	// download over the bus
+	hook_check_t chk;
+	FileSeek(&f, TX_START, SEEK_SET);
+	uint32_t res = file_tx_send(&f, TX_SIZE, chk.hook());
+	expect(res == TX_SIZE && sent.size() == TX_SIZE, "file_tx_send size");
+	expect(sent.size() == TX_SIZE && same_xor(sent.data(), image.data() + TX_START, TX_SIZE), "file_tx_send data");
+	expect(!chk.gaps && chk.next == TX_SIZE, "file_tx_send hook positions");
+
+	// short read, 1MB more than the file holds
+	sent.clear();
+	FileSeek(&f, TX_START, SEEK_SET);
+	res = file_tx_send(&f, TX_SIZE + 1024 * 1024);
+	expect(res == TX_SIZE && sent.size() == TX_SIZE, "file_tx_send short read");
+
+	// DDR load through pread from a real file
+	char path[] = "/tmp/file_tx_testXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0 || write(fd, image.data(), image.size()) != (ssize_t)image.size()) return 1;
+	close(fd);
+
+	std::vector<uint8_t> ddr(TX_SIZE + 1024 * 1024);
+	f.filp = fopen(path, "rb");
+	if (!f.filp) return 1;
+
+	hook_check_t chk_ddr;
+	FileSeek(&f, TX_START, SEEK_SET);
+	res = file_tx_ddr(&f, ddr.data(), TX_SIZE, chk_ddr.hook());
+	expect(res == TX_SIZE && same_xor(ddr.data(), image.data() + TX_START, TX_SIZE), "file_tx_ddr data");
+	expect(!chk_ddr.gaps && chk_ddr.next == TX_SIZE, "file_tx_ddr hook positions");
+	expect(f.offset == TX_START + TX_SIZE, "file_tx_ddr file position");
+
+	FileSeek(&f, TX_START, SEEK_SET);
+	res = file_tx_ddr(&f, ddr.data(), TX_SIZE + 1024 * 1024);
+	expect(res == TX_SIZE, "file_tx_ddr short read");
+
+	fclose(f.filp);
+	unlink(path);
+	offload_stop();
+
+	printf("file_tx: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+// Checks the Neo Geo ROM conversion kernels against the plain index formulas.
+// make test runs the scalar paths only. The NEON block paths are covered by the
+// ARM build from make test_arm, run under qemu-arm or on the board.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "support/neogeo/neogeo_kernels.h"
+
+static int failed = 0;
+
+static void check(const char *name, uint32_t size, const void *a, const void *b, uint32_t bytes)
+{
+	if (memcmp(a, b, bytes))
+	{
+		printf("FAIL: %s, size %u\n", name, size);
+		failed++;
+	}
+}
+
+static void fill(void *buf, uint32_t bytes)
+{
+	for (uint32_t i = 0; i < bytes; i++) ((uint8_t*)buf)[i] = rand();
+}
+
+int main()
+{
+	static uint16_t in16[8192], out16[8192], ref16[8192];
+	static uint32_t in32[4096], ref32[4096];
+
+	srand(1);
+
+	// whole blocks, odd tails and tail-only sizes
+	static const uint32_t sizes[] = { 0, 1, 2, 31, 32, 33, 63, 64, 65, 127, 1000, 4096, 8191, 8192 };
+	for (int iter = 0; iter < 20; iter++)
+	{
+		for (uint32_t size : sizes)
+		{
+			fill(in16, sizeof(in16));
+
+			spr_convert(in16, out16, size);
+			for (uint32_t i = 0; i < size; i++) ref16[i] = in16[(i & ~0x1F) | ((i >> 1) & 0xF) | (((i & 1) ^ 1) << 4)];
+			check("spr_convert", size, out16, ref16, size * 2);
+
+			spr_convert_dbl(in16, out16, size);
+			for (uint32_t i = 0; i < size; i++) ref16[i] = in16[(i & ~0x3F) | ((i ^ 1) & 1) | ((i >> 1) & 0x1E) | (((i & 2) ^ 2) << 4)];
+			check("spr_convert_dbl", size, out16, ref16, size * 2);
+
+			uint8_t *in8 = (uint8_t*)in16, *out8 = (uint8_t*)out16, *ref8 = (uint8_t*)ref16;
+			fix_convert(in8, out8, size);
+			for (uint32_t i = 0; i < size; i++) ref8[i] = in8[(i & ~0x1F) | ((i >> 2) & 7) | ((i & 1) << 3) | (((i & 2) << 3) ^ 0x10)];
+			check("fix_convert", size, out8, ref8, size);
+
+			uint32_t size32 = size / 2;
+			fill(in32, sizeof(in32));
+			for (uint32_t i = 0; i < size32; i++) ref32[i] = (in32[i] & 0xFF0000FF) | ((in32[i] & 0xFF00) << 8) | ((in32[i] & 0xFF0000) >> 8);
+			spr_bswap(in32, size32);
+			check("spr_bswap", size32, in32, ref32, size32 * 4);
+		}
+	}
+
+#ifdef __ARM_NEON
+	printf("neogeo_kernels: NEON and scalar paths checked\n");
+#else
+	printf("neogeo_kernels: scalar paths checked, NEON needs the ARM build\n");
+#endif
+	printf("neogeo_kernels: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
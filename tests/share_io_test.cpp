@@ -0,0 +1,118 @@
+// Reads a 1MB file through the share read-ahead in 7000 byte requests, with a
+// seek in the middle, and counts the reads reaching the file. Then writes
+// through a second handle of the same file and checks the read-ahead is dropped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <functional>
+#include "file_io.h"
+#include "share_io.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define REQ_SIZE  7000
+
+static int file_reads = 0;
+
+// file_io and offload stubs on a real file
+fileTYPE::fileTYPE() { memset((void*)this, 0, sizeof(*this)); }
+fileTYPE::~fileTYPE() {}
+
+int FileSeek(fileTYPE *file, __off64_t offset, int origin)
+{
+	if (origin != SEEK_SET || fseeko(file->filp, offset, SEEK_SET)) return 0;
+	file->offset = offset;
+	return 1;
+}
+
+int FileReadAdv(fileTYPE *file, void *pBuffer, int length, int failres)
+{
+	file_reads++;
+	int ret = fread(pBuffer, 1, length, file->filp);
+	if (ret < 0) return failres;
+	file->offset += ret;
+	return ret;
+}
+
+void offload_add_work(std::function<void()> work) { work(); }
+
+static int failed = 0;
+
+static void read_all(fileTYPE *f, const std::vector<uint8_t> &ref, uint32_t start)
+{
+	uint8_t buf[REQ_SIZE];
+	FileSeek(f, start, SEEK_SET);
+	for (uint32_t pos = start; pos < FILE_SIZE; pos += REQ_SIZE)
+	{
+		int len = share_ra_read(f, buf, REQ_SIZE);
+		int expect = (FILE_SIZE - pos < REQ_SIZE) ? FILE_SIZE - pos : REQ_SIZE;
+		if (len != expect || memcmp(buf, ref.data() + pos, len))
+		{
+			printf("FAIL: read at %u\n", pos);
+			failed++;
+			return;
+		}
+
+		// the response is posted, read-ahead runs while the guest consumes it
+		share_ra_fill();
+	}
+}
+
+int main()
+{
+	char path[] = "/tmp/share_io_testXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) return 1;
+
+	srand(1);
+	std::vector<uint8_t> ref(FILE_SIZE);
+	for (auto &b : ref) b = rand();
+	if (write(fd, ref.data(), FILE_SIZE) != FILE_SIZE) return 1;
+	close(fd);
+
+	fileTYPE f, g;
+	f.filp = fopen(path, "rb");
+	g.filp = fopen(path, "r+b");
+	if (!f.filp || !g.filp) return 1;
+
+	// unbuffered, stdio would keep its own stale copy across handles
+	setvbuf(f.filp, NULL, _IONBF, 0);
+	setvbuf(g.filp, NULL, _IONBF, 0);
+	f.size = g.size = FILE_SIZE;
+
+	// sequential from the start, then again from the middle after a seek
+	read_all(&f, ref, 0);
+	read_all(&f, ref, FILE_SIZE / 2 + 123);
+	int reads = file_reads;
+	int requests = (FILE_SIZE + REQ_SIZE - 1) / REQ_SIZE + (FILE_SIZE / 2 - 123 + REQ_SIZE - 1) / REQ_SIZE;
+
+	// data read ahead after two sequential requests, then changed through the other handle
+	uint8_t buf[REQ_SIZE];
+	FileSeek(&f, 0, SEEK_SET);
+	share_ra_read(&f, buf, REQ_SIZE);
+	share_ra_read(&f, buf, REQ_SIZE);
+	share_ra_fill();
+
+	memset(ref.data() + 2 * REQ_SIZE, 0x5A, REQ_SIZE);
+	FileSeek(&g, 2 * REQ_SIZE, SEEK_SET);
+	fwrite(ref.data() + 2 * REQ_SIZE, 1, REQ_SIZE, g.filp);
+	fflush(g.filp);
+	share_ra_drop(&g);
+
+	if (share_ra_read(&f, buf, REQ_SIZE) != REQ_SIZE || memcmp(buf, ref.data() + 2 * REQ_SIZE, REQ_SIZE))
+	{
+		printf("FAIL: stale read-ahead after a write through another handle\n");
+		failed++;
+	}
+
+	share_ra_drop();
+	fclose(f.filp);
+	fclose(g.filp);
+	unlink(path);
+
+	printf("share_io: %d requests of %d bytes, %d file reads\n", requests, REQ_SIZE, reads);
+	printf("share_io: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
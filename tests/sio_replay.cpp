@@ -0,0 +1,153 @@
+// Replays an SIO wait trace (make SIOTRACE=1 writes /tmp/sio_trace.txt) through
+// the scheduler with the old yield-and-spin wait of atari800.cpp and with
+// scheduler_wait_until, alternating per wait so both see the same system load.
+// Reports how late the waits return and the CPU time they burn, the UI task is
+// a stub busy for 0.3-2.5 ms a pass.
+//
+// usage: sio_replay [trace], default tests/data/sio_atx_read.txt
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include "scheduler.h"
+
+struct sio_wait_t
+{
+	uint64_t gap;
+	uint64_t wait;
+};
+
+static std::vector<sio_wait_t> trace;
+static uint64_t ui_cpu_us = 0;
+
+static uint64_t get_us()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_BOOTTIME, &tp);
+	return (uint64_t)tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+}
+
+static uint64_t cpu_us()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tp);
+	return (uint64_t)tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+}
+
+// stubs for the tasks run by the scheduler
+void HandleUI(void)
+{
+	uint64_t start = get_us();
+	uint64_t cpu = cpu_us();
+	uint64_t len = 300 + rand() % 2200;
+	while (get_us() - start < len) {}
+	ui_cpu_us += cpu_us() - cpu;
+}
+
+void OsdUpdate() {}
+void frame_timer() {}
+int input_poll(int) { return 0; }
+int is_fpga_ready(int) { return 1; }
+void fpga_wait_to_reset() {}
+
+// wait_us() of atari800.cpp before it used scheduler_wait_until
+static void old_wait_until(uint64_t time)
+{
+	for (;;)
+	{
+		int64_t remaining = time - get_us();
+		if (remaining >= 10000)
+		{
+			input_poll(0);
+			scheduler_yield();
+		}
+		if (remaining <= 0) break;
+	}
+}
+
+struct replay_t
+{
+	const char *name;
+	void (*wait_until)(uint64_t);
+	std::vector<uint64_t> late;
+	uint64_t wait_total;
+	uint64_t cpu_total;
+};
+
+static void replay_wait(replay_t &r, const sio_wait_t &w)
+{
+	// the rest of the poll loop runs between waits
+	uint64_t end = get_us() + w.gap;
+	while (get_us() < end) scheduler_yield();
+
+	uint64_t ui = ui_cpu_us;
+	uint64_t cpu = cpu_us();
+	uint64_t deadline = get_us() + w.wait;
+	r.wait_until(deadline);
+	uint64_t now = get_us();
+
+	r.late.push_back(now - deadline);
+	r.wait_total += w.wait;
+	r.cpu_total += cpu_us() - cpu - (ui_cpu_us - ui);
+}
+
+static void report(replay_t &r)
+{
+	std::sort(r.late.begin(), r.late.end());
+	uint64_t sum = 0;
+	for (uint64_t l : r.late) sum += l;
+
+	printf("sio_replay: %-20s late avg %5" PRIu64 " us, p99 %5" PRIu64 " us, max %5" PRIu64 " us, CPU %4.1f%% of %.2f s waited\n",
+		r.name, sum / r.late.size(), r.late[r.late.size() * 99 / 100], r.late.back(),
+		r.cpu_total * 100.0 / r.wait_total, r.wait_total / 1000000.0);
+}
+
+// runs on the poll task like the SIO handler does
+void user_io_poll()
+{
+	replay_t old_wait = { "old wait", old_wait_until, {}, 0, 0 };
+	replay_t new_wait = { "scheduler_wait_until", scheduler_wait_until, {}, 0, 0 };
+
+	for (const sio_wait_t &w : trace)
+	{
+		replay_wait(old_wait, w);
+		replay_wait(new_wait, w);
+	}
+
+	report(old_wait);
+	report(new_wait);
+	printf("sio_replay: ok\n");
+	exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = (argc > 1) ? argv[1] : "tests/data/sio_atx_read.txt";
+	FILE *f = fopen(path, "rt");
+	if (!f)
+	{
+		printf("sio_replay: can't open %s\nsio_replay: FAILED\n", path);
+		return 1;
+	}
+
+	char line[256];
+	while (fgets(line, sizeof(line), f))
+	{
+		sio_wait_t w;
+		if (line[0] != '#' && sscanf(line, "%" SCNu64 " %" SCNu64, &w.gap, &w.wait) == 2) trace.push_back(w);
+	}
+	fclose(f);
+
+	if (trace.empty())
+	{
+		printf("sio_replay: no waits in %s\nsio_replay: FAILED\n", path);
+		return 1;
+	}
+
+	srand(1);
+	scheduler_init();
+	scheduler_run();
+	return 0;
+}
@@ -0,0 +1,179 @@
+// Replays ACSI reads against a 64MB image the old way (seek and read 128 sectors
+// at a time, then send) and through acsi_read, with the SPI transfer to the ST
+// simulated at 250ns per word. Trace: one 2MB READ(10), 1000 sequential 2 sector
+// reads as GEMDOS does per cluster, 300 random reads. Checks the data of every
+// sector, that writes and image changes drop buffered sectors, and read errors.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+#include "offload.h"
+#include "support/st/st_acsi.h"
+
+#define IMG_BLOCKS (64 * 1024 * 1024 / 512)
+#define SPI_WORD_NS 250
+
+struct acsi_cmd_t
+{
+	uint32_t lba;
+	uint32_t length;
+};
+
+static int failed = 0;
+
+static uint64_t now_ns()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000000 + tp.tv_nsec;
+}
+
+// memory_write() to the ST, the data is checked instead of sent
+static void send_sectors(const uint8_t *data, uint32_t lba, uint32_t count)
+{
+	uint64_t end = now_ns() + (uint64_t)count * 256 * SPI_WORD_NS;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t tag;
+		memcpy(&tag, data + i * 512 + 508, 4);
+		if (tag != lba + i)
+		{
+			printf("FAIL: sector %u holds %u\n", lba + i, tag);
+			failed++;
+			break;
+		}
+	}
+
+	while (now_ns() < end) {}
+}
+
+static void old_read(int fd, const acsi_cmd_t &cmd)
+{
+	static uint8_t buf[128 * 512];
+	lseek(fd, (off_t)cmd.lba * 512, SEEK_SET);
+
+	uint32_t lba = cmd.lba, length = cmd.length;
+	while (length)
+	{
+		uint32_t len = (length > 128) ? 128 : length;
+		if (read(fd, buf, len * 512) != (ssize_t)len * 512) failed++;
+		send_sectors(buf, lba, len);
+		lba += len;
+		length -= len;
+	}
+}
+
+static void new_read(int fd, const acsi_cmd_t &cmd)
+{
+	uint32_t lba = cmd.lba, length = cmd.length;
+	while (length)
+	{
+		uint32_t len = (length > ACSI_CHUNK) ? ACSI_CHUNK : length;
+		uint8_t *data = acsi_read(0, fd, lba, len, IMG_BLOCKS, length > len);
+		if (!data)
+		{
+			printf("FAIL: read error at %u\n", lba);
+			failed++;
+			return;
+		}
+		send_sectors(data, lba, len);
+		lba += len;
+		length -= len;
+	}
+}
+
+static double replay(int fd, const std::vector<acsi_cmd_t> &trace, void (*rd)(int, const acsi_cmd_t &))
+{
+	uint64_t bytes = 0, t = now_ns();
+	for (auto &cmd : trace)
+	{
+		rd(fd, cmd);
+		bytes += cmd.length * 512;
+	}
+	return bytes * 1000.0 / (now_ns() - t);
+}
+
+static void write_sector(int fd, uint32_t lba, uint32_t tag)
+{
+	uint8_t sec[512] = {};
+	memcpy(sec + 508, &tag, 4);
+	if (pwrite(fd, sec, 512, (off_t)lba * 512) != 512) failed++;
+}
+
+int main()
+{
+	char path[] = "/tmp/st_acsi_benchXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) return 1;
+
+	// every sector ends with its own LBA
+	std::vector<uint8_t> chunk(2048 * 512);
+	for (uint32_t lba = 0; lba < IMG_BLOCKS; lba += 2048)
+	{
+		for (uint32_t i = 0; i < 2048; i++)
+		{
+			uint32_t tag = lba + i;
+			memcpy(chunk.data() + i * 512 + 508, &tag, 4);
+		}
+		if (write(fd, chunk.data(), chunk.size()) != (ssize_t)chunk.size()) return 1;
+	}
+
+	std::vector<acsi_cmd_t> trace;
+	trace.push_back({ 1000, 4096 });
+	for (uint32_t i = 0; i < 1000; i++) trace.push_back({ 20000 + i * 2, 2 });
+	srand(1);
+	for (int i = 0; i < 300; i++) trace.push_back({ (uint32_t)(rand() % (IMG_BLOCKS - 8)), (uint32_t)(1 + rand() % 8) });
+
+	offload_start();
+
+	double mb_old = replay(fd, trace, old_read);
+	double mb_new = replay(fd, trace, new_read);
+
+	// sectors buffered by read-ahead are replaced by a write
+	acsi_read(0, fd, 30000, 2, IMG_BLOCKS, 0);
+	acsi_read(0, fd, 30002, 2, IMG_BLOCKS, 0);
+	acsi_buf_drop(0, 30005, 1);
+	write_sector(fd, 30005, 0xC0DE);
+	uint8_t *data = acsi_read(0, fd, 30004, 2, IMG_BLOCKS, 0);
+	uint32_t tag = 0;
+	if (data) memcpy(&tag, data + 512 + 508, 4);
+	if (tag != 0xC0DE)
+	{
+		printf("FAIL: stale sector after a write\n");
+		failed++;
+	}
+
+	// another image for the same target
+	write_sector(fd, 30007, 0xBEEF);
+	acsi_buf_drop(0, 0, 0);
+	data = acsi_read(0, fd, 30007, 1, IMG_BLOCKS, 0);
+	tag = 0;
+	if (data) memcpy(&tag, data + 508, 4);
+	if (tag != 0xBEEF)
+	{
+		printf("FAIL: stale sector after an image change\n");
+		failed++;
+	}
+
+	// image shorter than the reported size
+	if (acsi_read(0, fd, IMG_BLOCKS, 1, IMG_BLOCKS + 1, 0))
+	{
+		printf("FAIL: read past the end succeeded\n");
+		failed++;
+	}
+
+	acsi_buf_drop(0, 0, 0);
+	offload_stop();
+	close(fd);
+	unlink(path);
+
+	printf("st_acsi: %d commands, old %.1f MB/s, acsi_read %.1f MB/s (SPI at %d ns per word)\n",
+		(int)trace.size(), mb_old, mb_new, SPI_WORD_NS);
+	printf("st_acsi: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
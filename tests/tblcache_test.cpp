@@ -0,0 +1,102 @@
+// Checks the compiled table cache against a source file in a temp folder:
+// miss before a put, hit with the same data after it, miss for another variant,
+// and miss after the source was modified until the blob is written again.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include "file_io.h"
+#include "tblcache.h"
+
+static char tmp_dir[] = "/tmp/tblcache_testXXXXXX";
+
+// file_io stubs on the temp folder
+const char *getFullPath(const char *name)
+{
+	static char path[1024];
+	if (name[0] == '/') snprintf(path, sizeof(path), "%s", name);
+	else snprintf(path, sizeof(path), "%s/%s", tmp_dir, name);
+	return path;
+}
+
+int FileSaveConfig(const char *name, void *pBuffer, int size)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/" CONFIG_DIR, tmp_dir);
+	mkdir(path, 0755);
+	strcat(path, "/tblcache");
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/" CONFIG_DIR "/%s", tmp_dir, name);
+
+	FILE *f = fopen(path, "wb");
+	if (!f) return 0;
+	int ret = fwrite(pBuffer, 1, size, f) == (size_t)size;
+	fclose(f);
+	return ret;
+}
+
+static int failed = 0;
+
+static void expect(int ok, const char *what)
+{
+	if (!ok)
+	{
+		printf("FAIL: %s\n", what);
+		failed++;
+	}
+}
+
+static void write_src(const char *data)
+{
+	FILE *f = fopen(getFullPath("gamma.txt"), "wb");
+	if (!f) return;
+	fputs(data, f);
+	fclose(f);
+}
+
+static int cached(uint32_t variant, const void *data, uint32_t size)
+{
+	uint32_t len = 0;
+	const void *p = tblcache_get("gamma.txt", variant, &len);
+	return p && len == size && !memcmp(p, data, size);
+}
+
+int main()
+{
+	if (!mkdtemp(tmp_dir)) return 1;
+
+	uint16_t table[256];
+	for (int i = 0; i < 256; i++) table[i] = i * 257;
+
+	uint32_t len;
+	expect(!tblcache_get("missing.txt", 0, &len), "missing source");
+
+	write_src("0 1 2 3");
+	expect(!tblcache_get("gamma.txt", 0, &len), "miss before put");
+
+	tblcache_put("gamma.txt", 0, table, sizeof(table));
+	expect(cached(0, table, sizeof(table)), "hit after put");
+	expect(cached(0, table, sizeof(table)), "hit from the kept mapping");
+	expect(!tblcache_get("gamma.txt", 240, &len), "other variant");
+
+	// second variant kept next to the first one
+	tblcache_put("gamma.txt", 240, table, 100);
+	expect(cached(240, table, 100) && cached(0, table, sizeof(table)), "two variants");
+
+	// size changes, mtime may not within the same second
+	write_src("0 1 2 3 4");
+	expect(!tblcache_get("gamma.txt", 0, &len), "modified source");
+
+	table[0] = 0x1234;
+	tblcache_put("gamma.txt", 0, table, sizeof(table));
+	expect(cached(0, table, sizeof(table)), "hit after recompile");
+
+	std::string cmd = std::string("rm -rf ") + tmp_dir;
+	if (system(cmd.c_str())) {}
+
+	printf("tblcache: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
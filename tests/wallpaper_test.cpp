@@ -0,0 +1,101 @@
+// Checks the scaled wallpaper cache: round trip, no hit for another resolution
+// or after the picture changed. Compares wallpaper_darken (NEON on ARM, scalar
+// tail) with imlib2's blend of a black layer for every channel value and alpha.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "wallpaper.h"
+#include "miniz.h"
+
+#define W 320
+#define H 240
+
+static int failed = 0;
+
+static void expect(int ok, const char *what)
+{
+	if (!ok)
+	{
+		printf("FAIL: %s\n", what);
+		failed++;
+	}
+}
+
+// BLEND_COLOR of imlib2 with black as the source color
+static uint32_t imlib_darken(uint32_t px, int a)
+{
+	uint32_t res = px & 0xFF000000;
+	for (int sh = 0; sh < 24; sh += 8)
+	{
+		int cc = (px >> sh) & 0xFF;
+		int tmp = (0 - cc) * a;
+		res |= (uint32_t)(cc + ((tmp + (tmp >> 8) + 0x80) >> 8)) << sh;
+	}
+	return res;
+}
+
+static void write_file(const char *path, const char *data)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f) return;
+	fputs(data, f);
+	fclose(f);
+}
+
+int main()
+{
+	char path[] = "/tmp/wallpaper_testXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) return 1;
+	close(fd);
+	write_file(path, "picture");
+
+	srand(1);
+	std::vector<uint32_t> img(W * H), out(W * H);
+	for (auto &px : img) px = (rand() << 16) ^ rand();
+
+	expect(!wallpaper_cache_load(path, W, H, out.data()) || out != img, "no hit before store");
+	wallpaper_cache_store(path, W, H, img.data());
+	expect(wallpaper_cache_load(path, W, H, out.data()) && out == img, "round trip");
+	expect(!wallpaper_cache_load(path, W, H - 1, out.data()), "other resolution");
+
+	// size changes, mtime may not within the same second
+	write_file(path, "another picture");
+	expect(!wallpaper_cache_load(path, W, H, out.data()), "changed picture");
+
+	// every channel value with every alpha, odd count for the scalar tail
+	std::vector<uint32_t> buf(257);
+	for (int a = 0; a < 256; a++)
+	{
+		for (int c = 0; c < 256; c++) buf[c] = 0x80000000 | (c << 16) | ((255 - c) << 8) | (c ^ 0x5A);
+		buf[256] = 0xFFFFFFFF;
+
+		std::vector<uint32_t> ref(buf.size());
+		for (size_t i = 0; i < buf.size(); i++) ref[i] = imlib_darken(buf[i], a);
+
+		wallpaper_darken(buf.data(), buf.size(), a);
+		if (buf != ref)
+		{
+			printf("FAIL: darken with alpha %d\n", a);
+			failed++;
+			break;
+		}
+	}
+
+	// slot file as named by wallpaper.cpp
+	char slot[64];
+	snprintf(slot, sizeof(slot), "/tmp/MiSTer_wallpaper%d.bin", (int)(crc32(0, (const uint8_t*)path, strlen(path)) % 4));
+	unlink(slot);
+	unlink(path);
+
+#ifdef __ARM_NEON
+	printf("wallpaper: NEON and scalar darken checked\n");
+#else
+	printf("wallpaper: scalar darken checked\n");
+#endif
+	printf("wallpaper: %s\n", failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
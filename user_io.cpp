@@ -36,6 +36,11 @@
 #include "ide.h"
 #include "ide_cdrom.h"
 #include "profiling.h"
+#include "romhash.h"
+#include "file_tx.h"
+#include "memimg.h"
+#include "sdmap.h"
+#include "blkprof.h"
 
 #include "support.h"
 
@@ -66,6 +71,7 @@ static unsigned char dual_sdr = 0;
 
 static int fio_size = 0;
 static int io_ver = 0;
+static int core_caps = 0;
 
 // keep state of caps lock
 static char caps_lock_toggle = 0;
@@ -1349,6 +1355,21 @@ int user_io_is_dualsdr()
 	return dual_sdr;
 }
 
+// cores without UIO_GET_CAPS don't answer with the signature
+static int read_core_caps()
+{
+	spi_uio_cmd_cont(UIO_GET_CAPS);
+	uint16_t res = spi_w(0);
+	DisableIO();
+
+	return ((res & 0xFF00) == UIO_CAPS_SIGNATURE) ? (res & 0xFF) : 0;
+}
+
+int user_io_get_caps()
+{
+	return core_caps;
+}
+
 int user_io_get_width()
 {
 	return fio_size;
@@ -1406,6 +1427,9 @@ void user_io_init(const char *path, const char *xml)
 
 		// send a reset
 		user_io_status_set("[0]", 1);
+
+		core_caps = read_core_caps();
+		if (core_caps) printf("Core capabilities: %02X\n", core_caps);
 	}
 	else if (core_type == CORE_TYPE_SHARPMZ)
 	{
@@ -1760,6 +1784,20 @@ void user_io_r_analog_joystick(unsigned char joystick, char valueX, char valueY)
 	}
 }
 
+// both sticks in one transaction, only for cores reporting UIO_CAP_ASTICK_PAIR
+void user_io_analog_joystick_pair(unsigned char joystick, char lX, char lY, char rX, char rY)
+{
+	uint8_t joy = (joystick > 1 || !joyswap) ? joystick : (joystick ^ 1);
+
+	if (core_type == CORE_TYPE_8BIT)
+	{
+		spi_uio_cmd8_cont(UIO_ASTICK_PAIR, joy);
+		spi_w((lY << 8) | (uint8_t)(lX));
+		spi_w((rY << 8) | (uint8_t)(rX));
+		DisableIO();
+	}
+}
+
 void user_io_digital_joystick(unsigned char joystick, uint32_t map, int newdir)
 {
 	uint8_t joy = (joystick>1 || !joyswap) ? joystick : joystick ^ 1;
@@ -2014,7 +2052,16 @@ void user_io_file_tx_data(const uint8_t *addr, uint32_t len)
 {
 	EnableFpga();
 	spi8(FIO_FILE_TX_DAT);
-	spi_write(addr, len, fio_size);
+	if (core_caps & UIO_CAP_FAST_TX)
+	{
+		// the core never stalls downloads, no need to wait for ACK on every word
+		spi_block_write(addr, fio_size, len);
+		if (fio_size && (len & 1)) spi_w(addr[len - 1]);
+	}
+	else
+	{
+		spi_write(addr, len, fio_size);
+	}
 	DisableFpga();
 }
 
@@ -2061,6 +2108,9 @@ int user_io_file_mount(const char *name, unsigned char index, char pre, int pre_
 
 	sd_image_cangrow[index] = (pre != 0);
 	sd_type[index] = SD_TYPE_DEFAULT ;
+	a2_closeDSK(&sd_image[index]);
+	sdmap_close(index);
+	blkprof_close(BLKPROF_SD(index));
 	if (len)
 	{
 		if (!ret)
@@ -2089,27 +2139,35 @@ int user_io_file_mount(const char *name, unsigned char index, char pre, int pre_
 			}
 			else
 			{
+				// compressed images are decoded into RAM and typed by their inner extension
+				char ext[16] = {};
+				const char *inner = memimg_inner_ext(name);
+				if (inner) snprintf(ext, sizeof(ext), ".%s", inner);
+				else if (len > 4) strcpy(ext, name + len - 4);
+
 				writable = FileCanWrite(name);
-				ret = FileOpenEx(&sd_image[index], name, writable ? (O_RDWR | O_SYNC) : O_RDONLY);
-				if (ret && len > 4) {
-					if (!strcasecmp(name + len - 4, ".d64")
-						|| !strcasecmp(name + len - 4, ".g64")
-						|| !strcasecmp(name + len - 4, ".d71")
-						|| !strcasecmp(name + len - 4, ".g71"))
+				if (inner) ret = memimg_open(&sd_image[index], name, &writable);
+				else ret = FileOpenEx(&sd_image[index], name, writable ? (O_RDWR | O_SYNC) : O_RDONLY);
+				if (ret && strlen(ext) == 4) {
+					if (!strcasecmp(ext, ".d64")
+						|| !strcasecmp(ext, ".g64")
+						|| !strcasecmp(ext, ".d71")
+						|| !strcasecmp(ext, ".g71"))
 					{
-						img_type = c64_openGCR(name, sd_image + index, index);
+						img_type = c64_openGCR(ext, sd_image + index, index);
 						ret = img_type < 0 ? 0 : 1;
 						sd_type[index] = SD_TYPE_C64;
 						if(!ret) FileClose(&sd_image[index]);
 					}
-					else if (!strcasecmp(name + len - 4, ".d81"))
+					else if (!strcasecmp(ext, ".d81"))
 					{
 						img_type = G64_SUPPORT_HD | G64_SUPPORT_DS;
 					}
-					else if (!strcasecmp(name + len - 4, ".dsk") && ((!strcasecmp(user_io_get_core_name(), "apple-ii") || (!strcasecmp(user_io_get_core_name(), "TK2000") )) ))
+					else if (!strcasecmp(ext, ".dsk") && ((!strcasecmp(user_io_get_core_name(), "apple-ii") || (!strcasecmp(user_io_get_core_name(), "TK2000") )) ))
 					{
 						printf("FOUND A2 DSK type\n");
 						sd_type[index] = SD_TYPE_A2;
+						a2_openDSK(&sd_image[index]);
 					}
 				}
 
@@ -2152,6 +2210,9 @@ int user_io_file_mount(const char *name, unsigned char index, char pre, int pre_
 	else
 	{
 		printf("Mount %s as %s on %d slot\n", name, writable ? "read-write" : "read-only", index);
+		// writes go through the file into the page cache, the shared mapping sees them
+		if (cfg.sd_mmap) sdmap_open(index, &sd_image[index]);
+		blkprof_open(BLKPROF_SD(index), &sd_image[index], name);
 	}
 
 	user_io_sd_set_config();
@@ -2687,14 +2748,7 @@ int user_io_file_tx(const char* name, unsigned char index, char opensave, char m
 					FileReadSec(&f, buf);
 				}
 
-				uint32_t sz = fb.size;
-				while (sz)
-				{
-					uint32_t chunk = (sz > sizeof(buf)) ? sizeof(buf) : sz;
-					FileReadAdv(&fb, buf, chunk);
-					user_io_file_tx_data(buf, chunk);
-					sz -= chunk;
-				}
+				file_tx_send(&fb, fb.size);
 				FileClose(&fb);
 			}
 			else
@@ -2735,7 +2789,6 @@ int user_io_file_tx(const char* name, unsigned char index, char opensave, char m
 	uint32_t skip = bytes2send & 0x3FF; // skip possible header up to 1023 bytes
 
 	int use_progress = 1; // (bytes2send > (1024 * 1024)) ? 1 : 0;
-	int size = bytes2send;
 	if (use_progress) ProgressMessage(0, 0, 0, 0);
 
 	if(ss_base && opensave) process_ss(name);
@@ -2753,14 +2806,7 @@ int user_io_file_tx(const char* name, unsigned char index, char opensave, char m
 			}
 			else
 			{
-				uint32_t sz = fg.size;
-				while (sz)
-				{
-					uint32_t chunk = (sz > sizeof(buf)) ? sizeof(buf) : sz;
-					FileReadAdv(&fg, buf, chunk);
-					user_io_file_tx_data(buf, chunk);
-					sz -= chunk;
-				}
+				file_tx_send(&fg, fg.size);
 				FileClose(&fg);
 			}
 		}
@@ -2775,49 +2821,76 @@ int user_io_file_tx(const char* name, unsigned char index, char opensave, char m
 		}
 	}
 
-	if (dosend && load_addr >= 0x20000000 && (load_addr + bytes2send) <= 0x40000000)
+	int use_ddr = dosend && load_addr >= 0x20000000 && (load_addr + bytes2send) <= 0x40000000;
+
+	// CRC32 is used for cheats and game ID. Hashing runs on the offload thread
+	// and is skipped entirely if the file was hashed before.
+	int do_hash = dosend && (!use_ddr || (!is_snes() && use_cheats));
+	uint64_t hash_start = f.offset + skip;
+	uint64_t hash_len = bytes2send - skip;
+	romhash_t rom_hash;
+	if (do_hash)
+	{
+		if (romhash_cache_get(name, HASH_CRC32, hash_start, hash_len, &rom_hash))
+		{
+			file_crc = rom_hash.crc;
+			do_hash = 0;
+		}
+		else
+		{
+			romhash_begin(HASH_CRC32);
+		}
+	}
+
+	if (use_ddr)
 	{
 		uint32_t map_size = bytes2send + ((is_snes() && load_addr < 0x22000000) ? 0x800000 : 0);
 		uint8_t *mem = (uint8_t *)shmem_map(fpga_mem(load_addr), map_size);
 		if (mem)
 		{
-			while (bytes2send)
-			{
-				uint32_t gap = (is_snes() && (load_addr < 0x22000000) && (load_addr + size - bytes2send) >= 0x22000000) ? 0x800000 : 0;
-
-				uint32_t chunk = (bytes2send > (256 * 1024)) ? (256 * 1024) : bytes2send;
-				FileReadAdv(&f, mem + size - bytes2send + gap, chunk);
+			// SNES leaves a gap at 0x22000000, so the load is split there
+			uint32_t part = bytes2send;
+			if (is_snes() && load_addr < 0x22000000 && load_addr + part > 0x22000000) part = 0x22000000 - load_addr;
 
-				if(!is_snes() && use_cheats) file_crc = crc32(file_crc, mem + skip + size - bytes2send, chunk - skip);
-				skip = 0;
+			uint32_t base = 0;
+			auto hook = [&](uint8_t *data, uint32_t pos, uint32_t len)
+			{
+				pos += base;
+				if (do_hash && pos + len > skip)
+				{
+					uint32_t off = (pos < skip) ? skip - pos : 0;
+					romhash_update(data + off, len - off);
+				}
+			};
 
-				if (use_progress) ProgressMessage("Loading", f.name, size - bytes2send, size);
-				bytes2send -= chunk;
+			uint32_t got = file_tx_ddr(&f, mem, part, hook, use_progress);
+			if (got == part && part < bytes2send)
+			{
+				base = part;
+				file_tx_ddr(&f, mem + part + 0x800000, bytes2send - part, hook, use_progress);
 			}
 
 			shmem_unmap(mem, map_size);
 		}
 	}
-	else
+	else if (dosend && bytes2send)
 	{
-		while (dosend && bytes2send)
+		file_tx_send(&f, bytes2send, [&](uint8_t *data, uint32_t pos, uint32_t len)
 		{
-			uint32_t chunk = (bytes2send > sizeof(buf)) ? sizeof(buf) : bytes2send;
-
-			FileReadAdv(&f, buf, chunk);
-			if (is_snes() && (snes_file == SNES_FILE_BS)) snes_patch_bs_header(&f, buf);
-			user_io_file_tx_data(buf, chunk);
-
-			if (use_progress) ProgressMessage("Loading", f.name, size - bytes2send, size);
-			bytes2send -= chunk;
-
-			if (skip >= chunk) skip -= chunk;
-			else
+			if (snes_file == SNES_FILE_BS) snes_patch_bs_header(data, pos, len, f.size);
+			if (do_hash && pos + len > skip)
 			{
-				file_crc = crc32(file_crc, buf + skip, chunk - skip);
-				skip = 0;
+				uint32_t off = (pos < skip) ? skip - pos : 0;
+				romhash_update(data + off, len - off);
 			}
-		}
+		}, use_progress);
+	}
+
+	if (do_hash)
+	{
+		romhash_end(&rom_hash);
+		romhash_cache_put(name, HASH_CRC32, hash_start, hash_len, &rom_hash);
+		file_crc = rom_hash.crc;
 	}
 
 	// check if core requests some change while downloading
@@ -3054,6 +3127,8 @@ void user_io_poll()
 	}
 
 	user_io_send_buttons(0);
+	memimg_poll();
+	blkprof_poll();
 
 	if (is_minimig())
 	{
@@ -3111,6 +3186,7 @@ void user_io_poll()
 			static uint8_t buffer[16][UIO_BUFFER_SIZE];
 			uint64_t lba = 0;
 			uint32_t blksz, blks, sz;
+			const uint8_t *mapped = 0;
 
 			if (is_uneon() && i == 3)
 			{
@@ -3188,6 +3264,9 @@ void user_io_poll()
 				blks = 1;
 			}
 			DisableIO();
+
+			// block profile latency covers the file access only, not the SPI transfer
+			uint64_t prof_t = blkprof_time();
 			if ( sd_type[disk] == SD_TYPE_A2)
 			{
 				//if (op) printf("A2 %x %llu on %d\n", op,lba, disk);
@@ -3220,6 +3299,7 @@ void user_io_poll()
 				spi_w(UIO_SECTOR_WR | ack);
 				spi_block_read(buffer[disk], fio_size, sz);
 				DisableIO();
+				prof_t = blkprof_time();
 
 				if (sd_image[disk].type == 2 && !lba)
 				{
@@ -3252,10 +3332,29 @@ void user_io_poll()
 								sz = (rem >= sz) ? sz : (int)rem;
 							}
 
-							if (sz) FileWriteAdv(&sd_image[disk], buffer[disk], sz);
+							if (sz)
+							{
+								__off64_t old_size = sd_image[disk].size;
+								FileWriteAdv(&sd_image[disk], buffer[disk], sz);
+								if (sd_image[disk].size > old_size) sdmap_resize(disk, sd_image[disk].size);
+							}
 						}
 					}
 				}
+
+				blkprof_access(BLKPROF_SD(disk), lba * blksz, sz, 1, prof_t);
+			}
+			else if ((op & 1) && sd_image[disk].type != 2 && !(is_psx() && blksz == 2352) && !(is_cdi() && blksz == CDI_CDIC_BUFFER_SIZE) &&
+				(mapped = sdmap_get(disk, lba * blksz, sz)))
+			{
+				// send directly from the page cache, no copy into the sector buffer
+				blkprof_access(BLKPROF_SD(disk), lba * blksz, sz, 0, prof_t);
+
+				diskled_on();
+				EnableIO();
+				spi_w(UIO_SECTOR_RD | ack);
+				spi_block_write(mapped, fio_size, sz);
+				DisableIO();
 			}
 			else if (op & 1)
 			{
@@ -3352,6 +3451,8 @@ void user_io_poll()
 					done = 1;
 				}
 
+				blkprof_access(BLKPROF_SD(disk), lba * blksz, sz, 0, prof_t);
+
 				// data is now stored in buffer. send it to fpga
 				EnableIO();
 				spi_w(UIO_SECTOR_RD | ack);
@@ -75,6 +75,12 @@
 #define UIO_SET_YC_PAR  0x41
 #define UIO_GET_FR_CNT  0x42  // get frame counter
 #define UIO_GET_F12_MOD 0x43  // get framework menu key modifier
+#define UIO_GET_CAPS    0x45  // core capabilities: UIO_CAPS_SIGNATURE | UIO_CAP_* bits
+#define UIO_ASTICK_PAIR 0x46  // left and right analog stick of one player: index, left Y:X, right Y:X
+
+#define UIO_CAPS_SIGNATURE 0xCA00
+#define UIO_CAP_FAST_TX    0x01  // FIO_FILE_TX_DAT is never stalled (no ioctl_wait), sent without ACK handshake
+#define UIO_CAP_ASTICK_PAIR 0x02 // UIO_ASTICK_PAIR is supported
 
 // codes as used by 8bit for file loading from OSD
 #define FIO_FILE_TX     0x53
@@ -211,6 +217,7 @@ int user_io_get_joy_transl();
 void user_io_digital_joystick(unsigned char, uint32_t, int);
 void user_io_l_analog_joystick(unsigned char, char, char);
 void user_io_r_analog_joystick(unsigned char, char, char);
+void user_io_analog_joystick_pair(unsigned char, char, char, char, char);
 void user_io_set_joyswap(int swap);
 int user_io_get_joyswap();
 char user_io_osd_is_visible();
@@ -231,6 +238,7 @@ void user_io_set_upload(unsigned char enable, int addr = 0);
 void user_io_file_rx_data(uint8_t *addr, uint32_t len);
 void user_io_file_info(const char *ext);
 int user_io_get_width();
+int user_io_get_caps();
 
 void user_io_check_reset(unsigned short modifiers, char useKeys);
 
@@ -26,12 +26,23 @@
 #include "str_util.h"
 #include "profiling.h"
 #include "offload.h"
+#include "wallpaper.h"
+#include "tblcache.h"
 
 #include "support.h"
 #include "support/arcade/mra_loader.h"
 #include "lib/imlib2/Imlib2.h"
 #include "lib/md5/md5.h"
 
+#ifdef MISTER_SIM
+// host builds have no MiSTer_fb driver, its device and mode parameter are plain files
+#define FB_DEV      "/tmp/MiSTer_sim_fb0"
+#define FB_MODE_PAR "/tmp/MiSTer_sim_fb_mode"
+#else
+#define FB_DEV      "/dev/fb0"
+#define FB_MODE_PAR "/sys/module/MiSTer_fb/parameters/mode"
+#endif
+
 #define FB_SIZE  (1920*1080)
 #define FB_ADDR  (0x20000000 + (32*1024*1024)) // 512mb + 32mb(Core's fb)
 
@@ -335,6 +346,13 @@ struct VideoFilter
 
 static VideoFilter scaler_flt_data[4];
 
+// compiled form kept in tblcache
+struct VideoFilterBlob
+{
+	int valid;
+	VideoFilter flt;
+};
+
 static bool scale_phases(FilterPhase out_phases[N_PHASES], FilterPhase *in_phases, int in_count)
 {
 	if (!in_count)
@@ -375,6 +393,15 @@ static bool read_video_filter(int type, VideoFilter *out)
 	static char filename[1024];
 	snprintf(filename, sizeof(filename), COEFF_DIR"/%s", scaler_flt[type].filename);
 
+	uint32_t blob_size = 0;
+	const VideoFilterBlob *blob = (const VideoFilterBlob*)tblcache_get(filename, 0, &blob_size);
+	if (blob && blob_size == sizeof(VideoFilterBlob))
+	{
+		memcpy(out, &blob->flt, sizeof(VideoFilter));
+		printf("Filter \'%s\' (compiled), adaptive: %s\n", scaler_flt[type].filename, out->is_adaptive ? "true" : "false");
+		return blob->valid;
+	}
+
 	if (FileOpenTextReader(&reader, filename))
 	{
 		const char *line;
@@ -448,6 +475,11 @@ static bool read_video_filter(int type, VideoFilter *out)
 	MD5Update(&ctx, (unsigned char *)out->adaptive_phases, sizeof(VideoFilter::adaptive_phases));
 	MD5Final(out->digest.md5, &ctx);
 
+	static VideoFilterBlob new_blob;
+	new_blob.valid = valid;
+	memcpy(&new_blob.flt, out, sizeof(VideoFilter));
+	tblcache_put(filename, 0, &new_blob, sizeof(new_blob));
+
 	return valid;
 }
 
@@ -682,47 +714,84 @@ static char active_gamma_cfg[1024] = { 0 };
 static char gamma_cfg[1024] = { 0 };
 static char has_gamma = 0; // set in video_init
 
+// Words for UIO_SET_GAMCURV in the order they are sent, compiled from the text file.
+static int compile_gamma(const char *filename, uint16_t *words)
+{
+	fileTextReader reader = {};
+	if (!FileOpenTextReader(&reader, filename)) return -1;
+
+	const char *line;
+	int index = 0;
+	while ((line = FileReadLine(&reader)))
+	{
+		int c0, c1, c2;
+		int n = sscanf(line, "%d,%d,%d", &c0, &c1, &c2);
+		if (n == 1)
+		{
+			c1 = c0;
+			c2 = c0;
+			n = 3;
+		}
+
+		if (n == 3)
+		{
+			*words++ = (index << 8) | (c0 & 0xFF);
+			*words++ = (index << 8) | (c1 & 0xFF);
+			*words++ = (index << 8) | (c2 & 0xFF);
+
+			index++;
+			if (index >= 256) break;
+		}
+	}
+
+	return index * 3;
+}
+
 static void setGamma()
 {
 	PROFILE_FUNCTION();
 
 	if (!memcmp(active_gamma_cfg, gamma_cfg, sizeof(gamma_cfg))) return;
 
-	fileTextReader reader = {};
 	static char filename[1024];
+	static uint16_t words[256 * 3];
+	static VideoFilterDigest sent_digest;
 
 	if (!has_gamma) return;
 
 	snprintf(filename, sizeof(filename), GAMMA_DIR"/%s", gamma_cfg + 1);
 
-	if (FileOpenTextReader(&reader, filename))
+	int count = -1;
+	uint32_t blob_size = 0;
+	const uint16_t *blob = (const uint16_t*)tblcache_get(filename, 0, &blob_size);
+	if (blob && blob_size <= sizeof(words))
 	{
-		spi_uio_cmd_cont(UIO_SET_GAMCURV);
-
-		const char *line;
-		int index = 0;
-		while ((line = FileReadLine(&reader)))
-		{
-			int c0, c1, c2;
-			int n = sscanf(line, "%d,%d,%d", &c0, &c1, &c2);
-			if (n == 1)
-			{
-				c1 = c0;
-				c2 = c0;
-				n = 3;
-			}
+		count = blob_size / 2;
+		memcpy(words, blob, blob_size);
+	}
+	else
+	{
+		count = compile_gamma(filename, words);
+		if (count >= 0) tblcache_put(filename, 0, words, count * 2);
+	}
 
-			if (n == 3)
-			{
-				spi_w((index << 8) | (c0 & 0xFF));
-				spi_w((index << 8) | (c1 & 0xFF));
-				spi_w((index << 8) | (c2 & 0xFF));
+	if (count >= 0)
+	{
+		VideoFilterDigest digest;
+		MD5Context ctx;
+		MD5Init(&ctx);
+		MD5Update(&ctx, (unsigned char *)words, count * 2);
+		MD5Final(digest.md5, &ctx);
 
-				index++;
-				if (index >= 256) break;
-			}
+		// same curve is still in the core
+		if (digest != sent_digest)
+		{
+			spi_uio_cmd_cont(UIO_SET_GAMCURV);
+			spi_write((const uint8_t*)words, count * 2, 1);
+			DisableIO();
+			sent_digest = digest;
 		}
-		DisableIO();
+
 		spi_uio_cmd8(UIO_SET_GAMMA, gamma_cfg[0]);
 	}
 	memcpy(active_gamma_cfg, gamma_cfg, sizeof(gamma_cfg));
@@ -810,31 +879,12 @@ enum
 	SM_MODE_COUNT
 };
 
-static void setShadowMask()
+// Words following the mode flag of UIO_SHADOWMASK, compiled from the text file
+// for the section matching the current vertical resolution.
+static int compile_shadow_mask(const char *filename, uint16_t *words)
 {
-	PROFILE_FUNCTION();
-
-	static char filename[1024];
-	has_shadow_mask = 0;
-
-	if (!spi_uio_cmd_cont(UIO_SHADOWMASK))
-	{
-		DisableIO();
-		return;
-	}
-
-	has_shadow_mask = 1;
-	switch (video_get_shadow_mask_mode())
-	{
-		default: spi_w(SM_FLAG(0)); break;
-		case SM_MODE_1X: spi_w(SM_FLAG(SM_FLAG_ENABLED)); break;
-		case SM_MODE_2X: spi_w(SM_FLAG(SM_FLAG_ENABLED | SM_FLAG_2X)); break;
-		case SM_MODE_1X_ROTATED: spi_w(SM_FLAG(SM_FLAG_ENABLED | SM_FLAG_ROTATED)); break;
-		case SM_MODE_2X_ROTATED: spi_w(SM_FLAG(SM_FLAG_ENABLED | SM_FLAG_ROTATED | SM_FLAG_2X)); break;
-	}
-
+	int count = 0;
 	int loaded = 0;
-	snprintf(filename, sizeof(filename), SMASK_DIR"/%s", shadow_mask_cfg + 1);
 
 	fileTextReader reader;
 	if (FileOpenTextReader(&reader, filename))
@@ -891,7 +941,7 @@ static void setShadowMask()
 					break;
 				}
 
-				for (int x = 0; x < 16; x++) spi_w(SM_LUT(v2 ? (p[x] & 0x7FF) : (((p[x] & 7) << 8) | 0x2A)));
+				for (int x = 0; x < 16; x++) words[count++] = SM_LUT(v2 ? (p[x] & 0x7FF) : (((p[x] & 7) << 8) | 0x2A));
 				y += 1;
 
 				if (y == h)
@@ -904,13 +954,78 @@ static void setShadowMask()
 
 		if (y == h)
 		{
-			spi_w(SM_HMAX(w - 1));
-			spi_w(SM_VMAX(h - 1));
+			words[count++] = SM_HMAX(w - 1);
+			words[count++] = SM_VMAX(h - 1);
 		}
 	}
 
-	if (!loaded) spi_w(SM_FLAG(0));
+	if (!loaded) words[count++] = SM_FLAG(0);
+	return count;
+}
+
+static void setShadowMask()
+{
+	PROFILE_FUNCTION();
+
+	static char filename[1024];
+	static uint16_t words[16 * 16 + 3];
+	static VideoFilterDigest sent_digest;
+	static uint16_t sent_flag = 0xFFFF;
+	has_shadow_mask = 0;
+
+	if (!spi_uio_cmd_cont(UIO_SHADOWMASK))
+	{
+		DisableIO();
+		return;
+	}
+
+	has_shadow_mask = 1;
+	uint16_t flag;
+	switch (video_get_shadow_mask_mode())
+	{
+		default: flag = SM_FLAG(0); break;
+		case SM_MODE_1X: flag = SM_FLAG(SM_FLAG_ENABLED); break;
+		case SM_MODE_2X: flag = SM_FLAG(SM_FLAG_ENABLED | SM_FLAG_2X); break;
+		case SM_MODE_1X_ROTATED: flag = SM_FLAG(SM_FLAG_ENABLED | SM_FLAG_ROTATED); break;
+		case SM_MODE_2X_ROTATED: flag = SM_FLAG(SM_FLAG_ENABLED | SM_FLAG_ROTATED | SM_FLAG_2X); break;
+	}
+
+	snprintf(filename, sizeof(filename), SMASK_DIR"/%s", shadow_mask_cfg + 1);
+
+	// mask file may have sections per resolution, so compiled result depends on it
+	int count;
+	uint32_t blob_size = 0;
+	const uint16_t *blob = (const uint16_t*)tblcache_get(filename, v_cur.item[5], &blob_size);
+	if (blob && blob_size && blob_size <= sizeof(words))
+	{
+		count = blob_size / 2;
+		memcpy(words, blob, blob_size);
+	}
+	else
+	{
+		count = compile_shadow_mask(filename, words);
+		tblcache_put(filename, v_cur.item[5], words, count * 2);
+	}
+
+	VideoFilterDigest digest;
+	MD5Context ctx;
+	MD5Init(&ctx);
+	MD5Update(&ctx, (unsigned char *)words, count * 2);
+	MD5Final(digest.md5, &ctx);
+
+	// nothing changed since the last upload
+	if (flag == sent_flag && digest == sent_digest)
+	{
+		DisableIO();
+		return;
+	}
+
+	spi_w(flag);
+	spi_write((const uint8_t*)words, count * 2, 1);
 	DisableIO();
+
+	sent_flag = flag;
+	sent_digest = digest;
 }
 
 int video_get_shadow_mask_mode()
@@ -2934,13 +3049,13 @@ static void set_yc_mode()
 		char yc_key_expand[64];
 		sprintf(yc_key, "%s_%.1f%s%s", user_io_get_core_name(1), fps, current_video_info.interlaced ? "i" : "", (pal || !cfg.ntsc_mode) ? "" : (cfg.ntsc_mode == 1) ? "s" : "m");
 		snprintf(yc_key_expand, sizeof(yc_key_expand), "%s_%.2f", yc_key, prate);
-		printf("Calculated YC parameters for '%s': %s PHASE_INC=%lld, COLORBURST_START=%d, COLORBURST_END=%d\n", yc_key, pal ? "PAL" : (cfg.ntsc_mode == 1) ? "PAL60" : (cfg.ntsc_mode == 2) ? "PAL-M" : "NTSC", PHASE_INC, COLORBURST_START, COLORBURST_END);
+		printf("Calculated YC parameters for '%s': %s PHASE_INC=%" PRId64 ", COLORBURST_START=%d, COLORBURST_END=%d\n", yc_key, pal ? "PAL" : (cfg.ntsc_mode == 1) ? "PAL60" : (cfg.ntsc_mode == 2) ? "PAL-M" : "NTSC", PHASE_INC, COLORBURST_START, COLORBURST_END);
 
 		for (uint i = 0; i < sizeof(yc_modes) / sizeof(yc_modes[0]); i++)
 		{
 		if (!strcasecmp(yc_modes[i].key, yc_key) || !strcasecmp(yc_modes[i].key, yc_key_expand))
 			{
-				printf("Override YC PHASE_INC with value: %lld\n", yc_modes[i].phase_inc);
+				printf("Override YC PHASE_INC with value: %" PRId64 "\n", yc_modes[i].phase_inc);
 				PHASE_INC = yc_modes[i].phase_inc;
 				break;
 			}
@@ -3136,7 +3251,7 @@ static void fb_write_module_params()
 	int height = fb_height;
 	offload_add_work([=]
 	{
-		FILE *fp = fopen("/sys/module/MiSTer_fb/parameters/mode", "wt");
+		FILE *fp = fopen(FB_MODE_PAR, "wt");
 		if (fp)
 		{
 			fprintf(fp, "%d %d %d %d %d\n", 8888, 1, width, height, width * 4);
@@ -3257,9 +3372,12 @@ static void video_fb_config()
 	fb_write_module_params();
 }
 
+// menu background is composed in cached memory and copied to the frame buffer in one go
+static uint32_t *menu_compose = 0;
+
 static void draw_checkers()
 {
-	volatile uint32_t* buf = fb_base + (FB_SIZE*menu_bgn);
+	uint32_t* buf = menu_compose;
 
 	uint32_t col1 = 0x888888;
 	uint32_t col2 = 0x666666;
@@ -3279,7 +3397,7 @@ static void draw_checkers()
 
 static void draw_hbars1()
 {
-	volatile uint32_t* buf = fb_base + (FB_SIZE*menu_bgn);
+	uint32_t* buf = menu_compose;
 	int height = fb_height - 2 * brd_y;
 
 	int old_base = 0;
@@ -3315,7 +3433,7 @@ static void draw_hbars1()
 
 static void draw_hbars2()
 {
-	volatile uint32_t* buf = fb_base + (FB_SIZE*menu_bgn);
+	uint32_t* buf = menu_compose;
 	int height = fb_height - 2 * brd_y;
 	int width = fb_width - 2 * brd_x;
 
@@ -3341,7 +3459,7 @@ static void draw_hbars2()
 
 static void draw_vbars1()
 {
-	volatile uint32_t* buf = fb_base + (FB_SIZE*menu_bgn);
+	uint32_t* buf = menu_compose;
 	int width = fb_width - 2 * brd_x;
 
 	int sz = width / 7;
@@ -3377,7 +3495,7 @@ static void draw_vbars1()
 
 static void draw_vbars2()
 {
-	volatile uint32_t* buf = fb_base + (FB_SIZE*menu_bgn);
+	uint32_t* buf = menu_compose;
 	int height = fb_height - 2 * brd_y;
 	int width = fb_width - 2 * brd_x;
 
@@ -3404,7 +3522,7 @@ static void draw_vbars2()
 
 static void draw_spectrum()
 {
-	volatile uint32_t* buf = fb_base + (FB_SIZE*menu_bgn);
+	uint32_t* buf = menu_compose;
 	int height = fb_height - 2 * brd_y;
 	int width = fb_width - 2 * brd_x;
 
@@ -3426,13 +3544,7 @@ static void draw_spectrum()
 
 static void draw_black()
 {
-	volatile uint32_t* buf = fb_base + (FB_SIZE*menu_bgn);
-
-	for (int y = 0; y < fb_height; y++)
-	{
-		int pos = y * fb_width;
-		for (int x = 0; x < fb_width; x++) buf[pos++] = 0;
-	}
+	memset(menu_compose, 0, fb_width * fb_height * sizeof(uint32_t));
 }
 
 static uint64_t getus()
@@ -3444,7 +3556,7 @@ static uint64_t getus()
 
 static void vs_wait()
 {
-	int fb = open("/dev/fb0", O_RDWR | O_CLOEXEC);
+	int fb = open(FB_DEV, O_RDWR | O_CLOEXEC);
 	int zero = 0;
 	uint64_t t1, t2;
 	if (ioctl(fb, FBIO_WAITFORVSYNC, &zero) == -1)
@@ -3459,7 +3571,7 @@ static void vs_wait()
 	t2 = getus();
 	close(fb);
 
-	printf("vs_wait(us): %llu\n", t2 - t1);
+	printf("vs_wait(us): %" PRIu64 "\n", t2 - t1);
 }
 
 static char *get_file_fromdir(const char* dir, int num, int *count)
@@ -3495,7 +3607,7 @@ static char *get_file_fromdir(const char* dir, int num, int *count)
 	return name;
 }
 
-static Imlib_Image load_bg()
+static const char *get_bg_name()
 {
 	const char* fname = "menu.png";
 	if (!FileExists(fname))
@@ -3534,21 +3646,76 @@ static Imlib_Image load_bg()
 		}
 	}
 
-	if (fname)
+	return fname;
+}
+
+// Wallpaper scaled to the area inside the borders. Prepared once per resolution,
+// taken from the cache in /tmp if Main was restarted (i.e. returned to the menu core).
+static uint32_t *load_bg(int width, int height)
+{
+	PROFILE_FUNCTION();
+
+	static char path[1024] = {};
+	static int done = 0;
+	static uint32_t *scaled = 0;
+	static int scaled_w = 0, scaled_h = 0;
+
+	if (!done)
+	{
+		done = 1;
+		const char *fname = get_bg_name();
+		if (fname) snprintf(path, sizeof(path), "%s", getFullPath(fname));
+	}
+
+	if (!path[0] || width <= 0 || height <= 0) return NULL;
+	if (scaled && scaled_w == width && scaled_h == height) return scaled;
+
+	free(scaled);
+	scaled_w = width;
+	scaled_h = height;
+	scaled = (uint32_t*)calloc(width * height, sizeof(uint32_t));
+	if (!scaled) return NULL;
+
+	if (wallpaper_cache_load(path, width, height, scaled)) return scaled;
+
+	Imlib_Load_Error error = IMLIB_LOAD_ERROR_NONE;
+	Imlib_Image img = imlib_load_image_with_error_return(path, &error);
+	if (!img)
 	{
-		Imlib_Load_Error error = IMLIB_LOAD_ERROR_NONE;
-		Imlib_Image img = imlib_load_image_with_error_return(getFullPath(fname), &error);
-		if (img) return img;
-		printf("Image %s loading error %d\n", fname, error);
+		printf("Image %s loading error %d\n", path, error);
+		path[0] = 0;
+		free(scaled);
+		scaled = 0;
+		return NULL;
 	}
 
-	return NULL;
+	imlib_context_set_image(img);
+	int src_w = imlib_image_get_width();
+	int src_h = imlib_image_get_height();
+
+	Imlib_Image dst = imlib_create_image_using_data(width, height, scaled);
+	imlib_context_set_image(dst);
+	imlib_blend_image_onto_image(img, 0,
+		0, 0,           //int source_x, int source_y,
+		src_w, src_h,   //int source_width, int source_height,
+		0, 0,           //int destination_x, int destination_y,
+		width, height   //int destination_width, int destination_height
+	);
+	imlib_free_image();
+
+	imlib_context_set_image(img);
+	imlib_free_image_and_decache();
+
+	wallpaper_cache_store(path, width, height, scaled);
+	return scaled;
 }
 
 static int bg_has_picture = 0;
 extern uint8_t  _binary_logo_png_start[], _binary_logo_png_end[];
 void video_menu_bg(int n, int idle)
 {
+	PROFILE_FUNCTION();
+
 	bg_has_picture = 0;
 	menu_bg = n;
 	if (n)
@@ -3594,29 +3761,30 @@ void video_menu_bg(int n, int idle)
 
 		menu_bgn = (menu_bgn == 1) ? 2 : 1;
 
-		static Imlib_Image menubg = 0;
-		static Imlib_Image bg1 = 0, bg2 = 0;
-		if (!bg1) bg1 = imlib_create_image_using_data(fb_width, fb_height, (uint32_t*)(fb_base + (FB_SIZE * 1)));
-		if (!bg1) printf("Warning: bg1 is 0\n");
-		if (!bg2) bg2 = imlib_create_image_using_data(fb_width, fb_height, (uint32_t*)(fb_base + (FB_SIZE * 2)));
-		if (!bg2) printf("Warning: bg2 is 0\n");
-
-		Imlib_Image *bg = (menu_bgn == 1) ? &bg1 : &bg2;
-		//printf("*bg = %p\n", *bg);
-
-		static Imlib_Image curtain = 0;
-		if (!curtain)
+		static Imlib_Image bg = 0;
+		static int bg_w = 0, bg_h = 0;
+		if (!menu_compose || bg_w != fb_width || bg_h != fb_height)
 		{
-			curtain = imlib_create_image(fb_width, fb_height);
-			imlib_context_set_image(curtain);
-			imlib_image_set_has_alpha(1);
+			if (bg)
+			{
+				imlib_context_set_image(bg);
+				imlib_free_image();
+				bg = 0;
+			}
 
-			uint32_t *data = imlib_image_get_data();
-			int sz = fb_width * fb_height;
-			for (int i = 0; i < sz; i++)
+			free(menu_compose);
+			menu_compose = (fb_width > 0 && fb_height > 0) ? (uint32_t*)malloc(fb_width * fb_height * sizeof(uint32_t)) : 0;
+			if (!menu_compose)
 			{
-				*data++ = 0x9F000000;
+				printf("Warning: no memory for menu background\n");
+				video_fb_enable(0);
+				return;
 			}
+
+			bg_w = fb_width;
+			bg_h = fb_height;
+			bg = imlib_create_image_using_data(fb_width, fb_height, menu_compose);
+			if (!bg) printf("Warning: bg is 0\n");
 		}
 
 		draw_black();
@@ -3626,30 +3794,19 @@ void video_menu_bg(int n, int idle)
 			switch (n)
 			{
 			case 1:
-				if (!menubg) menubg = load_bg();
-				if (menubg)
 				{
-					imlib_context_set_image(menubg);
-					int src_w = imlib_image_get_width();
-					int src_h = imlib_image_get_height();
-					//printf("menubg: src_w=%d, src_h=%d\n", src_w, src_h);
-
-					if (*bg)
+					int width = fb_width - (brd_x * 2);
+					int height = fb_height - (brd_y * 2);
+					const uint32_t *menubg = load_bg(width, height);
+					if (menubg)
 					{
-						imlib_context_set_image(*bg);
-						imlib_blend_image_onto_image(menubg, 0,
-							0, 0,                           //int source_x, int source_y,
-							src_w, src_h,                   //int source_width, int source_height,
-							brd_x, brd_y,                   //int destination_x, int destination_y,
-							fb_width - (brd_x * 2), fb_height - (brd_y * 2) //int destination_width, int destination_height
-						);
+						for (int y = 0; y < height; y++)
+						{
+							memcpy(menu_compose + ((y + brd_y) * fb_width) + brd_x, menubg + (y * width), width * sizeof(uint32_t));
+						}
 						bg_has_picture = 1;
 						break;
 					}
-					else
-					{
-						printf("*bg = 0!\n");
-					}
 				}
 				draw_checkers();
 				break;
@@ -3711,11 +3868,11 @@ void video_menu_bg(int n, int idle)
 				dst_h = src_h * dst_w / src_w;
 			}
 
-			if (*bg)
+			if (bg)
 			{
 				if (cfg.direct_video && (v_cur.item[5] < 300)) dst_h /= 2;
 
-				imlib_context_set_image(*bg);
+				imlib_context_set_image(bg);
 				imlib_blend_image_onto_image(logo, 1,
 					0, 0,         //int source_x, int source_y,
 					src_w, src_h, //int source_width, int source_height,
@@ -3725,27 +3882,14 @@ void video_menu_bg(int n, int idle)
 			}
 			else
 			{
-				printf("*bg = 0!\n");
+				printf("bg = 0!\n");
 			}
 		}
 
-		if (curtain)
-		{
-			if (idle > 1 && *bg)
-			{
-				imlib_context_set_image(*bg);
-				imlib_blend_image_onto_image(curtain, 1,
-					0, 0,                //int source_x, int source_y,
-					fb_width, fb_height, //int source_width, int source_height,
-					0, 0,                //int destination_x, int destination_y,
-					fb_width, fb_height  //int destination_width, int destination_height
-				);
-			}
-		}
-		else
-		{
-			printf("curtain = 0!\n");
-		}
+		// curtain
+		if (idle > 1) wallpaper_darken(menu_compose, fb_width * fb_height, 0x9F);
+
+		if (fb_base) memcpy((void*)(fb_base + (FB_SIZE * menu_bgn)), menu_compose, fb_width * fb_height * sizeof(uint32_t));
 
 		//test the fb driver
 		//vs_wait();
@@ -3906,7 +4050,7 @@ void video_cmd(char *cmd)
 			if (cmd[6] != '2')
 			{
 				static char cmd[256];
-				sprintf(cmd, "echo %d %d %d %d %d >/sys/module/MiSTer_fb/parameters/mode", fmt, rb, width, height, stride);
+				sprintf(cmd, "echo %d %d %d %d %d >" FB_MODE_PAR, fmt, rb, width, height, stride);
 				system(cmd);
 			}
 		}
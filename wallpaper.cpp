@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "wallpaper.h"
+#include "profiling.h"
+#include "miniz.h"
+
+#define WPCACHE_MAGIC 0x31435057 // WPC1
+#define WPCACHE_SLOTS 4
+
+struct wpcache_hdr_t
+{
+	uint32_t magic;
+	uint32_t path_crc;
+	uint64_t size;
+	int64_t  mtime;
+	uint32_t width;
+	uint32_t height;
+};
+
+static int make_key(const char *path, int width, int height, wpcache_hdr_t *hdr, char *name, int name_size)
+{
+	struct stat64 st;
+	if (stat64(path, &st) < 0) return 0;
+
+	memset(hdr, 0, sizeof(wpcache_hdr_t));
+	hdr->magic = WPCACHE_MAGIC;
+	hdr->path_crc = crc32(0, (const uint8_t*)path, strlen(path));
+	hdr->size = st.st_size;
+	hdr->mtime = st.st_mtime;
+	hdr->width = width;
+	hdr->height = height;
+
+	snprintf(name, name_size, "/tmp/MiSTer_wallpaper%d.bin", hdr->path_crc % WPCACHE_SLOTS);
+	return 1;
+}
+
+int wallpaper_cache_load(const char *path, int width, int height, uint32_t *dst)
+{
+	PROFILE_FUNCTION();
+
+	char name[64];
+	wpcache_hdr_t key, hdr;
+	if (!make_key(path, width, height, &key, name, sizeof(name))) return 0;
+
+	int fd = open(name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return 0;
+
+	size_t len = width * height * sizeof(uint32_t);
+	int ret = read(fd, &hdr, sizeof(hdr)) == sizeof(hdr) && !memcmp(&hdr, &key, sizeof(hdr)) && read(fd, dst, len) == (ssize_t)len;
+	close(fd);
+
+	if (ret) printf("Wallpaper: using cached %dx%d image of %s\n", width, height, path);
+	return ret;
+}
+
+void wallpaper_cache_store(const char *path, int width, int height, const uint32_t *src)
+{
+	char name[64];
+	wpcache_hdr_t hdr;
+	if (!make_key(path, width, height, &hdr, name, sizeof(name))) return;
+
+	int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) return;
+
+	size_t len = width * height * sizeof(uint32_t);
+	int ret = write(fd, &hdr, sizeof(hdr)) == sizeof(hdr) && write(fd, src, len) == (ssize_t)len;
+	close(fd);
+
+	if (!ret) unlink(name);
+}
+
+// imlib2 blends black as c + ((-c * a) + ((-c * a) >> 8) + 0x80) >> 8 in signed math,
+// the same in unsigned: c - (c * a + 0x7F + ((c * a + 0xFF) >> 8)) >> 8
+static inline uint32_t darken_px(uint32_t px, uint32_t a)
+{
+	uint32_t res = px & 0xFF000000;
+	for (int sh = 0; sh < 24; sh += 8)
+	{
+		uint32_t c = (px >> sh) & 0xFF;
+		uint32_t t = c * a + 0x7F;
+		res |= (c - ((t + ((t + 0x80) >> 8)) >> 8)) << sh;
+	}
+	return res;
+}
+
+void wallpaper_darken(uint32_t *buf, uint32_t count, uint8_t alpha)
+{
+	PROFILE_FUNCTION();
+
+	uint32_t i = 0;
+
+#ifdef __ARM_NEON
+	// alpha channel gets multiplied by 0, so it stays the same
+	const uint8x8_t mul = vreinterpret_u8_u32(vdup_n_u32(alpha * 0x010101));
+	const uint16x8_t rnd = vdupq_n_u16(0x7F);
+	for (; i + 4 <= count; i += 4)
+	{
+		uint8x16_t px = vreinterpretq_u8_u32(vld1q_u32(buf + i));
+		uint16x8_t lo = vmlal_u8(rnd, vget_low_u8(px), mul);
+		uint16x8_t hi = vmlal_u8(rnd, vget_high_u8(px), mul);
+		lo = vrsraq_n_u16(lo, lo, 8);
+		hi = vrsraq_n_u16(hi, hi, 8);
+		uint8x16_t sub = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+		vst1q_u32(buf + i, vreinterpretq_u32_u8(vsubq_u8(px, sub)));
+	}
+#endif
+
+	for (; i < count; i++) buf[i] = darken_px(buf[i], alpha);
+}
@@ -0,0 +1,14 @@
+#ifndef WALLPAPER_H
+#define WALLPAPER_H
+
+#include <inttypes.h>
+
+// Decoded and scaled wallpapers are kept in /tmp, so returning to the menu core
+// doesn't need to decode the picture again. Key is file path, size, mtime and resolution.
+int  wallpaper_cache_load(const char *path, int width, int height, uint32_t *dst);
+void wallpaper_cache_store(const char *path, int width, int height, const uint32_t *src);
+
+// Darkens pixels by alpha (0-255) like blending a black layer on top. Pixel alpha is kept.
+void wallpaper_darken(uint32_t *buf, uint32_t count, uint8_t alpha);
+
+#endif